@@ -1,11 +1,15 @@
 #include "base/eventing/file/eventlog.h"
 
+#include <algorithm>
+#include <chrono>
 #include <memory>
 #include <mutex>
+#include <unordered_map>
 #include <utility>
 
 #include "base/util/compat.h"
 #include "base/util/logging.h"
+#include "base/util/perf_counter.h"
 #include "base/util/uuid.h"
 
 namespace gpi = google::protobuf::io;
@@ -13,27 +17,111 @@ namespace gpi = google::protobuf::io;
 namespace vertexai {
 namespace eventing {
 namespace file {
+namespace {
+
+// The default number of events each thread may buffer in async mode.
+constexpr std::uint32_t kDefaultThreadBufferEvents = 4096;
+
+// The most events the writer thread places into a single Record.
+constexpr int kMaxEventsPerRecord = 1024;
+
+// How often the writer thread drains thread buffers when not woken sooner.
+constexpr std::chrono::milliseconds kWriterInterval{20};
+
+PerfCounter dropped_events_counter("eventlog_dropped_events");
+
+std::atomic<std::uint64_t> next_log_id{0};
+
+// Counts a producer as inside the log for the guard's lifetime.
+class ProducerGuard final {
+ public:
+  explicit ProducerGuard(std::atomic<std::size_t>* active) : active_{active} { active_->fetch_add(1); }
+  ~ProducerGuard() { active_->fetch_sub(1); }
+
+ private:
+  std::atomic<std::size_t>* active_;
+};
+
+}  // namespace
+
+// A single-producer, single-consumer ring of events: the producer is a
+// logging thread, the consumer is the writer thread.  Events are swapped in
+// and out of preallocated slots, so neither side copies or allocates.
+class EventLog::Ring {
+ public:
+  explicit Ring(std::size_t capacity) : slots_(capacity) {}
+
+  std::size_t capacity() const { return slots_.size(); }
+
+  // Called by the producer.  Returns the number of events buffered after
+  // the push, or zero if the ring was full.
+  std::size_t TryPush(context::proto::Event* event) {
+    std::uint64_t tail = tail_.load(std::memory_order_relaxed);
+    std::uint64_t used = tail - head_.load(std::memory_order_acquire);
+    if (used == slots_.size()) {
+      return 0;
+    }
+    slots_[tail % slots_.size()].Swap(event);
+    tail_.store(tail + 1, std::memory_order_release);
+    return used + 1;
+  }
+
+  // Called by the consumer.  Moves up to max_events events into the record,
+  // returning the number moved.
+  int Drain(proto::Record* record, int max_events) {
+    std::uint64_t head = head_.load(std::memory_order_relaxed);
+    std::uint64_t tail = tail_.load(std::memory_order_acquire);
+    int count = static_cast<int>(std::min<std::uint64_t>(tail - head, max_events));
+    for (int idx = 0; idx < count; ++idx) {
+      record->add_event()->Swap(&slots_[(head + idx) % slots_.size()]);
+    }
+    head_.store(head + count, std::memory_order_release);
+    return count;
+  }
+
+  bool empty() const { return head_.load(std::memory_order_acquire) == tail_.load(std::memory_order_acquire); }
+
+  // Set when the log stops accepting events, so that threads can forget the ring.
+  std::atomic<bool> closed{false};
+
+ private:
+  std::vector<context::proto::Event> slots_;
+  std::atomic<std::uint64_t> head_{0};
+  std::atomic<std::uint64_t> tail_{0};
+};
 
 EventLog::EventLog(const proto::EventLog& config)
     : config_{config},
       std_file_out_{config.filename(), std::ios::binary},
       ostr_out_{std::make_unique<gpi::OstreamOutputStream>(&std_file_out_)},
       gzip_out_{std::make_unique<gpi::GzipOutputStream>(ostr_out_.get(), gpi::GzipOutputStream::Options())},
-      coded_out_{std::make_unique<gpi::CodedOutputStream>(gzip_out_.get())} {
+      coded_out_{std::make_unique<gpi::CodedOutputStream>(gzip_out_.get())},
+      id_{next_log_id++} {
   if (!std_file_out_) {
     throw std::runtime_error(std::string("unable to open \"") + config.filename() + "\" for writing");
   }
   LOG(INFO) << "Writing event log to " << config.filename();
   proto::Record record;
   record.mutable_magic()->set_value(proto::Magic::Eventlog);
-  LogRecordLocked(std::move(record));
+  LogRecordLocked(record);
+  if (config_.async()) {
+    if (!config_.thread_buffer_events()) {
+      config_.set_thread_buffer_events(kDefaultThreadBufferEvents);
+    }
+    writer_ = std::thread{[this]() { WriterLoop(); }};
+  }
 }
 
 EventLog::~EventLog() { FlushAndClose(); }
 
 void EventLog::LogEvent(context::proto::Event event) {
+  if (config_.async()) {
+    LogEventAsync(&event);
+    return;
+  }
   std::lock_guard<std::mutex> lock{mu_};
   if (closed_) {
+    DropEvent();
     return;
   }
   if (!wrote_uuid_) {
@@ -42,10 +130,21 @@ void EventLog::LogEvent(context::proto::Event event) {
   }
   proto::Record record;
   *record.add_event() = std::move(event);
-  LogRecordLocked(std::move(record));
+  LogRecordLocked(record);
 }
 
 void EventLog::FlushAndClose() {
+  if (config_.async()) {
+    {
+      std::lock_guard<std::mutex> lock{rings_mu_};
+      accepting_ = false;
+      stopping_ = true;
+    }
+    writer_cv_.notify_one();
+    if (writer_.joinable()) {
+      writer_.join();
+    }
+  }
   std::lock_guard<std::mutex> lock{mu_};
   if (closed_) {
     return;
@@ -57,11 +156,133 @@ void EventLog::FlushAndClose() {
   std_file_out_.close();
 }
 
-void EventLog::LogRecordLocked(proto::Record record) {
+void EventLog::LogRecordLocked(const proto::Record& record) {
   coded_out_->WriteVarint32(record.ByteSize());
   record.SerializeToCodedStream(coded_out_.get());
 }
 
+void EventLog::LogEventAsync(context::proto::Event* event) {
+  // The producer announces itself before checking whether the log is
+  // accepting events; once the log stops accepting, the writer keeps draining
+  // until every producer that got past the check has left.
+  ProducerGuard guard{&active_producers_};
+  if (!accepting_) {
+    DropEvent();
+    return;
+  }
+  Ring* ring = ThreadRing();
+  for (;;) {
+    std::size_t used = ring->TryPush(event);
+    if (used) {
+      // Wake the writer early once a buffer is half full, rather than waiting
+      // for its next pass.
+      if (used == ring->capacity() / 2 + 1 && !wake_.exchange(true)) {
+        writer_cv_.notify_one();
+      }
+      return;
+    }
+    if (config_.overflow() == proto::EventLog::Drop) {
+      DropEvent();
+      return;
+    }
+    if (!wake_.exchange(true)) {
+      writer_cv_.notify_one();
+    }
+    std::this_thread::yield();
+  }
+}
+
+void EventLog::DropEvent() {
+  dropped_events_++;
+  dropped_events_counter.inc();
+}
+
+EventLog::Ring* EventLog::ThreadRing() {
+  // Keyed by log ID rather than address, since a log's address may be reused
+  // after it's destroyed.
+  thread_local std::unordered_map<std::uint64_t, std::shared_ptr<Ring>> thread_rings;
+  auto it = thread_rings.find(id_);
+  if (it != thread_rings.end()) {
+    return it->second.get();
+  }
+  for (auto jt = thread_rings.begin(); jt != thread_rings.end();) {
+    if (jt->second->closed) {
+      jt = thread_rings.erase(jt);
+    } else {
+      ++jt;
+    }
+  }
+  auto ring = std::make_shared<Ring>(config_.thread_buffer_events());
+  {
+    std::lock_guard<std::mutex> lock{rings_mu_};
+    rings_.emplace_back(ring);
+  }
+  return thread_rings.emplace(id_, std::move(ring)).first->second.get();
+}
+
+void EventLog::WriterLoop() {
+  for (;;) {
+    std::vector<std::shared_ptr<Ring>> rings;
+    bool stopping;
+    bool last_pass;
+    {
+      std::unique_lock<std::mutex> lock{rings_mu_};
+      writer_cv_.wait_for(lock, kWriterInterval, [this]() { return stopping_ || wake_.exchange(false); });
+      stopping = stopping_;
+      // Once stopping, no new producer can get past the accepting check, so
+      // when none are left inside the log, every event has been pushed (and
+      // every ring registered), and this pass's drain is the last one needed.
+      last_pass = stopping && !active_producers_;
+      // Forget the rings of threads which have exited; once a thread has
+      // released its ring, nothing else can push to it.
+      rings_.erase(std::remove_if(rings_.begin(), rings_.end(),
+                                  [](const std::shared_ptr<Ring>& ring) {
+                                    return ring.use_count() == 1 && ring->empty();
+                                  }),
+                   rings_.end());
+      rings = rings_;
+    }
+
+    std::lock_guard<std::mutex> lock{mu_};
+    bool drained;
+    do {
+      drained = true;
+      proto::Record record;
+      for (const auto& ring : rings) {
+        int room = kMaxEventsPerRecord - record.event_size();
+        if (!room) {
+          drained = false;
+          break;
+        }
+        ring->Drain(&record, room);
+        if (!ring->empty()) {
+          drained = false;
+        }
+      }
+      if (!record.event_size()) {
+        break;
+      }
+      if (!wrote_uuid_) {
+        record.mutable_event(0)->mutable_activity_id()->set_stream_uuid(ToByteString(stream_uuid()));
+        wrote_uuid_ = true;
+      }
+      LogRecordLocked(record);
+    } while (!drained);
+
+    if (last_pass) {
+      std::lock_guard<std::mutex> rings_lock{rings_mu_};
+      for (const auto& ring : rings_) {
+        ring->closed = true;
+      }
+      return;
+    }
+    if (stopping) {
+      // Let the remaining producers finish pushing.
+      std::this_thread::yield();
+    }
+  }
+}
+
 Reader::Reader(const std::string& filename)
     : std_file_in_{filename, std::ios::binary},
       ostr_in_{std::make_unique<gpi::IstreamInputStream>(&std_file_in_)},
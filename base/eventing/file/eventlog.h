@@ -4,10 +4,15 @@
 #include <google/protobuf/io/gzip_stream.h>
 #include <google/protobuf/io/zero_copy_stream_impl.h>
 
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
 #include <fstream>
 #include <memory>
 #include <mutex>
 #include <string>
+#include <thread>
+#include <vector>
 
 #include "base/context/eventlog.h"
 #include "base/eventing/file/eventlog.pb.h"
@@ -16,6 +21,12 @@ namespace vertexai {
 namespace eventing {
 namespace file {
 
+// Writes events to a gzip-compressed file of Records.
+//
+// By default, each event is serialized and compressed on the logging thread,
+// under a mutex.  In async mode, each logging thread instead swaps its events
+// into a lock-free buffer of its own, and a background writer thread drains
+// the buffers, batching many events into each Record.
 class EventLog final : public context::EventLog {
  public:
   explicit EventLog(const proto::EventLog& config);
@@ -25,8 +36,18 @@ class EventLog final : public context::EventLog {
 
   void FlushAndClose() override;
 
+  // The number of events discarded, either because a thread's buffer was full
+  // or because the log had been closed.
+  std::uint64_t dropped_events() const { return dropped_events_; }
+
  private:
-  void LogRecordLocked(proto::Record record);
+  class Ring;
+
+  void LogRecordLocked(const proto::Record& record);
+  void LogEventAsync(context::proto::Event* event);
+  void DropEvent();
+  Ring* ThreadRing();
+  void WriterLoop();
 
   // The client configuration.
   proto::EventLog config_;
@@ -45,6 +66,18 @@ class EventLog final : public context::EventLog {
 
   // Whether the UUID's been written.
   bool wrote_uuid_ = false;
+
+  // Async mode state.  The output streams are used only by the writer thread.
+  const std::uint64_t id_;
+  std::atomic<bool> accepting_{true};
+  std::atomic<bool> wake_{false};
+  std::atomic<std::uint64_t> dropped_events_{0};
+  std::atomic<std::size_t> active_producers_{0};  // Threads inside LogEventAsync
+  std::mutex rings_mu_;
+  std::condition_variable writer_cv_;
+  bool stopping_ = false;                     // Guarded by rings_mu_
+  std::vector<std::shared_ptr<Ring>> rings_;  // Guarded by rings_mu_
+  std::thread writer_;
 };
 
 class Reader final {
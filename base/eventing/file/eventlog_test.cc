@@ -1,8 +1,11 @@
 #include <gmock/gmock.h>
 #include <gtest/gtest.h>
 
+#include <atomic>
 #include <fstream>
+#include <thread>
 #include <utility>
+#include <vector>
 
 #include "base/eventing/file/eventlog.h"
 #include "base/eventing/file/eventlog.pb.h"
@@ -49,6 +52,95 @@ TEST_F(EventLogTest, CanReport) {
   }
 }
 
+class AsyncEventLogTest : public EventLogTest {
+ protected:
+  AsyncEventLogTest() { config_.set_async(true); }
+
+  void Reopen() {
+    eventlog_.reset();
+    eventlog_ = std::make_unique<EventLog>(config_);
+  }
+
+  // Logs events from several threads, returning the number read back.
+  std::size_t LogAndCount(std::size_t threads, std::size_t events_per_thread) {
+    std::vector<std::thread> loggers;
+    for (std::size_t tidx = 0; tidx < threads; ++tidx) {
+      loggers.emplace_back([this, events_per_thread]() {
+        for (std::size_t eidx = 0; eidx < events_per_thread; ++eidx) {
+          context::proto::Event event;
+          event.set_verb("Event");
+          eventlog_->LogEvent(std::move(event));
+        }
+      });
+    }
+    for (auto& logger : loggers) {
+      logger.join();
+    }
+    eventlog_->FlushAndClose();
+    return ReadCount();
+  }
+
+  // Returns the number of events in the log file.
+  std::size_t ReadCount() {
+    Reader reader{kTestFilename};
+    context::proto::Event event;
+    std::size_t count = 0;
+    while (reader.Read(&event)) {
+      if (!count) {
+        EXPECT_THAT(event.activity_id().stream_uuid().length(), Eq(16));
+      }
+      EXPECT_THAT(event.verb(), Eq("Event"));
+      ++count;
+    }
+    return count;
+  }
+};
+
+TEST_F(AsyncEventLogTest, BlockingWritesEveryEvent) {
+  config_.set_thread_buffer_events(16);
+  Reopen();
+  EXPECT_THAT(LogAndCount(4, 1000), Eq(4000));
+  EXPECT_THAT(eventlog_->dropped_events(), Eq(0));
+}
+
+TEST_F(AsyncEventLogTest, DroppingAccountsForEveryEvent) {
+  config_.set_thread_buffer_events(16);
+  config_.set_overflow(proto::EventLog::Drop);
+  Reopen();
+  std::size_t count = LogAndCount(4, 1000);
+  EXPECT_THAT(count + eventlog_->dropped_events(), Eq(4000));
+}
+
+TEST_F(AsyncEventLogTest, LoggingDuringShutdownAccountsForEveryEvent) {
+  config_.set_thread_buffer_events(16);
+  Reopen();
+  constexpr std::size_t kThreads = 4;
+  constexpr std::size_t kEventsPerThread = 20000;
+  std::atomic<std::size_t> started{0};
+  std::vector<std::thread> loggers;
+  for (std::size_t tidx = 0; tidx < kThreads; ++tidx) {
+    loggers.emplace_back([this, &started]() {
+      for (std::size_t eidx = 0; eidx < kEventsPerThread; ++eidx) {
+        context::proto::Event event;
+        event.set_verb("Event");
+        eventlog_->LogEvent(std::move(event));
+        if (!eidx) {
+          started++;
+        }
+      }
+    });
+  }
+  while (started < kThreads) {
+    std::this_thread::yield();
+  }
+  eventlog_->FlushAndClose();
+  for (auto& logger : loggers) {
+    logger.join();
+  }
+  std::size_t count = ReadCount();
+  EXPECT_THAT(count + eventlog_->dropped_events(), Eq(kThreads * kEventsPerThread));
+}
+
 }  // namespace
 }  // namespace file
 }  // namespace eventing
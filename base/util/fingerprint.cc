@@ -0,0 +1,110 @@
+// Copyright 2018 Intel Corporation.
+
+#include "base/util/fingerprint.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace vertexai {
+namespace {
+
+constexpr std::uint64_t c1 = 0x87c37b91114253d5ull;
+constexpr std::uint64_t c2 = 0x4cf5ad432745937full;
+
+inline std::uint64_t Rotl(std::uint64_t x, int r) { return (x << r) | (x >> (64 - r)); }
+
+inline std::uint64_t Mix(std::uint64_t k) {
+  k ^= k >> 33;
+  k *= 0xff51afd7ed558ccdull;
+  k ^= k >> 33;
+  k *= 0xc4ceb9fe1a85ec53ull;
+  k ^= k >> 33;
+  return k;
+}
+
+inline std::uint64_t Load(const unsigned char* p) {
+  std::uint64_t k;
+  std::memcpy(&k, p, sizeof(k));
+  return k;
+}
+
+}  // namespace
+
+void Fingerprinter::Block(std::uint64_t k1, std::uint64_t k2) {
+  k1 *= c1;
+  k1 = Rotl(k1, 31);
+  k1 *= c2;
+  h1_ ^= k1;
+  h1_ = Rotl(h1_, 27);
+  h1_ += h2_;
+  h1_ = h1_ * 5 + 0x52dce729;
+
+  k2 *= c2;
+  k2 = Rotl(k2, 33);
+  k2 *= c1;
+  h2_ ^= k2;
+  h2_ = Rotl(h2_, 31);
+  h2_ += h1_;
+  h2_ = h2_ * 5 + 0x38495ab5;
+}
+
+void Fingerprinter::Update(const void* data, std::size_t len) {
+  auto bytes = static_cast<const unsigned char*>(data);
+  std::size_t used = len_ % sizeof(tail_);
+  len_ += len;
+  if (used) {
+    std::size_t fill = std::min(len, sizeof(tail_) - used);
+    std::memcpy(tail_ + used, bytes, fill);
+    bytes += fill;
+    len -= fill;
+    if (used + fill < sizeof(tail_)) {
+      return;
+    }
+    Block(Load(tail_), Load(tail_ + 8));
+  }
+  for (; len >= sizeof(tail_); bytes += sizeof(tail_), len -= sizeof(tail_)) {
+    Block(Load(bytes), Load(bytes + 8));
+  }
+  std::memcpy(tail_, bytes, len);
+}
+
+void Fingerprinter::Update(const std::string& str) {
+  Update(static_cast<std::uint64_t>(str.size()));
+  Update(str.data(), str.size());
+}
+
+std::string Fingerprinter::Digest() const {
+  std::uint64_t h1 = h1_;
+  std::uint64_t h2 = h2_;
+  std::size_t rest = len_ % sizeof(tail_);
+  if (rest) {
+    unsigned char padded[sizeof(tail_)] = {};
+    std::memcpy(padded, tail_, rest);
+    std::uint64_t k1 = Load(padded);
+    std::uint64_t k2 = Load(padded + 8);
+    if (rest > 8) {
+      k2 *= c2;
+      k2 = Rotl(k2, 33);
+      k2 *= c1;
+      h2 ^= k2;
+    }
+    k1 *= c1;
+    k1 = Rotl(k1, 31);
+    k1 *= c2;
+    h1 ^= k1;
+  }
+  h1 ^= len_;
+  h2 ^= len_;
+  h1 += h2;
+  h2 += h1;
+  h1 = Mix(h1);
+  h2 = Mix(h2);
+  h1 += h2;
+  h2 += h1;
+  std::string digest(16, '\0');
+  std::memcpy(&digest[0], &h1, sizeof(h1));
+  std::memcpy(&digest[8], &h2, sizeof(h2));
+  return digest;
+}
+
+}  // namespace vertexai
@@ -0,0 +1,37 @@
+// Copyright 2018 Intel Corporation.
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+namespace vertexai {
+
+// Fingerprinter computes a 128-bit non-cryptographic content hash
+// (MurmurHash3 x64_128) over a stream of updates.  It's intended for
+// cache keys, where a lookup by fingerprint is followed by a check of
+// the actual content on a hit.
+class Fingerprinter {
+ public:
+  void Update(const void* data, std::size_t len);
+
+  // Adds a string, prefixed by its length so that the boundaries between
+  // successive strings are part of the fingerprint.
+  void Update(const std::string& str);
+
+  void Update(std::uint64_t value) { Update(&value, sizeof(value)); }
+
+  // Returns the 16-byte fingerprint of everything added so far.
+  std::string Digest() const;
+
+ private:
+  void Block(std::uint64_t k1, std::uint64_t k2);
+
+  std::uint64_t h1_ = 0;
+  std::uint64_t h2_ = 0;
+  std::uint64_t len_ = 0;
+  unsigned char tail_[16];
+};
+
+}  // namespace vertexai
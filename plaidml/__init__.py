@@ -707,6 +707,14 @@ class _Library(plaidml.library.Library):
         self.plaidml_schedule_invocation.restype = ctypes.POINTER(_C_Invocation)
         self.plaidml_schedule_invocation.errcheck = self._check_err
 
+        # PLAIDML_API plaidml_invocation_status plaidml_wait_for_invocation(plaidml_invocation* invocation);
+        self.plaidml_wait_for_invocation = lib.plaidml_wait_for_invocation
+        self.plaidml_wait_for_invocation.argtypes = [
+            ctypes.POINTER(_C_Invocation)  # plaidml_invocation* invocation
+        ]
+        self.plaidml_wait_for_invocation.restype = ctypes.c_int
+        self.plaidml_wait_for_invocation.errcheck = self._check_invocation_status
+
         # PLAIDML_API void plaidml_free_invocation(plaidml_invocation* invocation);
         self.plaidml_free_invocation = lib.plaidml_free_invocation
         self.plaidml_free_invocation.argtypes = [
@@ -745,6 +753,12 @@ class _Library(plaidml.library.Library):
             return None
         self.raise_last_status()
 
+    def _check_invocation_status(self, result, func, args):
+        # PLAIDML_INVOCATION_FAILED
+        if result == 2:
+            self.raise_last_status()
+        return result
+
 
 _impl_lib_lock = threading.Lock()
 _impl_lib = None
@@ -1437,6 +1451,10 @@ class Invocation(object):
         self._as_parameter_ = _lib().plaidml_schedule_invocation(ctx, invoker)
         self._free = _lib().plaidml_free_invocation
 
+    def wait(self):
+        """Blocks until the invocation completes, raising an exception if it failed."""
+        _lib().plaidml_wait_for_invocation(self)
+
     def __del__(self):
         if hasattr(self, '_free'):
             self._free(self)
@@ -25,6 +25,7 @@
 #include <string>
 #include <utility>
 
+#include <boost/asio.hpp>
 #include <boost/filesystem.hpp>
 
 #include "base/config/config.h"
@@ -1510,13 +1511,111 @@ extern "C" bool plaidml_save_invoker(plaidml_invoker* invoker, const char* filen
 
 // plaidml_invocation
 //
-// Currently, the actual invocation structure is a placeholder; it
-// represents a particular invocation of a Plaid function, but it
-// doesn't have any useful data.  The intention is that it gives us a
-// place to stand to query information about the invocation, attach
-// callbacks, &c.
+// An invocation tracks the completion of one particular run of a Plaid
+// function.  Completion is driven by the program's result future: its
+// continuation runs synchronously on whichever thread completes the run,
+// and immediately hands off to a small process-wide thread pool, so that
+// neither a thread per invocation nor the device's own threads are used to
+// deliver results to callers.
 
-struct plaidml_invocation {};
+namespace {
+
+boost::asio::thread_pool& InvocationCompletionPool() {
+  // N.B. Intentionally leaked, so that invocations completing during process
+  // exit never observe a destroyed pool.
+  static auto* pool = new boost::asio::thread_pool{2};
+  return *pool;
+}
+
+class InvocationCompletion final {
+ public:
+  explicit InvocationCompletion(std::shared_ptr<context::Rundown> rundown) : rundown_{std::move(rundown)} {}
+
+  // Records the outcome of the invocation, and invokes the callback, if any.
+  void Complete(std::exception_ptr error) noexcept {
+    void (*callback)(void* arg, plaidml_invocation_status status);
+    void* arg;
+    plaidml_invocation_status status = error ? PLAIDML_INVOCATION_FAILED : PLAIDML_INVOCATION_SUCCEEDED;
+    {
+      std::lock_guard<std::mutex> lock{mu_};
+      status_ = status;
+      error_ = error;
+      callback = callback_;
+      arg = arg_;
+      rundown_.reset();
+    }
+    cv_.notify_all();
+    if (callback) {
+      Invoke(callback, arg, status, error);
+    }
+  }
+
+  plaidml_invocation_status GetStatus() noexcept {
+    std::lock_guard<std::mutex> lock{mu_};
+    return ReportLocked();
+  }
+
+  plaidml_invocation_status Wait() noexcept {
+    std::unique_lock<std::mutex> lock{mu_};
+    cv_.wait(lock, [this]() { return status_ != PLAIDML_INVOCATION_PENDING; });
+    return ReportLocked();
+  }
+
+  bool SetCallback(void (*callback)(void* arg, plaidml_invocation_status status), void* arg) noexcept {
+    plaidml_invocation_status status;
+    std::exception_ptr error;
+    {
+      std::lock_guard<std::mutex> lock{mu_};
+      if (callback_) {
+        vertexai::SetLastStatus(VAI_STATUS_FAILED_PRECONDITION, "The invocation already has a callback");
+        return false;
+      }
+      callback_ = callback;
+      arg_ = arg;
+      status = status_;
+      error = error_;
+    }
+    if (status != PLAIDML_INVOCATION_PENDING) {
+      Invoke(callback, arg, status, error);
+    }
+    return true;
+  }
+
+ private:
+  static void Invoke(void (*callback)(void* arg, plaidml_invocation_status status), void* arg,
+                     plaidml_invocation_status status, std::exception_ptr error) noexcept {
+    if (error) {
+      vertexai::SetLastException(error);
+    } else {
+      vai_clear_status();
+    }
+    callback(arg, status);
+  }
+
+  plaidml_invocation_status ReportLocked() noexcept {
+    if (error_) {
+      vertexai::SetLastException(error_);
+    }
+    return status_;
+  }
+
+  std::mutex mu_;
+  std::condition_variable cv_;
+  plaidml_invocation_status status_ = PLAIDML_INVOCATION_PENDING;
+  std::exception_ptr error_;
+  void (*callback_)(void* arg, plaidml_invocation_status status) = nullptr;
+  void* arg_ = nullptr;
+
+  // Held until the invocation completes, so that the context's gate waits
+  // for the invocation.
+  std::shared_ptr<context::Rundown> rundown_;
+};
+
+}  // namespace
+
+struct plaidml_invocation {
+  std::shared_ptr<InvocationCompletion> completion;
+};
 
 extern "C" plaidml_invocation* plaidml_schedule_invocation(vai_ctx* ctx, plaidml_invoker* invoker) {
   if (!ctx || !invoker) {
@@ -1525,9 +1624,10 @@ extern "C" plaidml_invocation* plaidml_schedule_invocation(vai_ctx* ctx, plaidml
   }
   context::Activity activity{ctx->activity.ctx(), "plaidml::invoker::ScheduleInvocation"};
   try {
-    auto invocation = std::make_unique<plaidml_invocation>();
     auto rundown = std::make_shared<context::Rundown>();
     rundown->TryEnterGate(activity.ctx().gate());
+    auto completion = std::make_shared<InvocationCompletion>(std::move(rundown));
+    auto invocation = std::make_unique<plaidml_invocation>(plaidml_invocation{completion});
     BuildInvokerRunInfo(invoker);
 
     // Gather up the appropriate buffers
@@ -1558,6 +1658,10 @@ extern "C" plaidml_invocation* plaidml_schedule_invocation(vai_ctx* ctx, plaidml
     for (const auto& kv : invoker->runinfo->output_shapes) {
       *(*prog.mutable_outputs())[kv.first].mutable_shape() = tile::IntoProto(kv.second);
     }
+    if (invoker->runinfo->fingerprint.empty()) {
+      invoker->runinfo->fingerprint = tile::ProgramFingerprint(prog);
+    }
+    prog.set_fingerprint(invoker->runinfo->fingerprint);
 
     size_t max_trials = 1;
     auto env_trials = vertexai::env::Get("PLAIDML_KERNEL_TRIALS");
@@ -1581,18 +1685,38 @@ extern "C" plaidml_invocation* plaidml_schedule_invocation(vai_ctx* ctx, plaidml
     params->set_max_trials(max_trials);
     params->set_max_trial_runs(max_trial_runs);
 
+    auto env_budget = vertexai::env::Get("PLAIDML_KERNEL_TUNING_MS");
+    if (env_budget.length()) {
+      params->set_max_tuning_ms(std::strtoull(env_budget.c_str(), nullptr, 10));
+    }
+
+    auto env_ratio = vertexai::env::Get("PLAIDML_KERNEL_TUNING_MIN_SCORE_RATIO");
+    if (env_ratio.length()) {
+      params->set_min_score_ratio(std::atof(env_ratio.c_str()));
+    }
+
+    auto env_threads = vertexai::env::Get("PLAIDML_KERNEL_TUNING_THREADS");
+    if (env_threads.length()) {
+      params->set_compile_threads(std::strtoull(env_threads.c_str(), nullptr, 10));
+    }
+
     auto program = evaluator->MakeProgram(activity.ctx(), prog);
 
     // Run the program
     auto result = program->Run(activity.ctx(), in_buffers, out_buffers);
-    result.then(boost::launch::async, [rundown = std::move(rundown)](decltype(result) fut) {
-      try {
-        fut.get();
-      } catch (const std::exception& ex) {
-        // TODO: We need a better way to notify users if the asynchronous results
-        // of an invocation are valid, perhaps by allowing a callback to be specified.
-        LOG(ERROR) << ex.what();
-      }
+    result.then(boost::launch::sync, [completion = std::move(completion)](decltype(result) fut) {
+      boost::asio::post(InvocationCompletionPool(), [completion, fut = std::move(fut)]() mutable {
+        std::exception_ptr error;
+        try {
+          fut.get();
+        } catch (const std::exception& ex) {
+          LOG(ERROR) << ex.what();
+          error = std::current_exception();
+        } catch (...) {
+          error = std::current_exception();
+        }
+        completion->Complete(error);
+      });
     });
 
     return invocation.release();
@@ -1602,6 +1726,32 @@ extern "C" plaidml_invocation* plaidml_schedule_invocation(vai_ctx* ctx, plaidml
   }
 }
 
+extern "C" plaidml_invocation_status plaidml_get_invocation_status(plaidml_invocation* invocation) {
+  if (!invocation) {
+    vertexai::SetLastOOM();
+    return PLAIDML_INVOCATION_FAILED;
+  }
+  return invocation->completion->GetStatus();
+}
+
+extern "C" plaidml_invocation_status plaidml_wait_for_invocation(plaidml_invocation* invocation) {
+  if (!invocation) {
+    vertexai::SetLastOOM();
+    return PLAIDML_INVOCATION_FAILED;
+  }
+  return invocation->completion->Wait();
+}
+
+extern "C" bool plaidml_set_invocation_callback(plaidml_invocation* invocation,
+                                                void (*callback)(void* arg, plaidml_invocation_status status),
+                                                void* arg) {
+  if (!invocation || !callback) {
+    vertexai::SetLastOOM();
+    return false;
+  }
+  return invocation->completion->SetCallback(callback, arg);
+}
+
 extern "C" void plaidml_free_invocation(plaidml_invocation* invocation) { delete invocation; }
 
 // plaidml_gradient
@@ -547,15 +547,48 @@ typedef struct plaidml_invocation plaidml_invocation;
 // Note that this call may return before the computation described by
 // the function has actually completed; the computation is scheduled,
 // not complete.  Errors that occur asynchronously will be reported
-// when the buffers updated by running the function are remapped.
+// when the buffers updated by running the function are remapped, and
+// via the invocation's completion status (see below).
 //
 // Once this call returns, the invoker's inputs and outputs may be set
 // by the caller, and the invoker may be used for another run of the
 // invoker's function, even if the first run has not yet completed.
 PLAIDML_API plaidml_invocation* plaidml_schedule_invocation(vai_ctx* ctx, plaidml_invoker* invoker);
 
+// The completion status of an invocation.
+typedef enum {
+  PLAIDML_INVOCATION_PENDING = 0,
+  PLAIDML_INVOCATION_SUCCEEDED = 1,
+  PLAIDML_INVOCATION_FAILED = 2,
+} plaidml_invocation_status;
+
+// Returns the invocation's current completion status, without blocking.
+// If the invocation failed, the current thread's status is set to describe
+// the failure.
+PLAIDML_API plaidml_invocation_status plaidml_get_invocation_status(plaidml_invocation* invocation);
+
+// Blocks until the invocation completes, and returns its completion status.
+// If the invocation failed, the current thread's status is set to describe
+// the failure.
+PLAIDML_API plaidml_invocation_status plaidml_wait_for_invocation(plaidml_invocation* invocation);
+
+// Arranges for the supplied callback to be invoked once the invocation
+// completes.  The library guarantees to invoke the callback exactly once,
+// even if the invocation is freed first; if the invocation failed, the
+// status of the thread invoking the callback describes the failure.
+//
+// Callbacks are invoked on a library-owned thread shared by all
+// invocations, and should not block.  The library may invoke the callback
+// synchronously if the invocation has already completed.  An invocation
+// may have at most one callback; this call returns false if a callback has
+// already been set.
+PLAIDML_API bool plaidml_set_invocation_callback(plaidml_invocation* invocation,
+                                                 void (*callback)(void* arg, plaidml_invocation_status status),
+                                                 void* arg);
+
 // Frees an invocation.  After this call, the invocation should not be
 // used for any subsequent calls.  Freeing a NULL invocation is a no-op.
+// Freeing an invocation does not cancel it.
 PLAIDML_API void plaidml_free_invocation(plaidml_invocation* invocation);
 
 // A PlaidML gradient computes gradient data for a given scalar.
@@ -10,6 +10,7 @@
 #include "testing/matchers.h"
 #include "testing/plaidml_config.h"
 
+using ::testing::Eq;
 using ::testing::Gt;
 using ::testing::IsVaiStatus;
 using ::testing::Not;
@@ -153,6 +154,17 @@ TEST(PlaidML_C_API, BroadcastOne) {
 
   EXPECT_THAT(vai_last_status(), IsVaiStatus(VAI_STATUS_OK));
 
+  EXPECT_THAT(plaidml_wait_for_invocation(invocation.get()), Eq(PLAIDML_INVOCATION_SUCCEEDED));
+  EXPECT_THAT(plaidml_get_invocation_status(invocation.get()), Eq(PLAIDML_INVOCATION_SUCCEEDED));
+  plaidml_invocation_status callback_status = PLAIDML_INVOCATION_PENDING;
+  EXPECT_THAT(plaidml_set_invocation_callback(invocation.get(),
+                                              [](void* arg, plaidml_invocation_status status) {
+                                                *static_cast<plaidml_invocation_status*>(arg) = status;
+                                              },
+                                              &callback_status),
+              Eq(true));
+  EXPECT_THAT(callback_status, Eq(PLAIDML_INVOCATION_SUCCEEDED));
+
   {
     std::unique_ptr<plaidml_mapping> c_map{plaidml_map_buffer_current(c_buf.get(), nullptr, nullptr)};
     EXPECT_THAT(vai_last_status(), IsVaiStatus(VAI_STATUS_OK));
@@ -2,16 +2,23 @@
 
 #pragma once
 
+#include <cstdint>
+#include <exception>
 #include <functional>
+#include <future>
 #include <list>
 #include <map>
 #include <mutex>
+#include <utility>
+#include <vector>
 
 namespace vertexai {
 namespace tile {
 
 // A simplistic LRU cache implementation.
-// The cache must be externally synchronized.
+// The cache is internally synchronized, and values are built outside of the
+// cache lock: lookups of distinct keys proceed in parallel, while concurrent
+// lookups of the same key share a single in-flight build.
 // Value must be CopyConstructible.
 template <typename Key, typename Value, typename Compare = std::less<Key>>
 class LruCache {
@@ -21,43 +28,70 @@ class LruCache {
   // Finds the value associated with the specified key.  If the value is not in
   // the cache, Builder() will be invoked to construct it; this adds a value to
   // the cache, which may result in an eviction of the least recently used
-  // entry in the cache.  If an exception is thrown by the builder, the cache
-  // is left unmodified, as if this function was never called (strong exception
-  // guarantee).
+  // entry in the cache.  If another thread is already building the value for
+  // this key, this call waits for that build rather than starting another.
+  // If an exception is thrown by the builder, the entry is removed from the
+  // cache (as if this function was never called), and the exception is
+  // delivered to every caller waiting on that build.
   template <typename Builder>
   Value Lookup(const Key& key, const Builder& builder) {
-    std::unique_lock<std::mutex> lock{mu_};
-
-    auto it = entries_.find(key);
-
-    if (it != entries_.end()) {
-      lru_.erase(it->second.lru_ent);
-      it->second.lru_ent = lru_.emplace(lru_.begin(), LruEnt{it});
-      return it->second.value;
+    if (!size_max_) {
+      return builder();
     }
 
-    Value result = builder();
-    if (size_max_ > 0) {
-      it = entries_.emplace(key, MapEnt{result, lru_.end()}).first;
-      while (lru_.size() > 0 && size_max_ < entries_.size()) {
+    std::promise<Value> promise;
+    std::shared_future<Value> result = promise.get_future().share();
+    std::uint64_t serial;
+    std::vector<std::shared_future<Value>> evicted;
+    {
+      std::unique_lock<std::mutex> lock{mu_};
+      auto it = entries_.find(key);
+      if (it != entries_.end()) {
+        lru_.splice(lru_.begin(), lru_, it->second.lru_ent);
+        result = it->second.value;
+        lock.unlock();
+        return result.get();
+      }
+      serial = next_serial_++;
+      it = entries_.emplace(key, MapEnt{result, serial, lru_.end()}).first;
+      it->second.lru_ent = lru_.emplace(lru_.begin(), LruEnt{it});
+      while (size_max_ < entries_.size()) {
+        // Evicted values are released after the lock is dropped, so that
+        // destroying them never stalls other lookups.
+        evicted.emplace_back(std::move(lru_.back().map_ent->second.value));
         entries_.erase(lru_.back().map_ent);
         lru_.pop_back();
       }
-      it->second.lru_ent = lru_.emplace(lru_.begin(), LruEnt{it});
     }
-    return result;
+    evicted.clear();
+
+    try {
+      promise.set_value(builder());
+    } catch (...) {
+      {
+        std::lock_guard<std::mutex> lock{mu_};
+        auto it = entries_.find(key);
+        if (it != entries_.end() && it->second.serial == serial) {
+          lru_.erase(it->second.lru_ent);
+          entries_.erase(it);
+        }
+      }
+      promise.set_exception(std::current_exception());
+    }
+    return result.get();
   }
 
  private:
   struct LruEnt;
 
   struct MapEnt {
-    Value value;
+    std::shared_future<Value> value;
+    std::uint64_t serial;
     typename std::list<LruEnt>::iterator lru_ent;
   };
 
   struct LruEnt {
-    typename std::map<Key, MapEnt>::iterator map_ent;
+    typename std::map<Key, MapEnt, Compare>::iterator map_ent;
   };
 
   // The maximum cache size.
@@ -66,6 +100,9 @@ class LruCache {
   // The map/LRU mutex.
   std::mutex mu_;
 
+  // Distinguishes successive builds of the same key.
+  std::uint64_t next_serial_ = 0;
+
   // The entry lookup map.
   std::map<Key, MapEnt, Compare> entries_;
 
@@ -0,0 +1,73 @@
+// Copyright 2018 Intel Corporation.
+
+#include <gmock/gmock.h>
+
+#include <atomic>
+#include <future>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "tile/base/lru_cache.h"
+
+using ::testing::Eq;
+
+namespace vertexai {
+namespace tile {
+namespace {
+
+TEST(LruCache, EvictsLeastRecentlyUsed) {
+  LruCache<int, std::string> cache{2};
+  int builds = 0;
+  auto build = [&](int i) { return [&builds, i]() { ++builds; return std::to_string(i); }; };
+  EXPECT_THAT(cache.Lookup(1, build(1)), Eq("1"));
+  EXPECT_THAT(cache.Lookup(2, build(2)), Eq("2"));
+  EXPECT_THAT(cache.Lookup(1, build(1)), Eq("1"));
+  EXPECT_THAT(cache.Lookup(3, build(3)), Eq("3"));  // Evicts 2
+  EXPECT_THAT(builds, Eq(3));
+  EXPECT_THAT(cache.Lookup(1, build(1)), Eq("1"));
+  EXPECT_THAT(builds, Eq(3));
+  EXPECT_THAT(cache.Lookup(2, build(2)), Eq("2"));
+  EXPECT_THAT(builds, Eq(4));
+}
+
+TEST(LruCache, FailedBuildIsNotCached) {
+  LruCache<int, int> cache{2};
+  EXPECT_THROW(cache.Lookup(1, []() -> int { throw std::runtime_error{"failed"}; }), std::runtime_error);
+  EXPECT_THAT(cache.Lookup(1, []() { return 5; }), Eq(5));
+}
+
+TEST(LruCache, ConcurrentLookupsShareOneBuild) {
+  LruCache<int, int> cache{4};
+  std::atomic<int> builds{0};
+  std::promise<void> started;
+  std::promise<void> release;
+  auto gate = release.get_future().share();
+  std::vector<std::thread> threads;
+  std::vector<int> results(8);
+  for (std::size_t t = 0; t < results.size(); ++t) {
+    threads.emplace_back([&, t]() {
+      results[t] = cache.Lookup(1, [&]() {
+        if (++builds == 1) {
+          started.set_value();
+        }
+        gate.wait();
+        return 42;
+      });
+    });
+  }
+  // Once the build is in flight, a different key must not be blocked by it.
+  started.get_future().wait();
+  EXPECT_THAT(cache.Lookup(2, []() { return 7; }), Eq(7));
+  release.set_value();
+  for (auto& thread : threads) {
+    thread.join();
+  }
+  EXPECT_THAT(builds.load(), Eq(1));
+  EXPECT_THAT(results, ::testing::Each(Eq(42)));
+}
+
+}  // namespace
+}  // namespace tile
+}  // namespace vertexai
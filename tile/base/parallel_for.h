@@ -0,0 +1,116 @@
+// Copyright 2018 Intel Corporation.
+
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include <boost/asio/post.hpp>
+#include <boost/asio/thread_pool.hpp>
+
+namespace vertexai {
+namespace tile {
+
+// Returns the number of threads to use for a requested thread count, where
+// zero means one thread per hardware thread.
+inline std::size_t ResolveThreadCount(std::size_t threads) {
+  if (threads) {
+    return threads;
+  }
+  return std::max<std::size_t>(1, std::thread::hardware_concurrency());
+}
+
+namespace detail {
+
+// The process-wide pool on which ParallelFor runs its helper threads, with one
+// thread per hardware thread.
+inline boost::asio::thread_pool& ParallelForPool() {
+  static boost::asio::thread_pool pool{ResolveThreadCount(0)};
+  return pool;
+}
+
+}  // namespace detail
+
+// Calls body(idx) for every idx in [0, count), using up to `threads` threads
+// (zero meaning one per hardware thread), and returns once every call has
+// finished.  The calling thread participates; iterations are handed out one
+// at a time, so uneven iterations balance across the threads.  The other
+// threads come from a single process-wide pool, so concurrent and nested
+// calls share the hardware threads rather than each starting threads of
+// their own; a call never waits for a helper that hasn't started.
+//
+// If any iterations throw, the remaining iterations still run, and the
+// exception from the lowest-numbered failing iteration is rethrown, so that
+// errors are reported the same way regardless of scheduling or thread count.
+template <typename Body>
+void ParallelFor(std::size_t count, std::size_t threads, const Body& body) {
+  threads = std::min(ResolveThreadCount(threads), count);
+  std::vector<std::exception_ptr> errors(count);
+  auto run = [&](std::size_t idx) {
+    try {
+      body(idx);
+    } catch (...) {
+      errors[idx] = std::current_exception();
+    }
+  };
+
+  if (threads <= 1) {
+    for (std::size_t idx = 0; idx < count; ++idx) {
+      run(idx);
+    }
+  } else {
+    // Helpers may start after the caller has finished every iteration (even
+    // after it has returned), so the state they check lives on the heap, and
+    // a helper that finds the call closed leaves without touching anything
+    // else.
+    struct State {
+      std::mutex mu;
+      std::condition_variable cv;
+      std::atomic<std::size_t> next{0};
+      std::size_t active = 0;  // Guarded by mu
+      bool closed = false;     // Guarded by mu
+    };
+    auto state = std::make_shared<State>();
+    auto helper = [state, count, &run]() {
+      {
+        std::lock_guard<std::mutex> lock{state->mu};
+        if (state->closed) {
+          return;
+        }
+        ++state->active;
+      }
+      for (std::size_t idx = state->next++; idx < count; idx = state->next++) {
+        run(idx);
+      }
+      std::lock_guard<std::mutex> lock{state->mu};
+      if (!--state->active) {
+        state->cv.notify_all();
+      }
+    };
+    for (std::size_t thread = 1; thread < threads; ++thread) {
+      boost::asio::post(detail::ParallelForPool(), helper);
+    }
+    for (std::size_t idx = state->next++; idx < count; idx = state->next++) {
+      run(idx);
+    }
+    std::unique_lock<std::mutex> lock{state->mu};
+    state->closed = true;
+    state->cv.wait(lock, [&state]() { return !state->active; });
+  }
+
+  for (const auto& error : errors) {
+    if (error) {
+      std::rethrow_exception(error);
+    }
+  }
+}
+
+}  // namespace tile
+}  // namespace vertexai
@@ -0,0 +1,86 @@
+// Copyright 2018 Intel Corporation.
+
+#include <gmock/gmock.h>
+
+#include <algorithm>
+#include <atomic>
+#include <mutex>
+#include <set>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "tile/base/parallel_for.h"
+
+using ::testing::Eq;
+
+namespace vertexai {
+namespace tile {
+namespace {
+
+TEST(ParallelFor, VisitsEveryIndexOnce) {
+  std::vector<std::atomic<int>> visits(1000);
+  ParallelFor(visits.size(), 8, [&](std::size_t idx) { visits[idx]++; });
+  for (const auto& count : visits) {
+    EXPECT_THAT(count.load(), Eq(1));
+  }
+}
+
+TEST(ParallelFor, UsesMultipleThreads) {
+  // The shared pool has a thread per hardware thread, besides the caller.
+  std::size_t threads = std::min<std::size_t>(4, ResolveThreadCount(0) + 1);
+  std::mutex mu;
+  std::set<std::thread::id> ids;
+  std::atomic<std::size_t> waiting{0};
+  ParallelFor(threads, threads, [&](std::size_t) {
+    {
+      std::lock_guard<std::mutex> lock{mu};
+      ids.insert(std::this_thread::get_id());
+    }
+    // Hold every iteration until all of them are running at once.
+    waiting++;
+    while (waiting < threads) {
+      std::this_thread::yield();
+    }
+  });
+  EXPECT_THAT(ids.size(), Eq(threads));
+}
+
+TEST(ParallelFor, NestedCallsComplete) {
+  std::vector<std::atomic<int>> visits(64 * 64);
+  ParallelFor(64, 0, [&](std::size_t outer) {
+    ParallelFor(64, 0, [&](std::size_t inner) { visits[outer * 64 + inner]++; });
+  });
+  for (const auto& count : visits) {
+    EXPECT_THAT(count.load(), Eq(1));
+  }
+}
+
+TEST(ParallelFor, RunsInlineForOneThread) {
+  std::vector<std::size_t> order;
+  ParallelFor(5, 1, [&](std::size_t idx) { order.push_back(idx); });
+  EXPECT_THAT(order, Eq(std::vector<std::size_t>{0, 1, 2, 3, 4}));
+}
+
+TEST(ParallelFor, RethrowsLowestFailingIteration) {
+  for (std::size_t threads : {1, 4}) {
+    std::atomic<int> calls{0};
+    try {
+      ParallelFor(100, threads, [&](std::size_t idx) {
+        calls++;
+        if (idx % 10 == 7) {
+          throw std::runtime_error(std::to_string(idx));
+        }
+      });
+      FAIL() << "Expected an exception";
+    } catch (const std::runtime_error& ex) {
+      EXPECT_THAT(std::string(ex.what()), Eq("7"));
+    }
+    EXPECT_THAT(calls.load(), Eq(100)) << "with " << threads << " threads";
+  }
+}
+
+}  // namespace
+}  // namespace tile
+}  // namespace vertexai
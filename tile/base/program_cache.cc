@@ -3,8 +3,8 @@
 #include "tile/base/program_cache.h"
 
 #include <map>
-#include <sstream>
 
+#include "base/util/fingerprint.h"
 #include "base/util/logging.h"
 
 namespace vertexai {
@@ -30,51 +30,100 @@ std::shared_ptr<lang::Program> ProgramCache::GetParsedProgram(const context::Con
 namespace {
 
 template <typename M>
-void SerializeShapemap(std::ostringstream* serialized, const M& m) {
-  std::map<std::string, const proto::TensorShape&> shapes;
+void FingerprintShapemap(Fingerprinter* fp, const M& m) {
+  std::map<std::string, const proto::TensorShape*> shapes;
   for (const auto& t : m) {
-    shapes.emplace(t.first, t.second.shape());
+    shapes.emplace(t.first, &t.second.shape());
   }
+  fp->Update(static_cast<std::uint64_t>(shapes.size()));
   for (const auto& t : shapes) {
-    (*serialized) << t.first.length() << ':';
-    (*serialized) << t.first;
-    (*serialized) << t.second.type() << ':';
-    for (const auto& dim : t.second.dims()) {
-      (*serialized) << dim.size() << '/' << dim.stride() << ':';
+    fp->Update(t.first);
+    fp->Update(static_cast<std::uint64_t>(t.second->type()));
+    fp->Update(static_cast<std::uint64_t>(t.second->dims_size()));
+    for (const auto& dim : t.second->dims()) {
+      fp->Update(static_cast<std::uint64_t>(dim.size()));
+      fp->Update(static_cast<std::uint64_t>(dim.stride()));
     }
   }
 }
 
+template <typename M>
+bool SameShapemap(const M& lhs, const M& rhs) {
+  if (lhs.size() != rhs.size()) {
+    return false;
+  }
+  for (const auto& t : lhs) {
+    auto it = rhs.find(t.first);
+    if (it == rhs.end()) {
+      return false;
+    }
+    const auto& ls = t.second.shape();
+    const auto& rs = it->second.shape();
+    if (ls.type() != rs.type() || ls.dims_size() != rs.dims_size()) {
+      return false;
+    }
+    for (int i = 0; i < ls.dims_size(); ++i) {
+      if (ls.dims(i).size() != rs.dims(i).size() || ls.dims(i).stride() != rs.dims(i).stride()) {
+        return false;
+      }
+    }
+  }
+  return true;
+}
+
 }  // namespace
 
+std::string ProgramFingerprint(const tile::proto::Program& program) {
+  // N.B. For cache lookup, we only fingerprint the parts of the program that
+  // matter to the actual code generation.
+  Fingerprinter fp;
+  fp.Update(program.code());
+  FingerprintShapemap(&fp, program.inputs());
+  FingerprintShapemap(&fp, program.outputs());
+  return fp.Digest();
+}
+
 std::shared_ptr<ProgramCache::Entry> ProgramCache::GetEntry(const std::string& fallback_id,
                                                             const tile::proto::Program& program) {
-  std::ostringstream serialized;
+  Key key{program.dev_id(), program.fingerprint()};
+  if (key.fingerprint.empty()) {
+    key.fingerprint = ProgramFingerprint(program);
+  }
 
-  // N.B. For cache lookup, we only serialize the parts of the program that
-  // matter to the actual code generation.
-  serialized << program.code().length() << ':';
-  serialized << program.code();
+  // N.B. The cache is internally synchronized, and the builder runs outside
+  // of its lock; concurrent requests for the same program share one entry.
+  auto entry = cache_.Lookup(key, [&]() { return MakeEntry(fallback_id, program); });
+  if (!entry->Matches(program)) {
+    LOG(WARNING) << "Program cache fingerprint collision with " << entry->id() << "; compiling uncached";
+    return MakeEntry(fallback_id, program);
+  }
+  return entry;
+}
 
-  SerializeShapemap(&serialized, program.inputs());
-  SerializeShapemap(&serialized, program.outputs());
+std::shared_ptr<ProgramCache::Entry> ProgramCache::MakeEntry(const std::string& fallback_id,
+                                                             const tile::proto::Program& program) {
+  std::string cid = "c" + std::to_string(next_id_++);
+  if (program.id().size()) {
+    cid = cid + '_' + program.id();
+  } else if (fallback_id.size()) {
+    cid = cid + '_' + fallback_id;
+  }
+  VLOG(3) << "Compiling program as " << cid;
+  tile::proto::Program cprog;
+  cprog.CopyFrom(program);
+  cprog.set_id(cid);
+  return std::make_shared<ProgramCache::Entry>(cid, cprog);
+}
 
-  // The cache itself must be externally synchronized.
-  std::lock_guard<std::mutex> lock{mu_};
+ProgramCache::Entry::Entry(std::string id, tile::proto::Program proto) : id_{std::move(id)}, proto_{std::move(proto)} {
+  key_.set_code(proto_.code());
+  *key_.mutable_inputs() = proto_.inputs();
+  *key_.mutable_outputs() = proto_.outputs();
+}
 
-  return cache_.Lookup(Key{program.dev_id(), serialized.str()}, [&]() {
-    std::string cid = "c" + std::to_string(next_id_++);
-    if (program.id().size()) {
-      cid = cid + '_' + program.id();
-    } else if (fallback_id.size()) {
-      cid = cid + '_' + fallback_id;
-    }
-    VLOG(3) << "Compiling program as " << cid;
-    tile::proto::Program cprog;
-    cprog.CopyFrom(program);
-    cprog.set_id(cid);
-    return std::make_shared<ProgramCache::Entry>(cid, cprog);
-  });
+bool ProgramCache::Entry::Matches(const tile::proto::Program& program) const {
+  return key_.code() == program.code() && SameShapemap(key_.inputs(), program.inputs()) &&
+         SameShapemap(key_.outputs(), program.outputs());
 }
 
 std::shared_ptr<Program> ProgramCache::Entry::GetProgram(const context::Context& ctx, Platform* dev) {
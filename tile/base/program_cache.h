@@ -2,6 +2,7 @@
 
 #pragma once
 
+#include <atomic>
 #include <memory>
 #include <mutex>
 #include <string>
@@ -18,6 +19,12 @@
 namespace vertexai {
 namespace tile {
 
+// Computes the program cache fingerprint: a 128-bit hash of the program's code
+// and of its input and output shapes, in name order.  Programs with the same
+// fingerprint are treated as identical by the cache (after verifying the
+// content on a hit).
+std::string ProgramFingerprint(const tile::proto::Program& program);
+
 // ProgramCache implements an LRU Tile program cache.
 class ProgramCache final {
  public:
@@ -40,7 +47,7 @@ class ProgramCache final {
  private:
   struct Key {
     std::string subdevice;
-    std::string ops;
+    std::string fingerprint;
   };
 
   struct KeyComp {
@@ -51,16 +58,20 @@ class ProgramCache final {
       if (rhs.subdevice < lhs.subdevice) {
         return false;
       }
-      return lhs.ops < rhs.ops;
+      return lhs.fingerprint < rhs.fingerprint;
     }
   };
 
   class Entry {
    public:
-    Entry(std::string id, tile::proto::Program proto) : id_{std::move(id)}, proto_{std::move(proto)} {}
+    Entry(std::string id, tile::proto::Program proto);
 
     const std::string& id() const { return id_; }
 
+    // Checks whether the entry was built from the same code and shapes as the
+    // supplied program; used to guard against fingerprint collisions.
+    bool Matches(const tile::proto::Program& program) const;
+
     std::shared_ptr<Program> GetProgram(const context::Context& ctx, Platform* dev);
 
     std::shared_ptr<lang::Program> GetParsedProgram();
@@ -69,16 +80,18 @@ class ProgramCache final {
     std::string id_;
     std::once_flag compile_once_, parse_once_;
     tile::proto::Program proto_;
+    tile::proto::Program key_;
     std::shared_ptr<Program> compiled_;
     std::shared_ptr<lang::Program> parsed_;
   };
 
   std::shared_ptr<Entry> GetEntry(const std::string& fallback_id, const tile::proto::Program& program);
 
+  std::shared_ptr<Entry> MakeEntry(const std::string& fallback_id, const tile::proto::Program& program);
+
   std::shared_ptr<Platform> platform_;
 
-  std::mutex mu_;
-  int next_id_ = 1;
+  std::atomic<int> next_id_{1};
   LruCache<Key, std::shared_ptr<Entry>, KeyComp> cache_;
 };
 
@@ -2,6 +2,8 @@
 
 #include "tile/codegen/jit.h"
 
+#include <google/protobuf/io/coded_stream.h>
+#include <google/protobuf/io/zero_copy_stream_impl_lite.h>
 #include <llvm/ExecutionEngine/ExecutionEngine.h>
 #include <llvm/IR/IRBuilder.h>
 #include <llvm/IR/LegacyPassManager.h>
@@ -10,11 +12,24 @@
 #include <llvm/Transforms/IPO/PassManagerBuilder.h>
 
 #include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstdlib>
+#include <cstring>
 #include <deque>
+#include <functional>
 #include <memory>
+#include <mutex>
+#include <utility>
+#include <vector>
 
+#include <boost/asio.hpp>
+#include <boost/thread/thread.hpp>
 #include <half.hpp>
 
+#include "base/util/fingerprint.h"
+#include "base/util/logging.h"
+#include "tile/base/lru_cache.h"
 #include "tile/stripe/stripe.h"
 
 namespace vertexai {
@@ -23,16 +38,178 @@ namespace codegen {
 
 namespace {
 const char invoker_name_[] = "__invoke_";
+const char parallel_for_name_[] = "__parallel_for_";
+const char zero_name_[] = "__zero_region_";
+const char copy_name_[] = "__copy_region_";
+
+// An index carrying this tag (as set by partitioning for compute units) is
+// preferred when choosing which loop of a block to run in parallel.
+const char parallel_idx_tag_[] = "proc";
+
+// The number of compiled programs retained by JitCompile.
+constexpr std::size_t kProgramCacheSize = 64;
+
+// A refinement which is neither in nor out, and has no "from" name, is a new
+// buffer allocated for the block's use.
+bool IsLocalAllocation(const stripe::Refinement& ref) {
+  return ref.dir == stripe::RefDir::None && ref.from.empty();
+}
+
+// Checks whether distinct values of the named index always address disjoint
+// regions of the refinement: some dimension must be accessed by that index
+// alone, with a stride at least as large as the dimension's interior size.
+bool IndexPartitions(const stripe::Refinement& ref, const std::string& idx_name) {
+  for (size_t i = 0; i < ref.access.size(); ++i) {
+    const auto& terms = ref.access[i].getMap();
+    auto it = terms.find(idx_name);
+    if (it == terms.end()) {
+      continue;
+    }
+    bool alone = std::all_of(terms.begin(), terms.end(), [&](const auto& term) {
+      return term.first.empty() || term.first == idx_name;
+    });
+    if (alone && static_cast<uint64_t>(std::abs(it->second)) >= ref.interior_shape.dims[i].size) {
+      return true;
+    }
+  }
+  return false;
+}
+
+// Returns the layout of a shape's elements in row-major order, as (size,
+// stride) pairs: unit dimensions are dropped, and dimensions laid out
+// contiguously within their parent are merged into it, as the runtime's
+// Region does.  Two shapes with the same layout address the same elements of
+// a buffer in the same order.
+std::vector<std::pair<uint64_t, int64_t>> CanonicalLayout(const TensorShape& shape) {
+  std::vector<std::pair<uint64_t, int64_t>> dims;
+  for (const auto& dim : shape.dims) {
+    if (dim.size == 1) {
+      continue;
+    }
+    if (dims.size() && dims.back().second == dim.stride * static_cast<int64_t>(dim.size)) {
+      dims.back() = std::make_pair(dims.back().first * dim.size, dim.stride);
+    } else {
+      dims.emplace_back(dim.size, dim.stride);
+    }
+  }
+  return dims;
+}
+
+// Checks whether a statement uses (or, when writes_only is set, writes) the
+// named buffer of the current block.  A nested block's refinements name their
+// parent buffers by "from", or by "into" when it's empty.
+bool Touches(const stripe::Statement& stmt, const std::string& name, bool writes_only) {
+  std::vector<std::string> names;
+  auto inner = dynamic_cast<const stripe::Block*>(&stmt);
+  if (inner) {
+    for (const auto& ref : inner->refs) {
+      if (!IsLocalAllocation(ref) && (!writes_only || stripe::IsWriteDir(ref.dir))) {
+        names.push_back(ref.from.empty() ? ref.into : ref.from);
+      }
+    }
+  } else {
+    names = stmt.buffer_writes();
+    if (!writes_only) {
+      auto reads = stmt.buffer_reads();
+      names.insert(names.end(), reads.begin(), reads.end());
+    }
+  }
+  return std::find(names.begin(), names.end(), name) != names.end();
+}
+
+// Chooses the index whose loop may be run in parallel, or returns -1 if there
+// is none.  The index must not accumulate into any output, and its iterations
+// must write disjoint elements of every buffer the block may write; blocks
+// which reach one parent buffer through several refinements are left serial,
+// since their accesses could overlap.  Among the candidates, an index tagged
+// by partitioning is preferred, then the one with the largest range.
+int ParallelIndex(const stripe::Block& block);
+
+// Temporaries are carved from the arena at offsets rounded up to this
+// alignment, which matches what malloc guarantees for the arena itself.
+constexpr uint64_t kTempAlignment = 16;
+
+uint64_t TempSize(const stripe::Refinement& ref) {
+  return (ref.interior_shape.byte_size() + kTempAlignment - 1) & ~(kTempAlignment - 1);
 }
 
+// Returns the arena space taken by the local allocations a block's caller
+// makes on its behalf.
+uint64_t LocalSize(const stripe::Block& block) {
+  uint64_t size = 0;
+  for (const auto& ref : block.refs) {
+    if (IsLocalAllocation(ref)) {
+      size += TempSize(ref);
+    }
+  }
+  return size;
+}
+
+// Returns the arena space needed while a block's function runs.  Nested
+// blocks run one after another, so they share space: each needs room for its
+// own temporaries, followed by the space its own function needs.  When
+// outermost, nested blocks which will run in parallel are excluded, since
+// each of their chunks allocates its own arena.
+uint64_t ArenaSize(const stripe::Block& block, bool outermost) {
+  uint64_t size = 0;
+  for (const auto& stmt : block.stmts) {
+    auto inner = stripe::Block::Downcast(stmt);
+    if (inner && !(outermost && 0 <= ParallelIndex(*inner))) {
+      size = std::max(size, LocalSize(*inner) + ArenaSize(*inner, false));
+    }
+  }
+  return size;
+}
+
+int ParallelIndex(const stripe::Block& block) {
+  std::map<std::string, size_t> parent_uses;
+  for (const auto& ref : block.refs) {
+    if (!IsLocalAllocation(ref)) {
+      parent_uses[ref.from.empty() ? ref.into : ref.from]++;
+    }
+  }
+  auto accumulating = block.accumulation_idxs();
+  int best = -1;
+  for (size_t i = 0; i < block.idxs.size(); ++i) {
+    const auto& idx = block.idxs[i];
+    if (idx.range < 2 || accumulating.count(&idx)) {
+      continue;
+    }
+    bool disjoint = true;
+    for (const auto& ref : block.refs) {
+      if (ref.dir == stripe::RefDir::In || IsLocalAllocation(ref)) {
+        continue;
+      }
+      if (1 < parent_uses[ref.from.empty() ? ref.into : ref.from] || !IndexPartitions(ref, idx.name)) {
+        disjoint = false;
+        break;
+      }
+    }
+    if (!disjoint) {
+      continue;
+    }
+    if (idx.has_tag(parallel_idx_tag_)) {
+      return i;
+    }
+    if (best < 0 || block.idxs[best].range < idx.range) {
+      best = i;
+    }
+  }
+  return best;
+}
+
+}  // namespace
+
 class Executable {
  public:
   Executable(std::unique_ptr<llvm::Module>&& module, const std::vector<std::string>& parameters);
-  void Run(const std::map<std::string, void*>& buffers);
+  const std::vector<std::string>& parameters() const { return parameters_; }
+  void Run(const std::vector<void*>& buffers) const;
 
  private:
   std::unique_ptr<llvm::ExecutionEngine> engine_;
   std::vector<std::string> parameters_;
+  void (*entrypoint_)(void**) = nullptr;
 };
 
 class Error : public std::runtime_error {
@@ -55,6 +232,8 @@ class Compiler : private stripe::ConstStmtVisitor {
   explicit Compiler(llvm::Module* module);
   void GenerateInvoker(const stripe::Block& program, llvm::Function* main);
   llvm::Function* CompileBlock(const stripe::Block& block);
+  llvm::Function* CompileChunk(const stripe::Block& block, size_t pidx);
+  void ParallelCall(const stripe::Block& block, size_t pidx);
   void Visit(const stripe::Load&) override;
   void Visit(const stripe::Store&) override;
   void Visit(const stripe::Constant&) override;
@@ -121,10 +300,25 @@ class Compiler : private stripe::ConstStmtVisitor {
   llvm::FunctionType* BlockType(const stripe::Block&);
   llvm::Value* MallocFunction();
   llvm::Value* FreeFunction();
+  llvm::Value* ParallelForFunction();
+  llvm::Value* ZeroFunction();
+  llvm::Value* CopyFunction();
+  llvm::Value* RegionDesc(const stripe::Refinement& ref);
+  void CopyRegion(const stripe::Special& special);
+  llvm::Value* ArenaPtr(llvm::Value* arena, uint64_t offset);
+  bool CanAlias(const stripe::Special& special);
 
   llvm::LLVMContext& context_;
   llvm::IRBuilder<> builder_;
   llvm::Module* module_ = nullptr;
+  // Set when compiling the program's top-level block, whose nested blocks
+  // may have their outermost loops dispatched across threads.
+  bool outermost_ = false;
+  // The arena holding the temporaries of the block being compiled; see
+  // ArenaSize.
+  llvm::Value* arena_ = nullptr;
+  // The block being compiled, whose statements are visited in order.
+  const stripe::Block* block_ = nullptr;
 
   std::map<std::string, scalar> scalars_;
   std::map<std::string, buffer> buffers_;
@@ -144,6 +338,7 @@ Compiler::Compiler() : context_(llvm::getGlobalContext()), builder_{context_} {
 std::unique_ptr<Executable> Compiler::CompileProgram(const stripe::Block& program) {
   // Compile each block in this program into a function within an LLVM module.
   module_ = new llvm::Module("stripe", context_);
+  outermost_ = true;
   llvm::Function* main = CompileBlock(program);
   // Generate a stub function we can invoke from the outside, passing buffers
   // as an array of generic pointers.
@@ -219,16 +414,30 @@ void Compiler::GenerateInvoker(const stripe::Block& program, llvm::Function* mai
   for (unsigned i = 0; i < program.idxs.size(); ++i) {
     args.push_back(IndexConst(0));
   }
+  // All of the program's temporaries live in a single arena, allocated once
+  // per invocation.
+  uint64_t arena_size = ArenaSize(program, true);
+  llvm::Value* arena = llvm::ConstantPointerNull::get(builder_.getInt8PtrTy());
+  if (arena_size) {
+    std::vector<llvm::Value*> malloc_args{IndexConst(arena_size)};
+    arena = builder_.CreateCall(MallocFunction(), malloc_args, "");
+  }
+  args.push_back(arena);
   // Having built the argument list, we'll call the actual kernel using the
   // parameter signature it expects.
   builder_.CreateCall(main, args, "");
+  if (arena_size) {
+    std::vector<llvm::Value*> free_args{arena};
+    builder_.CreateCall(FreeFunction(), free_args, "");
+  }
   builder_.CreateRetVoid();
 }
 
 llvm::Function* Compiler::CompileBlock(const stripe::Block& block) {
   // Generate a function implementing the body of this block.
   // Buffers (refinements) will be passed in as function parameters, as will
-  // the initial value for each index.
+  // the initial value for each index and the arena for temporaries.
+  block_ = &block;
 
   for (const auto& ref : block.refs) {
     buffers_[ref.into] = buffer{&ref};
@@ -254,12 +463,15 @@ llvm::Function* Compiler::CompileBlock(const stripe::Block& block) {
       ai->setName(param_name);
       assert(nullptr == buffers_[param_name].base);
       buffers_[param_name].base = &(*ai);
-    } else {
+    } else if (idx < block.refs.size() + block.idxs.size()) {
       idx -= block.refs.size();
       std::string param_name = block.idxs[idx].name;
       ai->setName(param_name);
       assert(nullptr == indexes_[param_name].init);
       indexes_[param_name].init = &(*ai);
+    } else {
+      ai->setName("arena");
+      arena_ = &(*ai);
     }
   }
 
@@ -453,29 +665,32 @@ void Compiler::Visit(const stripe::Intrinsic& intrinsic) {
 }
 
 void Compiler::Visit(const stripe::Block& block) {
+  // The outermost loop nests carry the bulk of a program's work; dispatch
+  // them across threads when one of their loops can safely be split.
+  if (outermost_) {
+    int pidx = ParallelIndex(block);
+    if (0 <= pidx) {
+      ParallelCall(block, pidx);
+      return;
+    }
+  }
   // Compile a nested block as a function in the same module
   Compiler nested(module_);
   auto function = nested.CompileBlock(block);
   // Generate a list of args.
   // The argument list begins with a pointer to each refinement. We will either
-  // pass along the address of a refinement from the current block, or allocate
-  // a new buffer for the nested block's use.
+  // pass along the address of a refinement from the current block, or carve
+  // a new buffer for the nested block's use out of the arena.
   std::vector<llvm::Value*> args;
-  std::vector<llvm::Value*> allocs;
+  uint64_t offset = 0;
   for (auto& ref : block.refs) {
     llvm::Value* buffer = nullptr;
     // When a refinement is neither in nor out, and it has no "from"
     // name, it represents a local allocation.
-    if (ref.dir == stripe::RefDir::None && ref.from.empty()) {
-      // Allocate new storage for the buffer.
-      size_t size = ref.interior_shape.byte_size();
-      std::vector<llvm::Value*> malloc_args;
-      malloc_args.push_back(IndexConst(size));
-      auto malloc_func = MallocFunction();
-      buffer = builder_.CreateCall(malloc_func, malloc_args, "");
-      allocs.push_back(buffer);
+    if (IsLocalAllocation(ref)) {
       llvm::Type* buftype = CType(ref.interior_shape.type)->getPointerTo();
-      buffer = builder_.CreateBitCast(buffer, buftype);
+      buffer = builder_.CreateBitCast(ArenaPtr(arena_, offset), buftype);
+      offset += TempSize(ref);
     } else {
       // Pass in the current element address from the source buffer.
       // If a "from" name is specified, use that buffer; if not, that means
@@ -491,15 +706,114 @@ void Compiler::Visit(const stripe::Block& block) {
   for (auto& idx : block.idxs) {
     args.push_back(Eval(idx.affine));
   }
+  // The nested block's own temporaries follow the ones allocated here.
+  args.push_back(ArenaPtr(arena_, offset));
   // Invoke the function. It does not return a value.
   builder_.CreateCall(function, args, "");
-  // Free the temporary buffers we allocated as parameter values.
-  for (auto ptr : allocs) {
-    std::vector<llvm::Value*> free_args;
-    free_args.push_back(ptr);
-    auto free_func = FreeFunction();
-    builder_.CreateCall(free_func, free_args, "");
+}
+
+llvm::Function* Compiler::CompileChunk(const stripe::Block& block, size_t pidx) {
+  // Compile the block with the parallel index narrowed to a single iteration;
+  // its initial value then selects which iteration a call runs.
+  stripe::Block slice = block;
+  slice.idxs[pidx].range = 1;
+  llvm::Function* body = CompileBlock(slice);
+  // The chunk function runs iterations [begin, end) of the parallel index. Its
+  // environment is an array holding the address of each refinement, followed
+  // by the initial value of each index, as computed by the calling block.
+  llvm::Type* itype = IndexType();
+  auto chunk_type = llvm::FunctionType::get(builder_.getVoidTy(), {itype->getPointerTo(), itype, itype}, false);
+  auto linkage = llvm::Function::InternalLinkage;
+  auto chunk = llvm::Function::Create(chunk_type, linkage, block.name + "_chunk", module_);
+  auto ai = chunk->arg_begin();
+  llvm::Value* env = &(*ai++);
+  llvm::Value* begin = &(*ai++);
+  llvm::Value* end = &(*ai);
+  builder_.SetInsertPoint(llvm::BasicBlock::Create(context_, "entry", chunk));
+  // Chunks run concurrently, so each allocates a private arena for the
+  // block's temporaries, reused across the chunk's iterations.
+  uint64_t arena_size = LocalSize(block) + ArenaSize(block, false);
+  llvm::Value* arena = llvm::ConstantPointerNull::get(builder_.getInt8PtrTy());
+  if (arena_size) {
+    std::vector<llvm::Value*> malloc_args{IndexConst(arena_size)};
+    arena = builder_.CreateCall(MallocFunction(), malloc_args, "");
+  }
+  std::vector<llvm::Value*> args;
+  uint64_t offset = 0;
+  for (size_t i = 0; i < block.refs.size(); ++i) {
+    const auto& ref = block.refs[i];
+    llvm::Type* buftype = CType(ref.interior_shape.type)->getPointerTo();
+    llvm::Value* buffer = nullptr;
+    if (IsLocalAllocation(ref)) {
+      buffer = builder_.CreateBitCast(ArenaPtr(arena, offset), buftype);
+      offset += TempSize(ref);
+    } else {
+      llvm::Value* addr = builder_.CreateLoad(builder_.CreateGEP(env, IndexConst(i)));
+      buffer = builder_.CreateIntToPtr(addr, buftype);
+    }
+    args.push_back(buffer);
+  }
+  for (size_t i = 0; i < block.idxs.size(); ++i) {
+    args.push_back(builder_.CreateLoad(builder_.CreateGEP(env, IndexConst(block.refs.size() + i))));
   }
+  args.push_back(ArenaPtr(arena, offset));
+  llvm::Value* pinit = args[block.refs.size() + pidx];
+  // Loop over the chunk's iterations, offsetting the parallel index's initial
+  // value by the iteration number.
+  llvm::Value* counter = builder_.CreateAlloca(itype);
+  builder_.CreateStore(begin, counter);
+  auto test = llvm::BasicBlock::Create(context_, "test", chunk);
+  auto loop = llvm::BasicBlock::Create(context_, "loop", chunk);
+  auto done = llvm::BasicBlock::Create(context_, "done", chunk);
+  builder_.CreateBr(test);
+  builder_.SetInsertPoint(test);
+  llvm::Value* iter = builder_.CreateLoad(counter);
+  builder_.CreateCondBr(builder_.CreateICmpULT(iter, end), loop, done);
+  builder_.SetInsertPoint(loop);
+  args[block.refs.size() + pidx] = builder_.CreateAdd(pinit, iter);
+  builder_.CreateCall(body, args, "");
+  builder_.CreateStore(builder_.CreateAdd(iter, IndexConst(1)), counter);
+  builder_.CreateBr(test);
+  builder_.SetInsertPoint(done);
+  if (arena_size) {
+    std::vector<llvm::Value*> free_args{arena};
+    builder_.CreateCall(FreeFunction(), free_args, "");
+  }
+  builder_.CreateRetVoid();
+  return chunk;
+}
+
+void Compiler::ParallelCall(const stripe::Block& block, size_t pidx) {
+  Compiler nested(module_);
+  auto chunk = nested.CompileChunk(block, pidx);
+  // Fill in the chunk environment. Its storage is allocated once, in the
+  // entry block of the current function, rather than on every iteration of
+  // the current block's loops.
+  llvm::Type* itype = IndexType();
+  llvm::BasicBlock& entry = builder_.GetInsertBlock()->getParent()->getEntryBlock();
+  llvm::IRBuilder<> entry_builder(&entry, entry.begin());
+  llvm::Value* env = entry_builder.CreateAlloca(itype, IndexConst(block.refs.size() + block.idxs.size()));
+  size_t slot = 0;
+  for (const auto& ref : block.refs) {
+    llvm::Value* value = IndexConst(0);
+    if (!IsLocalAllocation(ref)) {
+      std::string name = ref.from.empty() ? ref.into : ref.from;
+      value = builder_.CreatePtrToInt(ElementPtr(buffers_[name]), itype);
+    }
+    builder_.CreateStore(value, builder_.CreateGEP(env, IndexConst(slot++)));
+  }
+  for (const auto& idx : block.idxs) {
+    builder_.CreateStore(Eval(idx.affine), builder_.CreateGEP(env, IndexConst(slot++)));
+  }
+  // Blocks with constraints may do uneven amounts of work per iteration, so
+  // they are scheduled dynamically; others are split statically.
+  std::vector<llvm::Value*> args{
+      builder_.CreateBitCast(chunk, builder_.getInt8PtrTy()),
+      env,
+      IndexConst(block.idxs[pidx].range),
+      IndexConst(block.constraints.empty() ? 0 : 1),
+  };
+  builder_.CreateCall(ParallelForFunction(), args, "");
 }
 
 void Compiler::Add(const stripe::Intrinsic& add) {
@@ -807,17 +1121,95 @@ void Compiler::BitRight(const stripe::Intrinsic& stmt) {
 }
 
 void Compiler::Zero(const stripe::Special& zero) {
-  // present in stripe.proto but not defined in the specification
-  throw Error("Special operation ZERO is not yet specified");
+  // Clears every element of the single output refinement, through a runtime
+  // routine which walks the refinement's dimensions.
+  assert(1 == zero.outputs.size());
+  buffer out = buffers_[zero.outputs[0]];
+  llvm::Value* ptr = builder_.CreateBitCast(ElementPtr(out), builder_.getInt8PtrTy());
+  std::vector<llvm::Value*> args{ptr, RegionDesc(*out.refinement)};
+  builder_.CreateCall(ZeroFunction(), args, "");
 }
 
 void Compiler::Copy(const stripe::Special& copy) {
-  // present in stripe.proto but not defined in the specification
-  throw Error("Special operation COPY is not yet specified");
+  // Copies each element of the input into the corresponding element of the
+  // output; the two refinements may differ only in their strides.
+  assert(1 == copy.inputs.size() && 1 == copy.outputs.size());
+  const auto& in = buffers_[copy.inputs[0]].refinement->interior_shape;
+  const auto& out = buffers_[copy.outputs[0]].refinement->interior_shape;
+  bool same_sizes = in.dims.size() == out.dims.size();
+  for (size_t i = 0; same_sizes && i < in.dims.size(); ++i) {
+    same_sizes = in.dims[i].size == out.dims[i].size;
+  }
+  if (!same_sizes) {
+    throw Error("Copy between refinements of different sizes: " + copy.inputs[0] + " to " + copy.outputs[0]);
+  }
+  CopyRegion(copy);
 }
 
 void Compiler::Reshape(const stripe::Special& reshape) {
-  throw Error("Special operation RESHAPE is not yet specified");
+  // Copies the input elements, in row-major order, into the output elements,
+  // in row-major order; the two refinements need only have the same number
+  // of elements.
+  assert(1 == reshape.inputs.size() && 1 == reshape.outputs.size());
+  const auto& in = buffers_[reshape.inputs[0]].refinement->interior_shape;
+  const auto& out = buffers_[reshape.outputs[0]].refinement->interior_shape;
+  if (in.sizes_product() != out.sizes_product()) {
+    throw Error("Reshape between refinements with different element counts: " + reshape.inputs[0] + " to " +
+                reshape.outputs[0]);
+  }
+  if (!CanAlias(reshape)) {
+    CopyRegion(reshape);
+    return;
+  }
+  // The output is a view of the input's elements: rather than copying them,
+  // point the output at the input's first element.  The output's temporary
+  // in the arena goes unused.
+  buffer in = buffers_[reshape.inputs[0]];
+  buffer& out = buffers_[reshape.outputs[0]];
+  out.base = builder_.CreateBitCast(ElementPtr(in), CType(out.refinement->interior_shape.type)->getPointerTo());
+}
+
+bool Compiler::CanAlias(const stripe::Special& special) {
+  // A special which moves elements without changing them can instead make
+  // its output refer to its input, when the two lay out their elements
+  // identically, and when nothing can observe that they share storage: the
+  // output must be a temporary of this block, written by nothing else and
+  // not used before the special, and the input must not be written after it.
+  const std::string& in_name = special.inputs[0];
+  const std::string& out_name = special.outputs[0];
+  const auto& in = *buffers_[in_name].refinement;
+  const auto& out = *buffers_[out_name].refinement;
+  if (in.interior_shape.type != out.interior_shape.type || !IsLocalAllocation(out) ||
+      !out.FlatAccess().isConstant() || out.FlatAccess().constant() != 0 ||
+      CanonicalLayout(in.interior_shape) != CanonicalLayout(out.interior_shape)) {
+    return false;
+  }
+  bool after = false;
+  for (const auto& stmt : block_->stmts) {
+    if (stmt.get() == &special) {
+      after = true;
+      continue;
+    }
+    if (Touches(*stmt, out_name, true) || (!after && Touches(*stmt, out_name, false)) ||
+        (after && Touches(*stmt, in_name, true))) {
+      return false;
+    }
+  }
+  return after;
+}
+
+void Compiler::CopyRegion(const stripe::Special& special) {
+  buffer in = buffers_[special.inputs[0]];
+  buffer out = buffers_[special.outputs[0]];
+  if (in.refinement->interior_shape.type != out.refinement->interior_shape.type) {
+    throw Error("Special operation " + special.name + " requires matching element types: " +
+                to_string(in.refinement->interior_shape.type) + " to " +
+                to_string(out.refinement->interior_shape.type));
+  }
+  llvm::Value* dst = builder_.CreateBitCast(ElementPtr(out), builder_.getInt8PtrTy());
+  llvm::Value* src = builder_.CreateBitCast(ElementPtr(in), builder_.getInt8PtrTy());
+  std::vector<llvm::Value*> args{dst, RegionDesc(*out.refinement), src, RegionDesc(*in.refinement)};
+  builder_.CreateCall(CopyFunction(), args, "");
 }
 
 Compiler::scalar Compiler::Cast(scalar v, DataType to_type) {
@@ -927,6 +1319,9 @@ llvm::FunctionType* Compiler::BlockType(const stripe::Block& block) {
   for (size_t i = 0; i < block.idxs.size(); ++i) {
     param_types.push_back(IndexType());
   }
+  // The last parameter is the arena from which the block carves the
+  // temporaries of its nested blocks.
+  param_types.push_back(builder_.getInt8PtrTy());
   // Blocks never return a value.
   llvm::Type* return_type = builder_.getVoidTy();
   return llvm::FunctionType::get(return_type, param_types, false);
@@ -949,6 +1344,52 @@ llvm::Value* Compiler::FreeFunction(void) {
   return module_->getOrInsertFunction(funcname, functype);
 }
 
+llvm::Value* Compiler::ArenaPtr(llvm::Value* arena, uint64_t offset) {
+  std::vector<llvm::Value*> idxList{IndexConst(offset)};
+  return builder_.CreateGEP(arena, idxList);
+}
+
+llvm::Value* Compiler::ZeroFunction() {
+  std::vector<llvm::Type*> argtypes{builder_.getInt8PtrTy(), IndexType()->getPointerTo()};
+  auto functype = llvm::FunctionType::get(builder_.getVoidTy(), argtypes, false);
+  return module_->getOrInsertFunction(zero_name_, functype);
+}
+
+llvm::Value* Compiler::CopyFunction() {
+  llvm::Type* descptr = IndexType()->getPointerTo();
+  std::vector<llvm::Type*> argtypes{builder_.getInt8PtrTy(), descptr, builder_.getInt8PtrTy(), descptr};
+  auto functype = llvm::FunctionType::get(builder_.getVoidTy(), argtypes, false);
+  return module_->getOrInsertFunction(copy_name_, functype);
+}
+
+llvm::Value* Compiler::RegionDesc(const stripe::Refinement& ref) {
+  // Describe the refinement's layout to the runtime as a constant array: the
+  // rank and the element width in bytes, followed by the size and element
+  // stride of each dimension, outermost first.
+  const auto& shape = ref.interior_shape;
+  llvm::Type* itype = IndexType();
+  std::vector<llvm::Constant*> values{
+      llvm::ConstantInt::get(itype, shape.dims.size()),
+      llvm::ConstantInt::get(itype, byte_width(shape.type)),
+  };
+  for (const auto& dim : shape.dims) {
+    values.push_back(llvm::ConstantInt::get(itype, dim.size));
+    values.push_back(llvm::ConstantInt::get(itype, dim.stride, true));
+  }
+  auto array_type = llvm::ArrayType::get(itype, values.size());
+  auto init = llvm::ConstantArray::get(array_type, values);
+  auto global = new llvm::GlobalVariable(*module_, array_type, true, llvm::GlobalValue::PrivateLinkage, init,
+                                         "region_" + ref.into);
+  return builder_.CreateConstGEP2_32(array_type, global, 0, 0);
+}
+
+llvm::Value* Compiler::ParallelForFunction() {
+  llvm::Type* itype = IndexType();
+  std::vector<llvm::Type*> argtypes{builder_.getInt8PtrTy(), itype->getPointerTo(), itype, itype};
+  auto functype = llvm::FunctionType::get(builder_.getVoidTy(), argtypes, false);
+  return module_->getOrInsertFunction(parallel_for_name_, functype);
+}
+
 Executable::Executable(std::unique_ptr<llvm::Module>&& module, const std::vector<std::string>& parameters)
     : parameters_(parameters) {
   std::string errStr;
@@ -965,16 +1406,21 @@ Executable::Executable(std::unique_ptr<llvm::Module>&& module, const std::vector
   } else {
     throw Error("Failed to create ExecutionEngine: " + errStr);
   }
+  // Resolve the entrypoint once; the finalized code doesn't move, so runs can
+  // call it directly without consulting the engine.
+  uint64_t entrypoint = engine_->getFunctionAddress(invoker_name_);
+  if (!entrypoint) {
+    throw Error("Failed to resolve the program entrypoint");
+  }
+  entrypoint_ = reinterpret_cast<void (*)(void**)>(entrypoint);
 }
 
-void Executable::Run(const std::map<std::string, void*>& buffers) {
-  std::vector<void*> args(parameters_.size());
-  for (size_t i = 0; i < args.size(); ++i) {
-    args[i] = buffers.at(parameters_[i]);
+void Executable::Run(const std::vector<void*>& buffers) const {
+  if (buffers.size() != parameters_.size()) {
+    throw Error("Expected " + std::to_string(parameters_.size()) + " buffers, got " +
+                std::to_string(buffers.size()));
   }
-  void* argvec = args.data();
-  uint64_t entrypoint = engine_->getFunctionAddress(invoker_name_);
-  ((void (*)(void*))entrypoint)(argvec);
+  entrypoint_(const_cast<void**>(buffers.data()));
 }
 
 namespace rt {
@@ -982,6 +1428,235 @@ namespace rt {
 // that we won't be able to resolve from system libraries.
 float h2f(half_float::half n) { return n; }
 half_float::half f2h(float n) { return half_float::half_cast<half_float::half>(n); }
+
+// The signature of a compiled chunk function, which runs iterations
+// [begin, end) of a parallel loop.
+typedef void (*ChunkFunction)(intptr_t* env, intptr_t begin, intptr_t end);
+
+// Parallel loops are spread over physical cores only, as in the CPU HAL.
+size_t Workers() {
+  static const size_t workers = std::max<size_t>(1, boost::thread::physical_concurrency());
+  return workers;
+}
+
+// The pool is shared by all programs, and deliberately leaked so that it never
+// needs to be joined during static destruction.
+boost::asio::thread_pool& LoopPool() {
+  static auto* pool = new boost::asio::thread_pool(Workers());
+  return *pool;
+}
+
+// The shared state of one parallel loop.  Workers claim chunks until all have
+// been claimed; the calling thread works too, and then waits for the
+// iterations claimed by other workers to finish.
+struct ParallelLoop {
+  std::function<void(intptr_t begin, intptr_t end)> body;
+  intptr_t count;
+  intptr_t chunk_size;
+  std::atomic<intptr_t> next{0};
+  std::mutex mu;
+  std::condition_variable cv;
+  intptr_t done = 0;  // Guarded by mu
+
+  void Work() {
+    for (;;) {
+      intptr_t begin = next.fetch_add(chunk_size);
+      if (count <= begin) {
+        return;
+      }
+      intptr_t end = std::min(count, begin + chunk_size);
+      body(begin, end);
+      std::lock_guard<std::mutex> lock{mu};
+      done += end - begin;
+      if (done == count) {
+        cv.notify_all();
+      }
+    }
+  }
+};
+
+// Runs body over [0, count), split into chunks which run in parallel.
+void ParallelRange(intptr_t count, bool dynamic, std::function<void(intptr_t begin, intptr_t end)> body) {
+  intptr_t workers = Workers();
+  if (workers == 1 || count < 2) {
+    body(0, count);
+    return;
+  }
+  // Static chunking gives each worker one equal share. Dynamic chunking hands
+  // out several smaller chunks per worker, so that workers which finish early
+  // pick up the slack.
+  intptr_t shares = dynamic ? workers * 8 : workers;
+  auto loop = std::make_shared<ParallelLoop>();
+  loop->body = std::move(body);
+  loop->count = count;
+  loop->chunk_size = (count + shares - 1) / shares;
+  intptr_t helpers = std::min(workers, (count + loop->chunk_size - 1) / loop->chunk_size) - 1;
+  for (intptr_t i = 0; i < helpers; ++i) {
+    boost::asio::post(LoopPool(), [loop]() { loop->Work(); });
+  }
+  loop->Work();
+  std::unique_lock<std::mutex> lock{loop->mu};
+  loop->cv.wait(lock, [&loop]() { return loop->done == loop->count; });
+}
+
+void ParallelFor(ChunkFunction chunk, intptr_t* env, intptr_t count, intptr_t dynamic) {
+  ParallelRange(count, dynamic, [chunk, env](intptr_t begin, intptr_t end) { chunk(env, begin, end); });
+}
+
+// Zeroing and copying at least this many bytes is split across threads.
+constexpr intptr_t kParallelBytes = 1 << 20;
+
+intptr_t Gcd(intptr_t a, intptr_t b) {
+  while (b) {
+    intptr_t r = a % b;
+    a = b;
+    b = r;
+  }
+  return a;
+}
+
+// A region of a buffer, as described by Compiler::RegionDesc.  Unit
+// dimensions are dropped, and dimensions which are laid out contiguously
+// within their parent are merged into it, so that dense regions end up with
+// a single dimension.
+struct Region {
+  explicit Region(const intptr_t* desc) : width{desc[1]} {
+    for (intptr_t i = 0; i < desc[0]; ++i) {
+      intptr_t size = desc[2 + 2 * i];
+      intptr_t stride = desc[3 + 2 * i] * width;
+      count *= size;
+      if (size == 1) {
+        continue;
+      }
+      if (dims.size() && dims.back().stride == stride * size) {
+        dims.back() = Dim{dims.back().size * size, stride};
+      } else {
+        dims.push_back(Dim{size, stride});
+      }
+    }
+  }
+
+  // The number of elements stored consecutively at the start of each row.
+  intptr_t Contiguous() const {
+    if (dims.empty()) {
+      return 1;
+    }
+    return dims.back().stride == width ? dims.back().size : 1;
+  }
+
+  bool Dense() const { return dims.size() <= 1 && Contiguous() == count; }
+
+  struct Dim {
+    intptr_t size;
+    intptr_t stride;  // In bytes
+  };
+
+  intptr_t width;
+  intptr_t count = 1;
+  std::vector<Dim> dims;
+};
+
+// Walks the elements of a region in row-major order, tracking the byte offset
+// of the current element.  Each step must divide the innermost dimension.
+class Cursor {
+ public:
+  Cursor(const Region& region, intptr_t start) : dims_{region.dims}, pos_(dims_.size()) {
+    for (size_t i = dims_.size(); i-- > 0;) {
+      pos_[i] = start % dims_[i].size;
+      start /= dims_[i].size;
+      offset_ += pos_[i] * dims_[i].stride;
+    }
+  }
+
+  intptr_t offset() const { return offset_; }
+
+  void Advance(intptr_t step) {
+    if (dims_.empty()) {
+      return;
+    }
+    size_t i = dims_.size() - 1;
+    pos_[i] += step;
+    offset_ += step * dims_[i].stride;
+    while (i && pos_[i] == dims_[i].size) {
+      offset_ -= pos_[i] * dims_[i].stride;
+      pos_[i] = 0;
+      --i;
+      pos_[i]++;
+      offset_ += dims_[i].stride;
+    }
+  }
+
+ private:
+  const std::vector<Region::Dim>& dims_;
+  std::vector<intptr_t> pos_;
+  intptr_t offset_ = 0;
+};
+
+// Runs body over [0, count), in parallel if the total work is large.
+void MaybeParallel(intptr_t count, intptr_t bytes, const std::function<void(intptr_t, intptr_t)>& body) {
+  if (bytes < kParallelBytes) {
+    body(0, count);
+  } else {
+    ParallelRange(count, false, body);
+  }
+}
+
+void ZeroRegion(char* dst, const intptr_t* desc) {
+  Region region{desc};
+  if (!region.count) {
+    return;
+  }
+  intptr_t bytes = region.count * region.width;
+  if (region.Dense()) {
+    // One memset, split into equal slices for large regions.
+    intptr_t slices = std::max<intptr_t>(1, bytes / kParallelBytes);
+    MaybeParallel(slices, bytes, [&](intptr_t begin, intptr_t end) {
+      intptr_t lo = bytes * begin / slices;
+      intptr_t hi = bytes * end / slices;
+      std::memset(dst + lo, 0, hi - lo);
+    });
+    return;
+  }
+  intptr_t run = region.Contiguous();
+  MaybeParallel(region.count / run, bytes, [&](intptr_t begin, intptr_t end) {
+    Cursor cursor{region, begin * run};
+    for (intptr_t i = begin; i < end; ++i) {
+      std::memset(dst + cursor.offset(), 0, run * region.width);
+      cursor.Advance(run);
+    }
+  });
+}
+
+void CopyRegion(char* dst, const intptr_t* dst_desc, const char* src, const intptr_t* src_desc) {
+  Region to{dst_desc};
+  Region from{src_desc};
+  if (!to.count) {
+    return;
+  }
+  intptr_t bytes = to.count * to.width;
+  if (to.Dense() && from.Dense()) {
+    intptr_t slices = std::max<intptr_t>(1, bytes / kParallelBytes);
+    MaybeParallel(slices, bytes, [&](intptr_t begin, intptr_t end) {
+      intptr_t lo = bytes * begin / slices;
+      intptr_t hi = bytes * end / slices;
+      std::memcpy(dst + lo, src + lo, hi - lo);
+    });
+    return;
+  }
+  // Copy in runs which are contiguous on both sides: the run length must
+  // divide the contiguous row length of each region.
+  intptr_t run = Gcd(to.Contiguous(), from.Contiguous());
+  MaybeParallel(to.count / run, bytes, [&](intptr_t begin, intptr_t end) {
+    Cursor to_cursor{to, begin * run};
+    Cursor from_cursor{from, begin * run};
+    for (intptr_t i = begin; i < end; ++i) {
+      std::memcpy(dst + to_cursor.offset(), src + from_cursor.offset(), run * to.width);
+      to_cursor.Advance(run);
+      from_cursor.Advance(run);
+    }
+  });
+}
+
 }  // namespace rt
 
 template <typename T>
@@ -997,6 +1672,12 @@ llvm::RuntimeDyld::SymbolInfo Runtime::findSymbol(const std::string& name) {
       {"__gnu_f2h_ieee", symInfo(rt::f2h)},
       {"___truncsfhf2", symInfo(rt::f2h)},
       {"___extendhfsf2", symInfo(rt::h2f)},
+      {parallel_for_name_, symInfo(rt::ParallelFor)},
+      {std::string("_") + parallel_for_name_, symInfo(rt::ParallelFor)},
+      {zero_name_, symInfo(rt::ZeroRegion)},
+      {std::string("_") + zero_name_, symInfo(rt::ZeroRegion)},
+      {copy_name_, symInfo(rt::CopyRegion)},
+      {std::string("_") + copy_name_, symInfo(rt::CopyRegion)},
   };
   auto loc = symbols.find(name);
   if (loc != symbols.end()) {
@@ -1021,10 +1702,74 @@ llvm::RuntimeDyld::SymbolInfo Runtime::findSymbolInLogicalDylib(const std::strin
   return llvm::RuntimeDyld::SymbolInfo(nullptr);
 }
 
-void JitExecute(const stripe::Block& program, const std::map<std::string, void*>& buffers) {
+JitProgram::JitProgram(const stripe::Block& program) {
+  // The compiler generates code in LLVM's global context, which must not be
+  // used by more than one thread at a time.
+  static std::mutex compile_mu;
+  std::lock_guard<std::mutex> lock{compile_mu};
   Compiler compiler;
-  auto executable = compiler.CompileProgram(program);
-  executable->Run(buffers);
+  executable_ = compiler.CompileProgram(program);
+}
+
+JitProgram::~JitProgram() {}
+
+const std::vector<std::string>& JitProgram::parameters() const { return executable_->parameters(); }
+
+void JitProgram::Run(const std::map<std::string, void*>& buffers) const {
+  const auto& parameters = executable_->parameters();
+  std::vector<void*> args(parameters.size());
+  for (size_t i = 0; i < args.size(); ++i) {
+    auto it = buffers.find(parameters[i]);
+    if (it == buffers.end()) {
+      throw Error("Missing buffer \"" + parameters[i] + "\"");
+    }
+    args[i] = it->second;
+  }
+  executable_->Run(args);
+}
+
+void JitProgram::Run(const std::vector<void*>& buffers) const { executable_->Run(buffers); }
+
+namespace {
+
+// Feeds serialized bytes straight into a fingerprint, so that a program can be
+// hashed without materializing its serialization.
+class FingerprintStream final : public google::protobuf::io::CopyingOutputStream {
+ public:
+  explicit FingerprintStream(Fingerprinter* fp) : fp_{fp} {}
+
+  bool Write(const void* buffer, int size) final {
+    fp_->Update(buffer, size);
+    return true;
+  }
+
+ private:
+  Fingerprinter* fp_;
+};
+
+// Returns a fingerprint of the program's deterministic serialization, so that
+// identical programs produce identical keys.
+std::string ProgramKey(const stripe::Block& program) {
+  Fingerprinter fp;
+  {
+    FingerprintStream stream{&fp};
+    google::protobuf::io::CopyingOutputStreamAdaptor out{&stream};
+    google::protobuf::io::CodedOutputStream coded{&out};
+    coded.SetSerializationDeterministic(true);
+    stripe::IntoProto(program).SerializeToCodedStream(&coded);
+  }
+  return fp.Digest();
+}
+
+}  // namespace
+
+std::shared_ptr<JitProgram> JitCompile(const stripe::Block& program) {
+  static LruCache<std::string, std::shared_ptr<JitProgram>> cache{kProgramCacheSize};
+  return cache.Lookup(ProgramKey(program), [&]() { return std::make_shared<JitProgram>(program); });
+}
+
+void JitExecute(const stripe::Block& program, const std::map<std::string, void*>& buffers) {
+  JitCompile(program)->Run(buffers);
 }
 
 }  // namespace codegen
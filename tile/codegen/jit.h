@@ -3,7 +3,9 @@
 #pragma once
 
 #include <map>
+#include <memory>
 #include <string>
+#include <vector>
 
 #include "tile/stripe/stripe.h"
 
@@ -11,6 +13,41 @@ namespace vertexai {
 namespace tile {
 namespace codegen {
 
+class Executable;
+
+// A Stripe program compiled to native code.  Compilation is expensive and
+// running is not, so a JitProgram is meant to be built once and run many
+// times; the entry point and the buffer order are resolved when it's built.
+// Run may be called concurrently, as long as the calls don't share output
+// buffers.
+class JitProgram {
+ public:
+  explicit JitProgram(const stripe::Block& program);
+  ~JitProgram();
+
+  // The names of the program's buffers, in the order expected by the
+  // positional Run.
+  const std::vector<std::string>& parameters() const;
+
+  // Runs the program with buffers bound by name.
+  void Run(const std::map<std::string, void*>& buffers) const;
+
+  // Runs the program with buffers bound by position, as given by parameters().
+  void Run(const std::vector<void*>& buffers) const;
+
+ private:
+  std::unique_ptr<Executable> executable_;
+};
+
+// Returns the compiled form of the program.  Compiled programs are cached by a
+// fingerprint of their content for the life of the process, so compiling an
+// identical program again skips code generation; finding it still hashes the
+// whole program, so callers that run a program repeatedly should hold on to
+// the returned handle and call Run rather than compiling per run.  This is
+// internally synchronized.
+std::shared_ptr<JitProgram> JitCompile(const stripe::Block& program);
+
+// Compiles (or finds in the cache) and runs the program once.
 void JitExecute(const stripe::Block& program, const std::map<std::string, void*>& buffers);
 
 }  // namespace codegen
@@ -14,6 +14,7 @@ namespace gp = google::protobuf;
 
 using ::testing::ContainerEq;
 using ::testing::Eq;
+using ::testing::Ne;
 
 namespace vertexai {
 namespace tile {
@@ -417,6 +418,341 @@ TEST(Codegen, JitNestedAlloc) {
   EXPECT_THAT(bufB, ContainerEq(expected));
 }
 
+TEST(Codegen, JitSpecials) {
+  stripe::proto::Block input_proto;
+  gp::TextFormat::ParseFromString(R"(
+    loc { unit { } }
+    refs {
+      loc { unit { } }
+      dir: 1
+      into: "bufA"
+      shape { type: FLOAT32 dims: {size:2 stride:3} dims: {size:3 stride:1} }
+      access { }
+      access { }
+    }
+    refs {
+      loc { unit { } }
+      dir: 2
+      into: "bufB"
+      shape { type: FLOAT32 dims: {size:2 stride:1} dims: {size:3 stride:2} }
+      access { }
+      access { }
+    }
+    refs {
+      loc { unit { } }
+      dir: 2
+      into: "bufC"
+      shape { type: FLOAT32 dims: {size:3 stride:2} dims: {size:2 stride:1} }
+      access { }
+      access { }
+    }
+    refs {
+      loc { unit { } }
+      dir: 2
+      into: "bufD"
+      shape { type: FLOAT32 dims: {size:2 stride:4} dims: {size:2 stride:1} }
+      access { }
+      access { }
+    }
+    stmts { special { name:"copy" inputs:"bufA" outputs:"bufB" } }
+    stmts { special { name:"reshape" inputs:"bufA" outputs:"bufC" } }
+    stmts { special { name:"zero" outputs:"bufD" } }
+  )",
+                                  &input_proto);
+  std::shared_ptr<stripe::Block> block{stripe::FromProto(input_proto)};
+
+  std::vector<float> bufA = {1, 2, 3, 4, 5, 6};
+  std::vector<float> bufB(6);
+  std::vector<float> bufC(6);
+  std::vector<float> bufD = {1, 1, 1, 1, 1, 1, 1, 1};
+
+  std::map<std::string, void*> buffers{
+      {"bufA", bufA.data()}, {"bufB", bufB.data()}, {"bufC", bufC.data()}, {"bufD", bufD.data()}};
+  JitExecute(*block, buffers);
+
+  EXPECT_THAT(bufB, ContainerEq(std::vector<float>{1, 4, 2, 5, 3, 6}));
+  EXPECT_THAT(bufC, ContainerEq(bufA));
+  EXPECT_THAT(bufD, ContainerEq(std::vector<float>{0, 0, 1, 1, 0, 0, 1, 1}));
+}
+
+TEST(Codegen, JitReshapeIntoTemporary) {
+  // The temporary has the same layout as its input, so the reshape can make
+  // it a view of the input rather than a copy.
+  stripe::proto::Block input_proto;
+  gp::TextFormat::ParseFromString(R"(
+    loc { unit { } }
+    refs {
+      loc { unit { } }
+      dir: 1
+      into: "bufA"
+      shape { type: FLOAT32 dims: {size:2 stride:3} dims: {size:3 stride:1} }
+      access { }
+      access { }
+    }
+    refs {
+      loc { unit { } }
+      dir: 2
+      into: "bufB"
+      shape { type: FLOAT32 dims: {size:6 stride:1} }
+      access { }
+    }
+    stmts { block {
+      refs {
+        loc { unit { } }
+        dir: 1
+        into: "bufA"
+        shape { type: FLOAT32 dims: {size:2 stride:3} dims: {size:3 stride:1} }
+        access { }
+        access { }
+      }
+      refs {
+        loc { unit { } }
+        dir: 2
+        into: "bufB"
+        shape { type: FLOAT32 dims: {size:6 stride:1} }
+        access { }
+      }
+      refs {
+        dir: 0
+        into: "bufV"
+        shape { type: FLOAT32 dims: {size:3 stride:2} dims: {size:2 stride:1} }
+        access { }
+        access { }
+      }
+      stmts { special { name:"reshape" inputs:"bufA" outputs:"bufV" } }
+      stmts { block {
+        idxs { name: "i" range: 3 }
+        idxs { name: "j" range: 2 }
+        refs {
+          loc { unit { } }
+          dir: 1
+          from: "bufV"
+          into: "bufV"
+          shape { type: FLOAT32 dims: {size:1 stride:2} dims: {size:1 stride:1} }
+          access { terms {key:"i" value:1} }
+          access { terms {key:"j" value:1} }
+        }
+        refs {
+          loc { unit { } }
+          dir: 2
+          from: "bufB"
+          into: "bufB"
+          shape { type: FLOAT32 dims: {size:1 stride:1} }
+          access { terms {key:"i" value:2} terms {key:"j" value:1} }
+        }
+        stmts { load { from:"bufV" into:"$1" } }
+        stmts { store { from:"$1" into:"bufB"} }
+      } }
+    } }
+  )",
+                                  &input_proto);
+  std::shared_ptr<stripe::Block> block{stripe::FromProto(input_proto)};
+
+  std::vector<float> bufA = {1, 2, 3, 4, 5, 6};
+  std::vector<float> bufB(6);
+
+  std::map<std::string, void*> buffers{{"bufA", bufA.data()}, {"bufB", bufB.data()}};
+  JitExecute(*block, buffers);
+
+  EXPECT_THAT(bufB, ContainerEq(bufA));
+}
+
+TEST(Codegen, JitNestedTemporaries) {
+  stripe::proto::Block input_proto;
+  gp::TextFormat::ParseFromString(R"(
+    loc { unit { } }
+    refs {
+      loc { unit { } }
+      dir: 1
+      into: "bufA"
+      shape { type: FLOAT32 dims: {size:10 stride:1} }
+      access { }
+    }
+    refs {
+      loc { unit { } }
+      dir: 2
+      into: "bufB"
+      shape { type: FLOAT32 dims: {size:1 stride:1} }
+      access { }
+    }
+    stmts { block {
+      idxs { name: "k" range: 10 }
+      refs {
+        loc { unit { } }
+        dir: 1
+        into: "bufA"
+        access { terms {key:"k" value:1} }
+        shape { type: FLOAT32 dims: {size:1 stride:1} }
+      }
+      refs {
+        loc { unit { } }
+        dir: 2
+        into: "bufB"
+        agg_op: "add"
+        access { }
+        shape { type: FLOAT32 dims: {size:1 stride:1} }
+      }
+      refs {
+        dir: 0
+        into: "bufT"
+        shape { type: FLOAT32 dims: {size:1 stride:1} }
+        access { }
+      }
+      stmts { block {
+        refs {
+          loc { unit { } }
+          dir: 1
+          from: "bufA"
+          into: "bufA"
+          access { }
+          shape { type: FLOAT32 dims: {size:1 stride:1} }
+        }
+        refs {
+          loc { unit { } }
+          dir: 2
+          from: "bufT"
+          into: "bufT"
+          access { }
+          shape { type: FLOAT32 dims: {size:1 stride:1} }
+        }
+        refs {
+          dir: 0
+          into: "bufU"
+          shape { type: FLOAT32 dims: {size:4 stride:1} }
+          access { }
+        }
+        stmts { load { from:"bufA" into:"$1" } }
+        stmts { store { from:"$1" into:"bufU"} }
+        stmts { load { from:"bufU" into:"$2" } }
+        stmts { store { from:"$2" into:"bufT"} }
+      } }
+      stmts { load { from:"bufT" into:"$3" } }
+      stmts { store { from:"$3" into:"bufB"} }
+    } }
+  )",
+                                  &input_proto);
+  std::shared_ptr<stripe::Block> block{stripe::FromProto(input_proto)};
+
+  std::vector<float> bufA = {0, 1, 2, 3, 4, 5, 6, 7, 8, 9};
+  std::vector<float> bufB = {0};
+
+  std::map<std::string, void*> buffers{{"bufA", bufA.data()}, {"bufB", bufB.data()}};
+  JitExecute(*block, buffers);
+
+  EXPECT_THAT(bufB[0], Eq(45.0));
+}
+
+TEST(Codegen, JitParallelOuterLoop) {
+  stripe::proto::Block input_proto;
+  gp::TextFormat::ParseFromString(R"(
+    loc { unit { } }
+    refs {
+      loc { unit { } }
+      dir: 1
+      into: "bufA"
+      shape { type: FLOAT32 dims: {size:1000 stride:1} }
+      access { }
+    }
+    refs {
+      loc { unit { } }
+      dir: 2
+      into: "bufB"
+      shape { type: FLOAT32 dims: {size:1000 stride:1} }
+      access { }
+    }
+    stmts { block {
+      idxs { name: "i" range: 1000 }
+      constraints { offset: -100 terms {key:"i" value:1} }
+      refs {
+        loc { unit { } }
+        dir: 1
+        into: "bufA"
+        access { terms {key:"i" value:1} }
+        shape { type: FLOAT32 dims: {size:1 stride:1} }
+      }
+      refs {
+        loc { unit { } }
+        dir: 2
+        into: "bufB"
+        access { terms {key:"i" value:1} }
+        shape { type: FLOAT32 dims: {size:1 stride:1} }
+      }
+      refs {
+        dir: 0
+        into: "bufTemp"
+        shape { type: FLOAT32 dims: {size:1 stride:1} }
+        access { }
+      }
+      stmts { load { from:"bufA" into:"$1" } }
+      stmts { store { from:"$1" into:"bufTemp"} }
+      stmts { load { from:"bufTemp" into:"$2" } }
+      stmts { intrinsic { name:"add" type:FLOAT32 inputs:"$1" inputs:"$2" outputs:"$3"} }
+      stmts { store { from:"$3" into:"bufB"} }
+    } }
+  )",
+                                  &input_proto);
+  std::shared_ptr<stripe::Block> block{stripe::FromProto(input_proto)};
+
+  std::vector<float> bufA(1000);
+  std::vector<float> bufB(1000);
+  std::vector<float> expected(1000);
+  for (size_t i = 0; i < bufA.size(); ++i) {
+    bufA[i] = i;
+    expected[i] = i < 100 ? 0 : 2 * i;
+  }
+
+  auto program = JitCompile(*block);
+  for (int run = 0; run < 3; ++run) {
+    program->Run(std::vector<void*>{bufA.data(), bufB.data()});
+    EXPECT_THAT(bufB, ContainerEq(expected));
+  }
+}
+
+TEST(Codegen, JitCompiledProgramIsCachedAndReusable) {
+  stripe::proto::Block input_proto;
+  gp::TextFormat::ParseFromString(R"(
+    loc { unit { } }
+    refs {
+      loc { unit { } }
+      dir: 3
+      into: "b1"
+      shape { type: FLOAT32 dims: {size:1 stride:1} }
+      access { }
+    }
+    refs {
+      loc { unit { } }
+      dir: 3
+      into: "b2"
+      shape { type: FLOAT32 dims: {size:1 stride:1} }
+      access { }
+    }
+    stmts { load { from:"b1" into:"$1" } }
+    stmts { load { from:"b2" into:"$2" } }
+    stmts { intrinsic { name:"sub" type:FLOAT32 inputs:"$1" inputs:"$2" outputs:"$3"} }
+    stmts { store { from:"$3" into:"b2"} }
+  )",
+                                  &input_proto);
+  std::shared_ptr<stripe::Block> block{stripe::FromProto(input_proto)};
+  std::shared_ptr<stripe::Block> same{stripe::FromProto(input_proto)};
+
+  auto program = JitCompile(*block);
+  EXPECT_THAT(JitCompile(*same), Eq(program));
+  EXPECT_THAT(program->parameters(), ContainerEq(std::vector<std::string>{"b1", "b2"}));
+
+  std::vector<float> b1{5.0};
+  std::vector<float> b2{2.0};
+  program->Run(std::vector<void*>{b1.data(), b2.data()});
+  EXPECT_THAT(b2[0], Eq(3.0));
+  program->Run(std::vector<void*>{b2.data(), b1.data()});
+  EXPECT_THAT(b1[0], Eq(-2.0));
+  program->Run(std::map<std::string, void*>{{"b1", b1.data()}, {"b2", b2.data()}});
+  EXPECT_THAT(b2[0], Eq(-5.0));
+
+  input_proto.mutable_stmts(2)->mutable_intrinsic()->set_name("add");
+  std::shared_ptr<stripe::Block> other{stripe::FromProto(input_proto)};
+  EXPECT_THAT(JitCompile(*other), Ne(program));
+}
+
 }  // namespace test
 }  // namespace codegen
 }  // namespace tile
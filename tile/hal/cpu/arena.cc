@@ -2,21 +2,142 @@
 
 #include "tile/hal/cpu/arena.h"
 
+#ifdef _MSC_VER
+#include <malloc.h>
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+#ifdef __linux__
+#include <sys/syscall.h>
+#endif
+
+#include <cstdlib>
+#include <new>
+#include <string>
+
+#include "base/util/env.h"
 #include "base/util/error.h"
+#include "base/util/logging.h"
 #include "tile/hal/cpu/buffer.h"
 
 namespace vertexai {
 namespace tile {
 namespace hal {
 namespace cpu {
+namespace {
+
+// Arenas at least this large are mapped directly from the OS; smaller ones
+// come from the heap, to avoid a system call and a partially-used page each.
+constexpr std::uint64_t kMinMappedSize = 64 * 1024;
+
+#ifdef __linux__
+
+// Transparent huge pages are only worth requesting for arenas spanning
+// several of them.
+constexpr std::uint64_t kMinHugePageSize = 4 * 1024 * 1024;
+
+struct MapOptions {
+  bool huge_pages = false;
+  int numa_node = -1;
+};
+
+const MapOptions& GetMapOptions() {
+  static const MapOptions options = []() {
+    MapOptions result;
+    result.huge_pages = env::Get("PLAIDML_CPU_HUGEPAGES") == "1";
+    auto node = env::Get("PLAIDML_CPU_NUMA_NODE");
+    if (node.length()) {
+      result.numa_node = std::stoi(node);
+    }
+    return result;
+  }();
+  return options;
+}
 
-Arena::Arena(std::uint64_t size) { mem_.resize(size, '\0'); }
+#endif  // __linux__
+
+#ifdef _MSC_VER
+
+char* MapMemory(std::uint64_t size) {
+  return static_cast<char*>(VirtualAlloc(nullptr, size, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE));
+}
+
+void UnmapMemory(char* base, std::uint64_t /* size */) { VirtualFree(base, 0, MEM_RELEASE); }
+
+char* AllocMemory(std::uint64_t size) { return static_cast<char*>(_aligned_malloc(size, kBufferAlignment)); }
+
+void FreeMemory(char* base) { _aligned_free(base); }
+
+#else
+
+char* MapMemory(std::uint64_t size) {
+  void* base = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if (base == MAP_FAILED) {
+    return nullptr;
+  }
+#ifdef __linux__
+  const MapOptions& options = GetMapOptions();
+  if (options.huge_pages && kMinHugePageSize <= size) {
+    // Advisory only: kernels without transparent huge page support ignore it.
+    madvise(base, size, MADV_HUGEPAGE);
+  }
+  if (0 <= options.numa_node && options.numa_node < 64) {
+    // Invoked directly to avoid a dependency on libnuma.
+    constexpr int kMpolBind = 2;
+    unsigned long nodemask = 1UL << options.numa_node;  // NOLINT(runtime/int)
+    if (syscall(SYS_mbind, base, size, kMpolBind, &nodemask, 64, 0)) {
+      IVLOG(1, "Unable to bind arena to NUMA node " << options.numa_node);
+    }
+  }
+#endif
+  return static_cast<char*>(base);
+}
+
+void UnmapMemory(char* base, std::uint64_t size) { munmap(base, size); }
+
+char* AllocMemory(std::uint64_t size) {
+  void* base = nullptr;
+  if (posix_memalign(&base, kBufferAlignment, size)) {
+    return nullptr;
+  }
+  return static_cast<char*>(base);
+}
+
+void FreeMemory(char* base) { std::free(base); }
+
+#endif
+
+}  // namespace
+
+Arena::Arena(std::uint64_t size) : size_{size} {
+  if (kMinMappedSize <= size_) {
+    base_ = MapMemory(size_);
+    mapped_ = true;
+  } else {
+    // Always allocate something, so that every buffer has a distinct address.
+    base_ = AllocMemory(size_ ? size_ : 1);
+  }
+  if (!base_) {
+    throw std::bad_alloc{};
+  }
+}
+
+Arena::~Arena() {
+  if (mapped_) {
+    UnmapMemory(base_, size_);
+  } else {
+    FreeMemory(base_);
+  }
+}
 
 std::shared_ptr<hal::Buffer> Arena::MakeBuffer(std::uint64_t offset, std::uint64_t size) {
-  if (mem_.size() < offset || mem_.size() < size || mem_.size() < (offset + size)) {
+  if (size_ < offset || size_ < size || size_ < (offset + size)) {
     throw error::OutOfRange{"Requesting memory outside arena bounds"};
   }
-  return std::make_shared<Buffer>(shared_from_this(), mem_.data() + offset, size);
+  return std::make_shared<Buffer>(shared_from_this(), base_ + offset, size);
 }
 
 }  // namespace cpu
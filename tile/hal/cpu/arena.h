@@ -2,8 +2,9 @@
 
 #pragma once
 
+#include <cstddef>
+#include <cstdint>
 #include <memory>
-#include <vector>
 
 #include "tile/base/hal.h"
 
@@ -12,14 +13,28 @@ namespace tile {
 namespace hal {
 namespace cpu {
 
+// The alignment of every arena's base address, and therefore (since buffers
+// are placed at multiples of Memory::ArenaBufferAlignment) of every buffer's
+// base address.  This is enough for the widest vector loads LLVM emits.
+constexpr std::size_t kBufferAlignment = 64;
+
+// An Arena is a range of host memory.  Its contents are initially undefined.
+//
+// Large arenas are mapped directly from the OS: they're page-aligned, their
+// pages are only touched when first used, and they may be backed by
+// transparent huge pages (PLAIDML_CPU_HUGEPAGES=1) or bound to a NUMA node
+// (PLAIDML_CPU_NUMA_NODE=<node>) on Linux.
 class Arena : public hal::Arena, public std::enable_shared_from_this<Arena> {
  public:
   explicit Arena(std::uint64_t size);
+  ~Arena();
 
   std::shared_ptr<hal::Buffer> MakeBuffer(std::uint64_t offset, std::uint64_t size) final;
 
  private:
-  std::vector<char> mem_;
+  std::uint64_t size_;
+  char* base_ = nullptr;
+  bool mapped_ = false;
 };
 
 }  // namespace cpu
@@ -0,0 +1,44 @@
+// Copyright 2018 Intel Corporation.
+
+#include <gtest/gtest.h>
+
+#include <cstdint>
+#include <cstring>
+
+#include "base/util/error.h"
+#include "tile/hal/cpu/arena.h"
+#include "tile/hal/cpu/buffer.h"
+#include "tile/hal/cpu/memory.h"
+
+namespace vertexai {
+namespace tile {
+namespace hal {
+namespace cpu {
+namespace {
+
+bool IsAligned(const void* ptr) { return reinterpret_cast<std::uintptr_t>(ptr) % kBufferAlignment == 0; }
+
+TEST(ArenaTest, BuffersAreAligned) {
+  Memory memory;
+  for (std::uint64_t size : {0, 1, 100, 4096, 1 << 20, 16 << 20}) {
+    auto buffer = Buffer::Downcast(memory.MakeBuffer(size, BufferAccessMask::ALL));
+    EXPECT_TRUE(IsAligned(buffer->base())) << "size=" << size;
+    std::memset(buffer->base(), 0xA5, size);
+  }
+}
+
+TEST(ArenaTest, PlacedBuffersAreAligned) {
+  Memory memory;
+  auto arena = memory.MakeArena(1 << 20, BufferAccessMask::ALL);
+  for (std::uint64_t offset = 0; offset < (1 << 20); offset += memory.ArenaBufferAlignment() * 7) {
+    auto buffer = Buffer::Downcast(arena->MakeBuffer(offset, memory.ArenaBufferAlignment()));
+    EXPECT_TRUE(IsAligned(buffer->base())) << "offset=" << offset;
+  }
+  EXPECT_THROW(arena->MakeBuffer(1 << 20, 1), error::OutOfRange);
+}
+
+}  // namespace
+}  // namespace cpu
+}  // namespace hal
+}  // namespace tile
+}  // namespace vertexai
@@ -3,100 +3,281 @@
 #include "tile/hal/cpu/compiler.h"
 
 #include <llvm/ExecutionEngine/ExecutionEngine.h>
+#include <llvm/ExecutionEngine/ObjectCache.h>
 
+#include <algorithm>
+#include <chrono>
 #include <exception>
+#include <map>
 #include <memory>
-#include <mutex>
+#include <set>
 #include <sstream>
 #include <string>
 #include <utility>
 #include <vector>
 
+#include "base/util/error.h"
 #include "base/util/logging.h"
+#include "base/util/perf_counter.h"
+#include "tile/base/parallel_for.h"
 #include "tile/hal/cpu/emitllvm.h"
 #include "tile/hal/cpu/executable.h"
+#include "tile/hal/cpu/kernel_cache.h"
 #include "tile/hal/cpu/library.h"
+#include "tile/hal/cpu/loader.h"
 #include "tile/hal/cpu/runtime.h"
+#include "tile/hal/cpu/target.h"
 #include "tile/lang/semprinter.h"
 
 namespace vertexai {
 namespace tile {
 namespace hal {
 namespace cpu {
+namespace {
 
-Compiler::Compiler() {}
+// Measures the object code MCJIT generates for each module and, if asked to
+// keep it, captures it by module identifier so that it can be cached.  It
+// never supplies objects itself; cached kernels are added to engines directly.
+class ObjectCapture final : public llvm::ObjectCache {
+ public:
+  explicit ObjectCapture(bool keep) : keep_{keep} {}
+
+  void notifyObjectCompiled(const llvm::Module* module, llvm::MemoryBufferRef obj) final {
+    bytes_ += obj.getBufferSize();
+    if (keep_) {
+      objects_[module->getModuleIdentifier()].assign(obj.getBufferStart(), obj.getBufferSize());
+    }
+  }
+
+  std::unique_ptr<llvm::MemoryBuffer> getObject(const llvm::Module*) final { return nullptr; }
+
+  std::size_t bytes() const { return bytes_; }
+  std::map<std::string, std::string>& objects() { return objects_; }
+
+ private:
+  bool keep_;
+  std::size_t bytes_ = 0;
+  std::map<std::string, std::string> objects_;
+};
+
+// Compiles the modules, which must have been created in the supplied context,
+// into executable code for the host processor.  They share a single execution
+// engine, along with any previously compiled objects.
+std::shared_ptr<llvm::ExecutionEngine> CompileModules(std::vector<std::unique_ptr<llvm::Module>> modules,
+                                                      std::shared_ptr<llvm::LLVMContext> context, bool fuse_fp_ops,
+                                                      const std::vector<std::string>& objects,
+                                                      ObjectCapture* capture) {
+  std::string errStr;
+  std::unique_ptr<llvm::RuntimeDyld::SymbolResolver> rez(new Runtime);
+  llvm::EngineBuilder builder{std::move(modules[0])};
+  builder.setErrorStr(&errStr)
+      .setEngineKind(llvm::EngineKind::JIT)
+      .setVerifyModules(true)
+      .setSymbolResolver(std::move(rez));
+  ConfigureForHost(&builder, fuse_fp_ops);
+  llvm::ExecutionEngine* ee = builder.create();
+  if (!ee) {
+    throw error::Internal{"Failed to create ExecutionEngine: " + errStr};
+  }
+  auto engine = ShareEngine(ee, std::move(context));
+  for (std::size_t idx = 1; idx < modules.size(); ++idx) {
+    ee->addModule(std::move(modules[idx]));
+  }
+  for (const auto& object : objects) {
+    AddKernelObject(ee, object);
+  }
+  ee->setObjectCache(capture);
+  ee->finalizeObject();
+  ee->setObjectCache(nullptr);
+  return engine;
+}
+
+PerfCounter cpu_modules_built("cpu_modules_built");
+PerfCounter cpu_object_bytes("cpu_object_bytes");
+PerfCounter cpu_compile_ms("cpu_compile_ms");
+PerfCounter cpu_kernel_cache_hits("cpu_kernel_cache_hits");
+
+}  // namespace
+
+Compiler::Compiler(std::size_t max_modules) : Compiler{max_modules, KernelCache::Instance()} {}
+
+Compiler::Compiler(std::size_t max_modules, KernelCache* cache) : max_modules_{max_modules}, cache_{cache} {}
 
 boost::future<std::unique_ptr<hal::Library>> Compiler::Build(const context::Context& ctx,
                                                              const std::vector<lang::KernelInfo>& kernel_info,
-                                                             const hal::proto::HardwareSettings&) {
+                                                             const hal::proto::HardwareSettings& settings) {
   if (!kernel_info.size()) {
     return boost::make_ready_future(std::unique_ptr<hal::Library>{
         std::make_unique<cpu::Library>(std::vector<std::shared_ptr<llvm::ExecutionEngine>>{}, kernel_info)});
   }
 
-  static std::once_flag init_once;
-  std::call_once(init_once, []() {
-    LLVMInitializeNativeTarget();
-    LLVMLinkInMCJIT();
-    LLVMInitializeNativeAsmPrinter();
-    LLVMInitializeNativeAsmParser();
+  context::Activity activity{ctx, "tile::hal::cpu::Build"};
+  auto start = std::chrono::steady_clock::now();
+  InitializeNativeTarget();
+
+  // The kernels are split into a few contiguous runs, each compiled as one
+  // module by one execution engine, so that a library's code shares a handful
+  // of memory managers and code regions rather than one per kernel.  Each
+  // module is compiled in an LLVM context of its own, so modules (and
+  // concurrent builds, e.g. from the autotuner) compile in parallel.
+  std::size_t module_count = std::min(ResolveThreadCount(max_modules_), kernel_info.size());
+  std::vector<CompiledModule> modules(module_count);
+  std::vector<std::shared_ptr<llvm::ExecutionEngine>> module_engines(module_count);
+  ParallelFor(module_count, module_count, [&](std::size_t idx) {
+    std::size_t begin = idx * kernel_info.size() / module_count;
+    std::size_t end = (idx + 1) * kernel_info.size() / module_count;
+    std::vector<const lang::KernelInfo*> kernels;
+    for (std::size_t kidx = begin; kidx < end; ++kidx) {
+      kernels.push_back(&kernel_info[kidx]);
+    }
+    module_engines[idx] = BuildModule(kernels, !settings.disable_mad(), &modules[idx]);
   });
+
   std::vector<std::shared_ptr<llvm::ExecutionEngine>> engines;
-  for (const auto& ki : kernel_info) {
-    BuildKernel(ki, &engines);
+  std::size_t code_bytes = 0;
+  for (std::size_t idx = 0; idx < module_count; ++idx) {
+    engines.insert(engines.end(), modules[idx].symbols.size(), module_engines[idx]);
+    code_bytes += modules[idx].object_bytes;
   }
-  std::unique_ptr<hal::Library> lib(new cpu::Library(engines, kernel_info));
+  auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start);
+  VLOG(1) << "Compiled " << kernel_info.size() << " CPU kernels into " << module_count << " modules (" << code_bytes
+          << " bytes of object code) in " << elapsed.count() << "ms";
+  cpu_modules_built.add(module_count);
+  cpu_object_bytes.add(code_bytes);
+  cpu_compile_ms.add(elapsed.count());
+
+  std::unique_ptr<hal::Library> lib(new cpu::Library(engines, kernel_info, std::move(modules)));
   return boost::make_ready_future<>(std::move(lib));
 }
 
-void Compiler::BuildKernel(const lang::KernelInfo& ki, std::vector<std::shared_ptr<llvm::ExecutionEngine>>* engines) {
-  if (VLOG_IS_ON(4)) {
-    sem::Print debug_emit(*ki.kfunc);
-    VLOG(4) << "Compiling kernel:\n" << debug_emit.str();
+std::shared_ptr<llvm::ExecutionEngine> Compiler::BuildModule(const std::vector<const lang::KernelInfo*>& kernels,
+                                                             bool fuse_fp_ops, CompiledModule* module) {
+  if (cache_) {
+    try {
+      return BuildCachedModule(kernels, fuse_fp_ops, module);
+    } catch (const std::exception& ex) {
+      LOG(WARNING) << "Compiling CPU kernels without the kernel cache: " << ex.what();
+      *module = CompiledModule{};
+    }
   }
 
-  // Generate LLVM IR for the kernel.
-  Emit emit;
-  assert(ki.kfunc);
-  ki.kfunc->Accept(emit);
-  // Generate an invoker function wrapping the kernel params: we will pass in
-  // a pointer to an array of buffer pointers, and it will extract the members.
-  // This way we can use a single C function pointer invocation for all kernels.
-  GenerateInvoker(ki, emit.result().get());
+  // Generate LLVM IR for the kernels.  A kernel reused for several identical
+  // contractions appears once per use, under the same name; it only needs to
+  // be emitted once.
+  auto context = std::make_shared<llvm::LLVMContext>();
+  Emit emit{*context};
+  std::set<std::string> emitted;
+  for (const auto* ki : kernels) {
+    assert(ki->kfunc);
+    module->symbols.push_back(Executable::InvokerName(ki->kfunc->name));
+    if (!emitted.insert(ki->kfunc->name).second) {
+      continue;
+    }
+    if (VLOG_IS_ON(4)) {
+      sem::Print debug_emit(*ki->kfunc);
+      VLOG(4) << "Compiling kernel:\n" << debug_emit.str();
+    }
+    emit.set_local_size(ki->lwork);
+    ki->kfunc->Accept(emit);
+  }
+  // Generate an invoker function wrapping each kernel's params: we will pass
+  // in a pointer to an array of buffer pointers, and it will extract the
+  // members.  This way we can use a single C function pointer invocation for
+  // all kernels.
+  emitted.clear();
+  for (const auto* ki : kernels) {
+    if (emitted.insert(ki->kfunc->name).second) {
+      GenerateInvoker(*ki->kfunc, emit.module());
+    }
+  }
   if (VLOG_IS_ON(4)) {
     VLOG(4) << "Generated IR:\n" << emit.str();
   }
-  // Compile the IR into executable code.
-  std::string errStr;
-  std::unique_ptr<llvm::RuntimeDyld::SymbolResolver> rez(new Runtime);
-  llvm::ExecutionEngine* ee = llvm::EngineBuilder(std::move(emit.result()))
-                                  .setErrorStr(&errStr)
-                                  .setEngineKind(llvm::EngineKind::JIT)
-                                  .setVerifyModules(true)
-                                  .setSymbolResolver(std::move(rez))
-                                  .create();
-  if (ee) {
-    ee->finalizeObject();
-    engines->emplace_back(ee);
-  } else {
-    std::cerr << "Failed to create ExecutionEngine: " << errStr << std::endl;
+  std::vector<std::unique_ptr<llvm::Module>> modules;
+  modules.emplace_back(std::move(emit.result()));
+  // The object code is only needed to serialize the library, which is
+  // only supported with a kernel cache; otherwise the engine's own copy of
+  // the code is the only one kept.
+  ObjectCapture capture{false};
+  auto engine = CompileModules(std::move(modules), std::move(context), fuse_fp_ops, {}, &capture);
+  module->object_bytes = capture.bytes();
+  return engine;
+}
+
+std::shared_ptr<llvm::ExecutionEngine> Compiler::BuildCachedModule(const std::vector<const lang::KernelInfo*>& kernels,
+                                                                   bool fuse_fp_ops, CompiledModule* module) {
+  // Each kernel is cached as an object of its own, under a symbol derived from
+  // its content rather than its name, so that the same kernel is found again
+  // whatever it's called and whichever kernels it's compiled alongside.
+  // Kernels in the cache are loaded as they are; the rest are each emitted as
+  // an LLVM module of their own, and all of them share one execution engine.
+  auto context = std::make_shared<llvm::LLVMContext>();
+  std::vector<std::unique_ptr<llvm::Module>> compiled;
+  std::vector<std::string> compiled_keys;
+  std::set<std::string> seen;
+  for (const auto* ki : kernels) {
+    assert(ki->kfunc);
+    std::string key = KernelCache::Key(*ki, fuse_fp_ops);
+    sem::Function kfunc = *ki->kfunc;
+    kfunc.name = KernelCache::Symbol(key);
+    module->symbols.push_back(Executable::InvokerName(kfunc.name));
+    if (!seen.insert(key).second) {
+      continue;
+    }
+    std::string object;
+    if (cache_->Load(key, &object)) {
+      VLOG(4) << "Loaded CPU kernel " << ki->kname << " from the kernel cache as " << kfunc.name;
+      cpu_kernel_cache_hits.inc();
+      module->object_bytes += object.size();
+      module->objects.emplace_back(std::move(object));
+      continue;
+    }
+    if (VLOG_IS_ON(4)) {
+      sem::Print debug_emit(kfunc);
+      VLOG(4) << "Compiling kernel " << ki->kname << ":\n" << debug_emit.str();
+    }
+    Emit emit{*context};
+    emit.module()->setModuleIdentifier(key);
+    emit.set_local_size(ki->lwork);
+    kfunc.Accept(emit);
+    GenerateInvoker(kfunc, emit.module());
+    compiled.emplace_back(std::move(emit.result()));
+    compiled_keys.emplace_back(std::move(key));
+  }
+  if (compiled.empty()) {
+    return LoadKernelObjects(module->objects);
+  }
+
+  ObjectCapture capture{true};
+  auto engine = CompileModules(std::move(compiled), std::move(context), fuse_fp_ops, module->objects, &capture);
+  module->object_bytes += capture.bytes();
+  for (const auto& key : compiled_keys) {
+    auto it = capture.objects().find(key);
+    if (it == capture.objects().end()) {
+      // Without every kernel's object, the module can't be serialized.
+      module->objects.clear();
+      break;
+    }
+    cache_->Store(key, it->second);
+    module->objects.emplace_back(std::move(it->second));
   }
+  return engine;
 }
 
-void Compiler::GenerateInvoker(const lang::KernelInfo& ki, llvm::Module* module) {
+void Compiler::GenerateInvoker(const sem::Function& kfunc, llvm::Module* module) {
   // Generate a wrapper function for this kernel so that we can call it
   // generically no matter how many parameters it expects. The wrapper will
   // accept a pointer to an array of pointers, and it will call the kernel
   // using each element of the array as an argument. Following the array of
   // buffer pointers, it will pass along the GridSize value for the current
   // work index.
-  llvm::LLVMContext& context(llvm::getGlobalContext());
+  llvm::LLVMContext& context(module->getContext());
   llvm::IRBuilder<> builder(context);
   // LLVM doesn't have the notion of a void pointer, so we'll pretend all of
   // these buffers are arrays of int32.
   llvm::Type* inttype = llvm::Type::getInt32Ty(context);
   llvm::Type* ptrtype = inttype->getPointerTo();
-  size_t param_count = ki.kfunc->params.size();
+  size_t param_count = kfunc.params.size();
   llvm::Type* arrayptr = ptrtype->getPointerTo();
   unsigned archbits = module->getDataLayout().getPointerSizeInBits();
   llvm::Type* sizetype = llvm::IntegerType::get(context, archbits);
@@ -110,7 +291,7 @@ void Compiler::GenerateInvoker(const lang::KernelInfo& ki, llvm::Module* module)
   llvm::Type* voidtype = llvm::Type::getVoidTy(context);
   auto invokertype = llvm::FunctionType::get(voidtype, invoker_args, false);
   auto linkage = llvm::Function::ExternalLinkage;
-  std::string invokername = Executable::InvokerName(ki.kname);
+  std::string invokername = Executable::InvokerName(kfunc.name);
   const char* nstr = invokername.c_str();
   auto invoker = llvm::Function::Create(invokertype, linkage, nstr, module);
   // The invoker has no branches so we'll only need a single basic block.
@@ -122,7 +303,7 @@ void Compiler::GenerateInvoker(const lang::KernelInfo& ki, llvm::Module* module)
   std::vector<llvm::Type*> kernel_args(param_count, ptrtype);
   kernel_args.push_back(gridSizeType->getPointerTo());
   auto kerneltype = llvm::FunctionType::get(voidtype, kernel_args, false);
-  auto kernel = module->getOrInsertFunction(ki.kname, kerneltype);
+  auto kernel = module->getOrInsertFunction(kfunc.name, kerneltype);
   auto ai = invoker->arg_begin();
   llvm::Value* argvec = &(*ai);
   llvm::Value* workIndex = &(*++ai);
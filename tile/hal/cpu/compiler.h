@@ -2,10 +2,13 @@
 
 #pragma once
 
+#include <cstddef>
 #include <memory>
+#include <string>
 #include <vector>
 
 #include "tile/base/hal.h"
+#include "tile/lang/semtree.h"
 
 namespace llvm {
 class ExecutionEngine;
@@ -17,17 +20,32 @@ namespace tile {
 namespace hal {
 namespace cpu {
 
+struct CompiledModule;
+class KernelCache;
+
 class Compiler final : public hal::Compiler {
  public:
-  Compiler();
+  // Kernels are compiled in up to max_modules modules per library; zero
+  // means one module per core.  Compiled kernels are cached in
+  // KernelCache::Instance(), if there is one.
+  explicit Compiler(std::size_t max_modules = 0);
+
+  // As above, caching compiled kernels in the supplied cache, if any.
+  Compiler(std::size_t max_modules, KernelCache* cache);
 
   boost::future<std::unique_ptr<hal::Library>> Build(const context::Context& ctx,
                                                      const std::vector<lang::KernelInfo>& kernels,
-                                                     const hal::proto::HardwareSettings& /* settings */) final;
+                                                     const hal::proto::HardwareSettings& settings) final;
 
  private:
-  void BuildKernel(const lang::KernelInfo&, std::vector<std::shared_ptr<llvm::ExecutionEngine>>* engines);
-  void GenerateInvoker(const lang::KernelInfo&, llvm::Module*);
+  std::shared_ptr<llvm::ExecutionEngine> BuildModule(const std::vector<const lang::KernelInfo*>& kernels,
+                                                     bool fuse_fp_ops, CompiledModule* module);
+  std::shared_ptr<llvm::ExecutionEngine> BuildCachedModule(const std::vector<const lang::KernelInfo*>& kernels,
+                                                           bool fuse_fp_ops, CompiledModule* module);
+  void GenerateInvoker(const sem::Function& kfunc, llvm::Module* module);
+
+  std::size_t max_modules_;
+  KernelCache* cache_;
 };
 
 }  // namespace cpu
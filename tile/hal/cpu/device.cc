@@ -6,13 +6,14 @@
 
 #include "tile/hal/cpu/compiler.h"
 #include "tile/hal/cpu/executor.h"
+#include "tile/hal/cpu/loader.h"
 
 namespace vertexai {
 namespace tile {
 namespace hal {
 namespace cpu {
 
-Device::Device() : compiler_{new Compiler}, executor_{new Executor} {}
+Device::Device() : compiler_{new Compiler}, loader_{new Loader}, executor_{new Executor} {}
 
 }  // namespace cpu
 }  // namespace hal
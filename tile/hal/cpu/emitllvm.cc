@@ -2,15 +2,20 @@
 
 #include "tile/hal/cpu/emitllvm.h"
 
+#include <llvm/Analysis/ValueTracking.h>
+#include <llvm/IR/Metadata.h>
 #include <llvm/Support/raw_ostream.h>
 #include <llvm/Transforms/IPO/PassManagerBuilder.h>
 #include <llvm/Transforms/Scalar.h>
 
 #include <algorithm>
 #include <array>
+#include <set>
+#include <string>
 #include <utility>
 #include <vector>
 
+#include "tile/hal/cpu/arena.h"
 #include "tile/lang/exprtype.h"
 #include "tile/lang/fnv1a64.h"
 #include "tile/lang/generate.h"
@@ -26,8 +31,98 @@ class Error : public std::runtime_error {
   using std::runtime_error::runtime_error;
 };
 
-Emit::Emit()
-    : context_(llvm::getGlobalContext()),
+namespace {
+
+// Scans statements for barriers, and for the names of the variables they use.
+class Scanner final : public sem::Visitor {
+ public:
+  void Visit(const sem::IntConst&) final {}
+  void Visit(const sem::FloatConst&) final {}
+  void Visit(const sem::LookupLVal& n) final { names_.insert(n.name); }
+  void Visit(const sem::LoadExpr& n) final { Scan(n.inner); }
+  void Visit(const sem::StoreStmt& n) final {
+    Scan(n.lhs);
+    Scan(n.rhs);
+  }
+  void Visit(const sem::SubscriptLVal& n) final {
+    Scan(n.ptr);
+    Scan(n.offset);
+  }
+  void Visit(const sem::DeclareStmt& n) final { Scan(n.init); }
+  void Visit(const sem::UnaryExpr& n) final { Scan(n.inner); }
+  void Visit(const sem::BinaryExpr& n) final {
+    Scan(n.lhs);
+    Scan(n.rhs);
+  }
+  void Visit(const sem::CondExpr& n) final {
+    Scan(n.cond);
+    Scan(n.tcase);
+    Scan(n.fcase);
+  }
+  void Visit(const sem::SelectExpr& n) final {
+    Scan(n.cond);
+    Scan(n.tcase);
+    Scan(n.fcase);
+  }
+  void Visit(const sem::ClampExpr& n) final {
+    Scan(n.val);
+    Scan(n.min);
+    Scan(n.max);
+  }
+  void Visit(const sem::CastExpr& n) final { Scan(n.val); }
+  void Visit(const sem::CallExpr& n) final {
+    for (const auto& val : n.vals) {
+      Scan(val);
+    }
+  }
+  void Visit(const sem::LimitConst&) final {}
+  void Visit(const sem::IndexExpr&) final {}
+  void Visit(const sem::Block& n) final {
+    for (const auto& stmt : n.statements) {
+      Scan(stmt);
+    }
+  }
+  void Visit(const sem::IfStmt& n) final {
+    Scan(n.cond);
+    Scan(n.iftrue);
+    Scan(n.iffalse);
+  }
+  void Visit(const sem::ForStmt& n) final { Scan(n.inner); }
+  void Visit(const sem::WhileStmt& n) final {
+    Scan(n.cond);
+    Scan(n.inner);
+  }
+  void Visit(const sem::BarrierStmt&) final { barrier_ = true; }
+  void Visit(const sem::ReturnStmt& n) final { Scan(n.value); }
+  void Visit(const sem::Function& n) final { Scan(n.body); }
+
+  template <typename P>
+  void Scan(const P& node) {
+    if (node) {
+      node->Accept(*this);
+    }
+  }
+
+  bool barrier() const { return barrier_; }
+  const std::set<std::string>& names() const { return names_; }
+
+ private:
+  bool barrier_ = false;
+  std::set<std::string> names_;
+};
+
+bool ContainsBarrier(const sem::StmtPtr& stmt) {
+  Scanner scanner;
+  scanner.Scan(stmt);
+  return scanner.barrier();
+}
+
+}  // namespace
+
+Emit::Emit() : Emit(llvm::getGlobalContext()) {}
+
+Emit::Emit(llvm::LLVMContext& context)
+    : context_(context),
       builder_{context_},
       module_{new llvm::Module("tile", context_)},
       funcopt_{module_.get()},
@@ -39,6 +134,16 @@ Emit::Emit()
   auto gridSizeCount = std::tuple_size<lang::GridSize>::value;
   gridSizeType_ = llvm::ArrayType::get(ssizetype_, gridSizeCount);
 
+  // Tile doesn't distinguish the sign of zero, and makes no promises about the
+  // rounding of intermediate results, so LLVM may ignore signed zeros and
+  // replace division with multiplication by a reciprocal.  Reassociation is
+  // left off: in this LLVM it also assumes no NaNs or infinities, which user
+  // data may well contain.
+  llvm::FastMathFlags fmf;
+  fmf.setNoSignedZeros();
+  fmf.setAllowReciprocal();
+  builder_.SetFastMathFlags(fmf);
+
   // Generate an external reference for the barrier function.
   std::vector<llvm::Type*> no_args;
   llvm::Type* voidType = llvm::Type::getVoidTy(context_);
@@ -122,7 +227,11 @@ void Emit::Visit(const sem::SubscriptLVal& n) {
 }
 
 void Emit::Visit(const sem::DeclareStmt& n) {
-  llvm::Value* lhs = Define(n.name, n.type);
+  // Within a work-item loop, arrays, and variables used by later loops, need
+  // storage of their own for each work item.
+  bool per_item =
+      in_items_ && n.type.region != sem::Type::LOCAL && (n.type.array || per_item_decls_.count(&n));
+  llvm::Value* lhs = Define(n.name, n.type, per_item);
   if (n.init) {
     // The declaration provides a single initialization value. If this is an
     // array, we'll assign that value to every element.
@@ -653,31 +762,35 @@ void Emit::Visit(const sem::LimitConst& n) {
 }
 
 void Emit::Visit(const sem::IndexExpr& n) {
-  // The local index is always zero on the CPU, since we don't have anything
-  // analogous to OpenCL's local work items: that is, there is one "work item"
-  // per "work group", which is what we call a thread. Furthermore, since there
-  // is exactly one work item per work group, the global work-item ID always
-  // equals the work-group ID. The current work index must be supplied as an
-  // implicit trailing parameter to the kernel invocation.
+  // Each call of a kernel function runs one work-group, whose index is
+  // supplied as an implicit trailing parameter. The work items of the group
+  // are the iterations of the work-item loops generated by EmitWorkItems; code
+  // outside those loops is uniform across the work-group, and sees the first
+  // work item's index.
   sem::Type idxType{sem::Type::INDEX};
+  if (n.type == sem::IndexExpr::LOCAL) {
+    Resolve(value{LocalIndex(n.dim), idxType});
+    return;
+  }
   llvm::Value* zero = llvm::ConstantInt::get(int32type_, 0);
-  switch (n.type) {
-    case sem::IndexExpr::LOCAL:
-      Resolve(value{zero, idxType});
-      break;
-    case sem::IndexExpr::GROUP:
-    case sem::IndexExpr::GLOBAL:
-      llvm::Value* ndim = llvm::ConstantInt::get(int32type_, n.dim);
-      llvm::Value* resptr = builder_.CreateGEP(workIndex_, {zero, ndim});
-      Resolve(value{builder_.CreateLoad(resptr), idxType});
-      break;
+  llvm::Value* ndim = llvm::ConstantInt::get(int32type_, n.dim);
+  llvm::Value* resptr = builder_.CreateGEP(workIndex_, {zero, ndim});
+  llvm::Value* index = builder_.CreateLoad(resptr);
+  if (n.type == sem::IndexExpr::GLOBAL && local_size_[n.dim] > 1) {
+    llvm::Value* size = llvm::ConstantInt::get(ssizetype_, local_size_[n.dim]);
+    index = builder_.CreateAdd(builder_.CreateMul(index, size), LocalIndex(n.dim));
   }
+  Resolve(value{index, idxType});
 }
 
 void Emit::Visit(const sem::Block& n) {
   Enter();
-  for (const sem::StmtPtr& s : n.statements) {
-    s->Accept(*this);
+  if (local_count_ > 1 && !in_items_) {
+    EmitWorkGroup(n.statements);
+  } else {
+    for (const sem::StmtPtr& s : n.statements) {
+      s->Accept(*this);
+    }
   }
   Leave();
 }
@@ -777,11 +890,19 @@ void Emit::Visit(const sem::WhileStmt& n) {
 }
 
 void Emit::Visit(const sem::BarrierStmt& n) {
+  if (local_count_ > 1) {
+    // Barriers separate work-item loops (see EmitWorkGroup); there's nothing
+    // left to synchronize.
+    return;
+  }
   std::vector<llvm::Value*> args;
   builder_.CreateCall(barrier_func_, args, "");
 }
 
 void Emit::Visit(const sem::ReturnStmt& n) {
+  if (in_items_) {
+    throw Error("returning from within a multi-item work-group is unsupported");
+  }
   if (CurrentBlockIsTerminated()) {
     throw Error("unreachable duplicate return in this block");
   }
@@ -828,6 +949,13 @@ void Emit::Visit(const sem::Function& n) {
       sem::Type paramType = n.params[idx].first;
       llvm::Value* alloc = Define(paramName, paramType);
       ai->setName(paramName);
+      if (paramType.region == sem::Type::GLOBAL &&
+          (paramType.base == sem::Type::POINTER_MUT || paramType.base == sem::Type::POINTER_CONST)) {
+        // Global buffers always start at an arena-aligned address.
+        llvm::AttrBuilder attrs;
+        attrs.addAlignmentAttr(kBufferAlignment);
+        ai->addAttr(llvm::AttributeSet::get(context_, idx + 1, attrs));
+      }
       builder_.CreateStore(&(*ai), alloc);
     } else {
       // The implicit work item index parameter
@@ -836,8 +964,20 @@ void Emit::Visit(const sem::Function& n) {
     }
   }
 
-  // Emit the body of the function, which is probably a block.
-  n.body->Accept(*this);
+  // Emit the body of the function, which is probably a block. Multi-item
+  // work-groups loop over their work items; if there are no barriers, the
+  // whole body is a single work-item loop.
+  if (local_count_ > 1) {
+    llvm::IRBuilder<> top(bb, bb->begin());
+    lid_var_ = top.CreateAlloca(ssizetype_, nullptr, "_lid");
+    if (ContainsBarrier(n.body)) {
+      n.body->Accept(*this);
+    } else {
+      EmitWorkItems({n.body}, {});
+    }
+  } else {
+    n.body->Accept(*this);
+  }
 
   // If this block has not yet been terminated, generate an implicit return.
   if (!CurrentBlockIsTerminated()) {
@@ -846,10 +986,138 @@ void Emit::Visit(const sem::Function& n) {
 
   Leave();
   returntype_.base = sem::Type::TVOID;
+  lid_var_ = nullptr;
+  per_item_vars_.clear();
+  item_scalars_.clear();
 
   funcopt_.run(*function_);
 }
 
+void Emit::set_local_size(const lang::GridSize& lwork) {
+  local_count_ = 1;
+  for (std::size_t i = 0; i < lwork.size(); ++i) {
+    local_size_[i] = std::max<std::size_t>(1, lwork[i]);
+    local_count_ *= local_size_[i];
+  }
+}
+
+void Emit::EmitWorkGroup(const std::vector<sem::StmtPtr>& stmts) {
+  // Each run of statements without barriers becomes a loop over the work
+  // items. Statements containing barriers are executed uniformly by the
+  // work-group, as OpenCL requires of them, so their control flow is emitted
+  // once, and the statements within them are split in the same way.
+  std::vector<sem::StmtPtr> run;
+  for (std::size_t idx = 0; idx < stmts.size(); ++idx) {
+    if (!ContainsBarrier(stmts[idx])) {
+      run.push_back(stmts[idx]);
+      continue;
+    }
+    if (run.size()) {
+      EmitWorkItems(run, {stmts.begin() + idx, stmts.end()});
+      run.clear();
+    }
+    stmts[idx]->Accept(*this);
+  }
+  if (run.size()) {
+    EmitWorkItems(run, {});
+  }
+}
+
+void Emit::EmitWorkItems(const std::vector<sem::StmtPtr>& run, const std::vector<sem::StmtPtr>& rest) {
+  // Variables declared by the run and used by the rest of the enclosing block
+  // must survive past the loop, so each work item gets its own copy.
+  Scanner later;
+  for (const auto& stmt : rest) {
+    later.Scan(stmt);
+  }
+  for (const auto& stmt : run) {
+    auto decl = std::dynamic_pointer_cast<sem::DeclareStmt>(stmt);
+    if (decl && later.names().count(decl->name)) {
+      per_item_decls_.insert(decl.get());
+    }
+  }
+
+  auto bodyblock = llvm::BasicBlock::Create(context_, "items");
+  auto testblock = llvm::BasicBlock::Create(context_, "items_test");
+  auto iterblock = llvm::BasicBlock::Create(context_, "items_iter");
+  auto doneblock = llvm::BasicBlock::Create(context_, "items_done");
+
+  builder_.CreateStore(llvm::ConstantInt::get(ssizetype_, 0), lid_var_);
+  builder_.CreateBr(testblock);
+
+  function_->getBasicBlockList().push_back(testblock);
+  builder_.SetInsertPoint(testblock);
+  llvm::Value* lid = builder_.CreateLoad(lid_var_);
+  llvm::Value* limit = llvm::ConstantInt::get(ssizetype_, local_count_);
+  builder_.CreateCondBr(builder_.CreateICmpULT(lid, limit), bodyblock, doneblock);
+
+  function_->getBasicBlockList().push_back(bodyblock);
+  builder_.SetInsertPoint(bodyblock);
+  in_items_ = true;
+  lid_ = lid;
+  for (const auto& stmt : run) {
+    stmt->Accept(*this);
+  }
+  in_items_ = false;
+  lid_ = nullptr;
+  per_item_decls_.clear();
+  if (!CurrentBlockIsTerminated()) {
+    builder_.CreateBr(iterblock);
+  }
+
+  // Work items only communicate across barriers, so the iterations are
+  // independent: tell LLVM, so that it can vectorize the loop across work
+  // items. The exception is the storage of variables shared by every
+  // iteration, which LLVM will generally promote to registers anyway.
+  llvm::SmallVector<llvm::Metadata*, 1> loop_args;
+  auto temp = llvm::MDNode::getTemporary(context_, llvm::None);
+  loop_args.push_back(temp.get());
+  llvm::MDNode* loop_id = llvm::MDNode::get(context_, loop_args);
+  loop_id->replaceOperandWith(0, loop_id);
+  const llvm::DataLayout& layout = module_->getDataLayout();
+  for (auto bb = bodyblock->getIterator(); bb != function_->end(); ++bb) {
+    for (auto& inst : *bb) {
+      llvm::Value* ptr = nullptr;
+      if (auto load = llvm::dyn_cast<llvm::LoadInst>(&inst)) {
+        ptr = load->getPointerOperand();
+      } else if (auto store = llvm::dyn_cast<llvm::StoreInst>(&inst)) {
+        ptr = store->getPointerOperand();
+      }
+      if (ptr && !item_scalars_.count(llvm::GetUnderlyingObject(ptr, layout))) {
+        inst.setMetadata(llvm::LLVMContext::MD_mem_parallel_loop_access, loop_id);
+      }
+    }
+  }
+
+  function_->getBasicBlockList().push_back(iterblock);
+  builder_.SetInsertPoint(iterblock);
+  builder_.CreateStore(builder_.CreateAdd(lid, llvm::ConstantInt::get(ssizetype_, 1)), lid_var_);
+  auto backedge = builder_.CreateBr(testblock);
+  backedge->setMetadata(llvm::LLVMContext::MD_loop, loop_id);
+
+  function_->getBasicBlockList().push_back(doneblock);
+  builder_.SetInsertPoint(doneblock);
+}
+
+llvm::Value* Emit::LocalIndex(std::size_t dim) {
+  if (!lid_ || local_size_[dim] == 1) {
+    return llvm::ConstantInt::get(ssizetype_, 0);
+  }
+  // Work items are numbered with the first dimension varying fastest.
+  std::size_t below = 1;
+  for (std::size_t i = 0; i < dim; ++i) {
+    below *= local_size_[i];
+  }
+  llvm::Value* index = lid_;
+  if (below > 1) {
+    index = builder_.CreateUDiv(index, llvm::ConstantInt::get(ssizetype_, below));
+  }
+  if (below * local_size_[dim] < local_count_) {
+    index = builder_.CreateURem(index, llvm::ConstantInt::get(ssizetype_, local_size_[dim]));
+  }
+  return index;
+}
+
 std::string Emit::str() const {
   std::string r;
   llvm::raw_string_ostream os(r);
@@ -929,22 +1197,42 @@ llvm::Type* Emit::CType(const sem::Type& type) {
   return t;
 }
 
-llvm::Value* Emit::Define(const std::string& name, sem::Type type) {
+llvm::Value* Emit::Define(const std::string& name, sem::Type type, bool per_item) {
   auto& symbols = blocks_.front().symbols;
   if (symbols.find(name) != symbols.end()) {
     throw Error("Duplicate definitions in same block");
   }
   llvm::BasicBlock& entry = function_->getEntryBlock();
   llvm::IRBuilder<> top(&entry, entry.begin());
-  llvm::Value* ptr = top.CreateAlloca(CType(type), nullptr, name.c_str());
+  llvm::Type* ctype = CType(type);
+  if (per_item) {
+    ctype = llvm::ArrayType::get(ctype, local_count_);
+  }
+  llvm::Value* ptr = top.CreateAlloca(ctype, nullptr, name.c_str());
   symbols.emplace(name, value{ptr, type});
+  if (per_item) {
+    per_item_vars_.insert(ptr);
+    return ItemElement(ptr);
+  }
+  if (in_items_ && type.region != sem::Type::LOCAL) {
+    item_scalars_.insert(ptr);
+  }
   return ptr;
 }
 
+llvm::Value* Emit::ItemElement(llvm::Value* ptr) {
+  llvm::Value* zero = llvm::ConstantInt::get(int32type_, 0);
+  llvm::Value* lid = lid_ ? lid_ : llvm::ConstantInt::get(ssizetype_, 0);
+  return builder_.CreateGEP(ptr, {zero, lid});
+}
+
 Emit::value Emit::Lookup(const std::string& name) {
   for (const auto& m : blocks_) {
     const auto it = m.symbols.find(name);
     if (it != m.symbols.end()) {
+      if (per_item_vars_.count(it->second.v)) {
+        return value{ItemElement(it->second.v), it->second.t};
+      }
       return it->second;
     }
   }
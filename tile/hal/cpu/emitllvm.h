@@ -10,9 +10,12 @@
 #include <deque>
 #include <map>
 #include <memory>
+#include <set>
 #include <string>
 #include <utility>
+#include <vector>
 
+#include "tile/lang/generate.h"
 #include "tile/lang/semtree.h"
 
 namespace vertexai {
@@ -22,7 +25,10 @@ namespace cpu {
 
 class Emit : public sem::Visitor {
  public:
+  // Emits into LLVM's global context.
   Emit();
+  // Emits into the supplied context, which must outlive the emitted module.
+  explicit Emit(llvm::LLVMContext& context);  // NOLINT(runtime/references)
   void Visit(const sem::IntConst&) override;
   void Visit(const sem::FloatConst&) override;
   void Visit(const sem::LookupLVal&) override;
@@ -46,7 +52,13 @@ class Emit : public sem::Visitor {
   void Visit(const sem::BarrierStmt&) override;
   void Visit(const sem::ReturnStmt&) override;
   void Visit(const sem::Function&) override;
+  // Sets the work-group size of the functions emitted after this call.  Each
+  // work-group runs as a single call, looping over its work items between
+  // barriers; a size of zero in any dimension is treated as one.
+  void set_local_size(const lang::GridSize& lwork);
   std::string str() const;
+  // The module being emitted, for adding further definitions before result().
+  llvm::Module* module() const { return module_.get(); }
   std::unique_ptr<llvm::Module>&& result();
 
  private:
@@ -70,13 +82,17 @@ class Emit : public sem::Visitor {
   value LVal(sem::LValPtr l);
   void Resolve(value);
   llvm::Type* CType(const sem::Type&);
-  llvm::Value* Define(const std::string& name, sem::Type type);
+  llvm::Value* Define(const std::string& name, sem::Type type, bool per_item = false);
+  llvm::Value* ItemElement(llvm::Value* ptr);
   value Lookup(const std::string& name);
   llvm::Value* CastTo(value, sem::Type);
   llvm::Value* ToBool(llvm::Value*);
   void Enter();
   void EnterLoop(llvm::BasicBlock* done, llvm::BasicBlock* check);
   void Leave();
+  void EmitWorkGroup(const std::vector<sem::StmtPtr>& stmts);
+  void EmitWorkItems(const std::vector<sem::StmtPtr>& run, const std::vector<sem::StmtPtr>& rest);
+  llvm::Value* LocalIndex(std::size_t dim);
   void LimitConstSInt(unsigned bits, sem::LimitConst::Which);
   void LimitConstUInt(unsigned bits, sem::LimitConst::Which);
   void LimitConstFP(const llvm::fltSemantics&, sem::LimitConst::Which);
@@ -103,6 +119,19 @@ class Emit : public sem::Visitor {
   std::map<std::string, llvm::Function*> builtins_;
   block_stack blocks_;
   value result_;
+  // Work-group lowering: when a work-group has more than one work item, the
+  // code between barriers runs in loops over the work items, with _lid_ the
+  // current work item.  Variables which must survive from one of those loops
+  // to the next are stored per work item; item_scalars_ holds the variables
+  // which are instead shared by every iteration of the current loop.
+  lang::GridSize local_size_{{1, 1, 1}};
+  std::size_t local_count_ = 1;
+  bool in_items_ = false;
+  llvm::Value* lid_var_ = nullptr;
+  llvm::Value* lid_ = nullptr;
+  std::set<const sem::DeclareStmt*> per_item_decls_;
+  std::set<llvm::Value*> per_item_vars_;
+  std::set<llvm::Value*> item_scalars_;
   // What is the current function's return value type? This will be populated
   // on entry to the Function visitor and cleared on exit, so it can be used
   // during nested evaluations.
@@ -5,9 +5,6 @@
 #include <llvm/ExecutionEngine/ExecutionEngine.h>
 
 #include <algorithm>
-#include <condition_variable>
-#include <mutex>
-#include <thread>
 #include <utility>
 
 #include <boost/asio.hpp>
@@ -16,6 +13,7 @@
 #include "base/util/error.h"
 #include "tile/hal/cpu/buffer.h"
 #include "tile/hal/cpu/event.h"
+#include "tile/hal/cpu/grid.h"
 #include "tile/hal/cpu/runtime.h"
 
 namespace vertexai {
@@ -33,11 +31,22 @@ const char invoker_prefix_[] = "__invoke_";
 // a long time, so we'll perform the count only once at startup.
 const size_t physical_cores_ = boost::thread::physical_concurrency();
 
+// Each call of a kernel's entrypoint runs a whole work-group, so the grid we
+// walk counts work-groups, not work items.
+lang::GridSize GroupGrid(const lang::KernelInfo& ki) {
+  lang::GridSize groups;
+  for (std::size_t i = 0; i < groups.size(); ++i) {
+    std::size_t lwork = std::max<std::size_t>(1, ki.lwork[i]);
+    groups[i] = (ki.gwork[i] + lwork - 1) / lwork;
+  }
+  return groups;
+}
+
 }  // namespace
 
 Executable::Executable(std::vector<std::shared_ptr<llvm::ExecutionEngine>> engines, std::vector<lang::KernelInfo> kis,
-                       std::shared_ptr<boost::asio::thread_pool> thread_pool)
-    : engines_{engines}, kis_(kis), thread_pool_(thread_pool) {}
+                       std::vector<std::string> symbols, std::shared_ptr<boost::asio::thread_pool> thread_pool)
+    : engines_{engines}, kis_(kis), symbols_(symbols), thread_pool_(thread_pool) {}
 
 std::shared_ptr<hal::Event> Executable::Run(const context::Context& ctx, std::size_t kidx,
                                             const std::vector<std::shared_ptr<hal::Buffer>>& params,
@@ -47,8 +56,8 @@ std::shared_ptr<hal::Event> Executable::Run(const context::Context& ctx, std::si
   std::vector<std::shared_ptr<hal::Buffer>> param_refs{params};
   auto deps = Event::WaitFor(dependencies);
   auto evt = deps.then([params = std::move(param_refs), act = std::move(activity), engine = engines_[kidx],
-                        invoker_name = InvokerName(kis_[kidx].kname), thread_pool = thread_pool_,
-                        gwork = kis_[kidx].gwork](decltype(deps) future) -> std::shared_ptr<hal::Result> {
+                        invoker_name = symbols_[kidx], thread_pool = thread_pool_,
+                        groups = GroupGrid(kis_[kidx])](decltype(deps) future) {
     future.get();
     auto start = std::chrono::high_resolution_clock::now();
     // Get the base address for all of these buffers, populating an argument
@@ -57,48 +66,19 @@ std::shared_ptr<hal::Event> Executable::Run(const context::Context& ctx, std::si
     for (size_t i = 0; i < args.size(); ++i) {
       args[i] = Buffer::Downcast(params[i])->base();
     }
-    void* argvec = args.data();
-    uint64_t entrypoint = engine->getFunctionAddress(invoker_name);
-    // Iterate through the grid coordinates specified for this kernel, invoking
-    // the kernel function once for each. We'll create one thread per core and
-    // run one loop in each thread, staggering kernel invocations accordingly.
-    size_t iterations = gwork[0] * gwork[1] * gwork[2];
-    lang::GridSize denom = {{gwork[2] * gwork[1], gwork[2], 1}};
-    size_t threads = std::min(iterations, physical_cores_);
-
-    // The condition variable will guard the completion count. Each worker
-    // will increment the completion count, and we'll wait until it reaches
-    // the number of threads before returning.
-    std::mutex mutex;
-    std::condition_variable cv;
-    size_t completed = 0;
-
-    for (size_t offset = 0; offset < threads; ++offset) {
-      boost::asio::post(*thread_pool, [=, &mutex, &cv, &completed]() {
-        for (size_t i = offset; i < iterations; i += threads) {
-          lang::GridSize index;
-          index[0] = i / denom[0] % gwork[0];
-          index[1] = i / denom[1] % gwork[1];
-          index[2] = i / denom[2] % gwork[2];
-          ((void (*)(void*, lang::GridSize*))entrypoint)(argvec, &index);
-        }
-        {
-          std::unique_lock<std::mutex> lock{mutex};
-          if (++completed == threads) {
-            cv.notify_all();
-          }
-        }
-      });
-    }
-    {
-      std::unique_lock<std::mutex> lock{mutex};
-      cv.wait(lock, [&]() { return threads <= completed; });
-    }
-
-    return std::make_shared<Result>(act.ctx(), "tile::hal::cpu::Executing", start,
-                                    std::chrono::high_resolution_clock::now());
+    auto entrypoint = reinterpret_cast<GridEntry>(engine->getFunctionAddress(invoker_name));
+    // Invoke the kernel function once for each work-group, with one worker
+    // per core. The result is produced by whichever worker finishes last, so
+    // no pool thread is parked waiting for the others.
+    auto done = RunGrid(thread_pool, physical_cores_, groups, entrypoint, std::move(args));
+    return done.then(boost::launch::sync,
+                     [params, ctx = act.ctx(), start](boost::future<void> f) -> std::shared_ptr<hal::Result> {
+                       f.get();
+                       return std::make_shared<Result>(ctx, "tile::hal::cpu::Executing", start,
+                                                       std::chrono::high_resolution_clock::now());
+                     });
   });
-  return std::make_shared<cpu::Event>(std::move(evt));
+  return std::make_shared<cpu::Event>(evt.unwrap());
 }
 
 std::string Executable::InvokerName(std::string kname) { return invoker_prefix_ + kname; }
@@ -22,8 +22,9 @@ namespace cpu {
 
 class Executable final : public hal::Executable {
  public:
+  // symbols names each kernel's invoker within its engine.
   Executable(std::vector<std::shared_ptr<llvm::ExecutionEngine>> engines, std::vector<lang::KernelInfo> kis,
-             std::shared_ptr<boost::asio::thread_pool> thread_pool);
+             std::vector<std::string> symbols, std::shared_ptr<boost::asio::thread_pool> thread_pool);
 
   std::shared_ptr<hal::Event> Run(const context::Context& ctx, std::size_t kidx,
                                   const std::vector<std::shared_ptr<hal::Buffer>>& params,
@@ -35,6 +36,7 @@ class Executable final : public hal::Executable {
  private:
   std::vector<std::shared_ptr<llvm::ExecutionEngine>> engines_;
   std::vector<lang::KernelInfo> kis_;
+  std::vector<std::string> symbols_;
   std::shared_ptr<boost::asio::thread_pool> thread_pool_;
 };
 
@@ -12,6 +12,7 @@
 #include "tile/hal/cpu/executable.h"
 #include "tile/hal/cpu/library.h"
 #include "tile/hal/cpu/memory.h"
+#include "tile/hal/cpu/target.h"
 #include "tile/hal/util/selector.h"
 
 namespace vertexai {
@@ -24,39 +25,43 @@ hal::proto::HardwareInfo GetHardwareInfo() {
   // Get the info required to tell the compiler how to generate efficient code for the target hardware.
   hal::proto::HardwareInfo info;
 
-  // TODO: We should use the actual processor identifier here.
+  // The name stays generic so that hardware configs can select the CPU device; the processor itself is described by
+  // the settings below.
   info.set_type(hal::proto::HardwareType::CPU);
   info.set_name("LLVM CPU");
   info.set_vendor("LLVM");
 
   hal::proto::HardwareSettings* settings = info.mutable_settings();
+  const HostTarget& host = GetHostTarget();
 
-  // We will run one thread per CPU core to process one workgroup. That means we will have a single thread per
-  // workgroup.
-  settings->set_threads(1);
+  // Each workgroup runs on a single CPU core, as a loop over its work items which LLVM vectorizes; we use one work
+  // item per 32-bit SIMD lane.
+  settings->set_threads(host.vector_bits / 32);
 
   // The vector size is currently the number of elements in the a SIMD register for some assumed datatype. We should
   // probably change this to indicate the bit width of the register instead, because the number of elements depends on
-  // element type.
-  settings->set_vec_size(4);
+  // element type. For now, we assume 32-bit floats.
+  settings->set_vec_size(host.vector_bits / 32);
 
   // GPUs have a concept of local memory, which works like an L1 cache that you manage explicitly. We'll let the
   // processor manage cache for us, which means we are using "global memory" in GPU terms.
   settings->set_use_global(true);
 
-  // Memory width is the size of a cache line. That is, what is the smallest unit of memory we can load at a time? This
-  // is technically variable but it happens to be the same for x86 and ARM architectures we care about.
-
-  settings->set_mem_width(64);
+  // Memory width is the size of a cache line. That is, what is the smallest unit of memory we can load at a time?
+  settings->set_mem_width(host.cache_line);
 
   // Maximum memory is another concept based on GPU local memory. It roughly means the size of the L1 cache: that is,
   // how much data can we efficiently read at one time?
+  settings->set_max_mem(host.l1_cache);
 
-  settings->set_max_mem(32768);
+  // Since we use global memory, the tile optimizer bounds each workgroup's inputs by the cache instead; keeping them
+  // within L2 lets the inner loops reuse them without going back to main memory.
+  settings->set_max_cache(host.l2_cache);
 
-  // Maximum number of registers refers to the vector unit registers. It controls the number of outputs which can be
-  // generated at a time. This number is for NEON. 32-bit SSE had 8; AMD64 extended it to 16.
-  settings->set_max_regs(32);
+  // Maximum number of registers refers to the vector unit registers, in bytes. It controls the number of outputs which
+  // can be generated at a time. We budget half of the register file for outputs, leaving the rest for inputs and
+  // temporaries.
+  settings->set_max_regs(host.vector_registers / 2 * host.vector_bits / 8);
 
   // Minimum number of work groups: we need one workgroup per core.
   settings->set_goal_groups(1);
@@ -103,7 +108,7 @@ std::shared_ptr<hal::Event> Executor::Copy(const context::Context& ctx, const st
 
 boost::future<std::unique_ptr<hal::Executable>> Executor::Prepare(hal::Library* library) {
   auto lib = Library::Downcast(library);
-  auto k = std::make_unique<cpu::Executable>(lib->engines(), lib->kernels(), thread_pool_);
+  auto k = std::make_unique<cpu::Executable>(lib->engines(), lib->kernels(), lib->symbols(), thread_pool_);
   return boost::make_ready_future(std::unique_ptr<hal::Executable>(std::move(k)));
 }
 
@@ -0,0 +1,140 @@
+// Copyright 2018 Intel Corporation.
+
+#include "tile/hal/cpu/grid.h"
+
+#include <algorithm>
+#include <atomic>
+#include <mutex>
+#include <utility>
+
+#include <boost/asio.hpp>
+
+namespace vertexai {
+namespace tile {
+namespace hal {
+namespace cpu {
+namespace {
+
+// Each time a worker takes work from its own share, it takes this fraction of
+// what remains. Large grids are thus consumed in a few large chunks, while the
+// tail of each share is left in small pieces which other workers can steal.
+constexpr std::size_t kChunkDivisor = 4;
+
+// A worker's share of the linearized grid: the owner takes chunks from the
+// front, thieves take from the back.
+struct Share {
+  std::mutex mu;
+  std::size_t begin = 0;
+  std::size_t end = 0;
+};
+
+struct GridState {
+  GridState(std::size_t workers, const lang::GridSize& gwork_, GridEntry entry_, std::vector<void*> args_)
+      : shares(workers), running{workers}, gwork(gwork_), entry{entry_}, args{std::move(args_)} {}
+
+  bool TakeLocal(std::size_t self, std::size_t* begin, std::size_t* end) {
+    Share& share = shares[self];
+    std::lock_guard<std::mutex> lock{share.mu};
+    std::size_t remaining = share.end - share.begin;
+    if (!remaining) {
+      return false;
+    }
+    std::size_t chunk = std::max<std::size_t>(1, remaining / kChunkDivisor);
+    *begin = share.begin;
+    *end = share.begin + chunk;
+    share.begin = *end;
+    return true;
+  }
+
+  bool Steal(std::size_t self) {
+    for (std::size_t offset = 1; offset < shares.size(); ++offset) {
+      Share& victim = shares[(self + offset) % shares.size()];
+      std::size_t begin;
+      std::size_t end;
+      {
+        std::lock_guard<std::mutex> lock{victim.mu};
+        std::size_t remaining = victim.end - victim.begin;
+        if (!remaining) {
+          continue;
+        }
+        end = victim.end;
+        begin = end - (remaining + 1) / 2;
+        victim.end = begin;
+      }
+      // Only the owner ever extends a share, and the owner's share is
+      // known to be empty here, so the stolen range simply replaces it.
+      Share& share = shares[self];
+      std::lock_guard<std::mutex> lock{share.mu};
+      share.begin = begin;
+      share.end = end;
+      return true;
+    }
+    return false;
+  }
+
+  void RunChunk(std::size_t begin, std::size_t end) {
+    // Compute the grid coordinates of the first work-group in the chunk, then
+    // step through the rest in row-major order.
+    lang::GridSize index;
+    index[2] = begin % gwork[2];
+    index[1] = begin / gwork[2] % gwork[1];
+    index[0] = begin / (gwork[2] * gwork[1]);
+    void* argvec = args.data();
+    for (std::size_t i = begin; i < end; ++i) {
+      entry(argvec, &index);
+      if (++index[2] == gwork[2]) {
+        index[2] = 0;
+        if (++index[1] == gwork[1]) {
+          index[1] = 0;
+          ++index[0];
+        }
+      }
+    }
+  }
+
+  void Work(std::size_t self) {
+    std::size_t begin;
+    std::size_t end;
+    do {
+      while (TakeLocal(self, &begin, &end)) {
+        RunChunk(begin, end);
+      }
+    } while (Steal(self));
+    if (--running == 0) {
+      done.set_value();
+    }
+  }
+
+  std::vector<Share> shares;
+  std::atomic<std::size_t> running;
+  lang::GridSize gwork;
+  GridEntry entry;
+  std::vector<void*> args;
+  boost::promise<void> done;
+};
+
+}  // namespace
+
+boost::future<void> RunGrid(const std::shared_ptr<boost::asio::thread_pool>& thread_pool, std::size_t workers,
+                            const lang::GridSize& gwork, GridEntry entry, std::vector<void*> args) {
+  std::size_t iterations = gwork[0] * gwork[1] * gwork[2];
+  workers = std::max<std::size_t>(1, std::min(iterations, workers));
+  if (!iterations) {
+    return boost::make_ready_future();
+  }
+  auto state = std::make_shared<GridState>(workers, gwork, entry, std::move(args));
+  for (std::size_t w = 0; w < workers; ++w) {
+    state->shares[w].begin = iterations * w / workers;
+    state->shares[w].end = iterations * (w + 1) / workers;
+  }
+  auto result = state->done.get_future();
+  for (std::size_t w = 0; w < workers; ++w) {
+    boost::asio::post(*thread_pool, [state, w]() { state->Work(w); });
+  }
+  return result;
+}
+
+}  // namespace cpu
+}  // namespace hal
+}  // namespace tile
+}  // namespace vertexai
@@ -0,0 +1,40 @@
+// Copyright 2018 Intel Corporation.
+
+#pragma once
+
+#include <memory>
+#include <vector>
+
+#include <boost/asio/thread_pool.hpp>
+#include <boost/thread/future.hpp>
+
+#include "tile/lang/generate.h"
+
+namespace vertexai {
+namespace tile {
+namespace hal {
+namespace cpu {
+
+// The signature of a compiled kernel invoker: the first argument is a pointer
+// to an array of buffer base addresses, the second is the work-group index.
+typedef void (*GridEntry)(void* argvec, lang::GridSize* index);
+
+// Runs the entrypoint once for every coordinate in the grid described by
+// gwork, spreading the work across up to `workers` tasks on the thread pool.
+//
+// The grid is linearized and handed out as contiguous chunks: each worker
+// starts with an equal share of the grid and carves progressively smaller
+// chunks from the front of its share, and a worker which runs out of work
+// steals the back half of some other worker's remaining share. This keeps all
+// workers busy when the cost of individual work-groups is uneven. Within a
+// chunk, the grid index is stepped incrementally rather than recomputed.
+//
+// No thread blocks waiting for completion: the returned future is satisfied by
+// whichever worker finishes last.
+boost::future<void> RunGrid(const std::shared_ptr<boost::asio::thread_pool>& thread_pool, std::size_t workers,
+                            const lang::GridSize& gwork, GridEntry entry, std::vector<void*> args);
+
+}  // namespace cpu
+}  // namespace hal
+}  // namespace tile
+}  // namespace vertexai
@@ -0,0 +1,112 @@
+// Copyright 2018 Intel Corporation.
+
+// Compares the work-stealing grid dispatcher against the strided dispatch
+// loop it replaced, using synthetic kernels with uniform and skewed costs.
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include <boost/asio.hpp>
+#include <boost/thread/thread.hpp>
+
+#include "tile/hal/cpu/grid.h"
+
+namespace vertexai {
+namespace tile {
+namespace hal {
+namespace cpu {
+namespace {
+
+struct Workload {
+  lang::GridSize gwork;
+  // Work-groups whose linear index is below `heavy` spin for `skew` times longer.
+  std::size_t heavy;
+  std::size_t skew;
+};
+
+volatile std::size_t sink;
+
+void Spin(void* argvec, lang::GridSize* index) {
+  auto wl = static_cast<const Workload*>(static_cast<void**>(argvec)[0]);
+  std::size_t linear = ((*index)[0] * wl->gwork[1] + (*index)[1]) * wl->gwork[2] + (*index)[2];
+  std::size_t spins = 1000 * (linear < wl->heavy ? wl->skew : 1);
+  std::size_t acc = linear;
+  for (std::size_t i = 0; i < spins; ++i) {
+    acc = acc * 6364136223846793005ull + 1442695040888963407ull;
+  }
+  sink = acc;
+}
+
+// The dispatch loop previously used by Executable::Run: one task per core,
+// each striding through the grid and recomputing the index for every
+// work-group, with the caller blocked until all tasks complete.
+void RunStrided(boost::asio::thread_pool* pool, std::size_t cores, const lang::GridSize& gwork, GridEntry entry,
+                void* argvec) {
+  size_t iterations = gwork[0] * gwork[1] * gwork[2];
+  lang::GridSize denom = {{gwork[2] * gwork[1], gwork[2], 1}};
+  size_t threads = std::min(iterations, cores);
+  std::mutex mutex;
+  std::condition_variable cv;
+  size_t completed = 0;
+  for (size_t offset = 0; offset < threads; ++offset) {
+    boost::asio::post(*pool, [=, &mutex, &cv, &completed]() {
+      for (size_t i = offset; i < iterations; i += threads) {
+        lang::GridSize index;
+        index[0] = i / denom[0] % gwork[0];
+        index[1] = i / denom[1] % gwork[1];
+        index[2] = i / denom[2] % gwork[2];
+        entry(argvec, &index);
+      }
+      std::unique_lock<std::mutex> lock{mutex};
+      if (++completed == threads) {
+        cv.notify_all();
+      }
+    });
+  }
+  std::unique_lock<std::mutex> lock{mutex};
+  cv.wait(lock, [&]() { return threads <= completed; });
+}
+
+template <typename F>
+double TimeMs(std::size_t reps, F f) {
+  auto start = std::chrono::steady_clock::now();
+  for (std::size_t r = 0; r < reps; ++r) {
+    f();
+  }
+  std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+  return elapsed.count() / reps;
+}
+
+void Bench(const char* name, const Workload& wl, std::size_t cores, std::size_t reps) {
+  auto pool = std::make_shared<boost::asio::thread_pool>(cores);
+  std::vector<void*> args{const_cast<Workload*>(&wl)};
+  double strided = TimeMs(reps, [&]() { RunStrided(pool.get(), cores, wl.gwork, Spin, args.data()); });
+  double stealing = TimeMs(reps, [&]() { RunGrid(pool, cores, wl.gwork, Spin, args).get(); });
+  std::printf("%-24s strided %9.3f ms   work-stealing %9.3f ms   speedup %.2fx\n", name, strided, stealing,
+              strided / stealing);
+}
+
+}  // namespace
+}  // namespace cpu
+}  // namespace hal
+}  // namespace tile
+}  // namespace vertexai
+
+int main(int argc, char** argv) {
+  using vertexai::tile::hal::cpu::Bench;
+  using vertexai::tile::hal::cpu::Workload;
+  std::size_t cores = boost::thread::physical_concurrency();
+  std::size_t reps = argc > 1 ? std::stoul(argv[1]) : 20;
+  std::printf("cores: %zu  repetitions: %zu\n", cores, reps);
+  Bench("uniform 64x64x4", Workload{{{64, 64, 4}}, 0, 1}, cores, reps);
+  Bench("tiny 4x1x1", Workload{{{4, 1, 1}}, 0, 1}, cores, reps);
+  Bench("skewed head 1/8 x16", Workload{{{64, 64, 4}}, 64 * 64 * 4 / 8, 16}, cores, reps);
+  Bench("skewed head 1/64 x64", Workload{{{256, 16, 1}}, 256 * 16 / 64, 64}, cores, reps);
+  return 0;
+}
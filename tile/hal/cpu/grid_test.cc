@@ -0,0 +1,56 @@
+// Copyright 2018 Intel Corporation.
+
+#include <gmock/gmock.h>
+
+#include <atomic>
+#include <memory>
+#include <vector>
+
+#include "tile/hal/cpu/grid.h"
+
+using ::testing::Each;
+using ::testing::Eq;
+
+namespace vertexai {
+namespace tile {
+namespace hal {
+namespace cpu {
+namespace {
+
+struct Visits {
+  lang::GridSize gwork;
+  std::vector<std::atomic<int>> counts;
+
+  explicit Visits(const lang::GridSize& gwork_) : gwork(gwork_), counts(gwork[0] * gwork[1] * gwork[2]) {}
+};
+
+void Visit(void* argvec, lang::GridSize* index) {
+  auto visits = static_cast<Visits*>(static_cast<void**>(argvec)[0]);
+  const auto& g = visits->gwork;
+  ASSERT_LT((*index)[0], g[0]);
+  ASSERT_LT((*index)[1], g[1]);
+  ASSERT_LT((*index)[2], g[2]);
+  visits->counts[((*index)[0] * g[1] + (*index)[1]) * g[2] + (*index)[2]]++;
+}
+
+std::vector<int> RunVisits(const lang::GridSize& gwork, std::size_t workers) {
+  auto pool = std::make_shared<boost::asio::thread_pool>(4);
+  Visits visits{gwork};
+  RunGrid(pool, workers, gwork, Visit, {&visits}).get();
+  return std::vector<int>(visits.counts.begin(), visits.counts.end());
+}
+
+TEST(CpuGrid, VisitsEachIndexOnce) {
+  EXPECT_THAT(RunVisits({{7, 5, 3}}, 4), Each(Eq(1)));
+  EXPECT_THAT(RunVisits({{1, 1, 1000}}, 4), Each(Eq(1)));
+  EXPECT_THAT(RunVisits({{3, 1, 1}}, 8), Each(Eq(1)));
+  EXPECT_THAT(RunVisits({{13, 11, 1}}, 1), Each(Eq(1)));
+}
+
+TEST(CpuGrid, EmptyGrid) { EXPECT_TRUE(RunVisits({{0, 4, 4}}, 4).empty()); }
+
+}  // namespace
+}  // namespace cpu
+}  // namespace hal
+}  // namespace tile
+}  // namespace vertexai
@@ -0,0 +1,127 @@
+// Copyright 2018 Intel Corporation.
+
+#include "tile/hal/cpu/kernel_cache.h"
+
+#include <llvm/Config/llvm-config.h>
+
+#include <iterator>
+#include <memory>
+#include <stdexcept>
+
+#include <boost/filesystem/fstream.hpp>
+
+#include "base/util/env.h"
+#include "base/util/fingerprint.h"
+#include "base/util/logging.h"
+#include "tile/hal/cpu/target.h"
+#include "tile/lang/semprinter.h"
+
+namespace fs = boost::filesystem;
+
+namespace vertexai {
+namespace tile {
+namespace hal {
+namespace cpu {
+namespace {
+
+// Identifies the layout of cached objects and of the key itself; bump it to
+// invalidate existing entries whenever either changes.
+const char kFormatVersion[] = "cpu-kernel-cache-v3";
+
+// The name a kernel is hashed under, in place of its own.
+const char kKeyedKernelName[] = "kernel";
+
+// Describes the code generation target: everything besides the kernel itself
+// that determines the object code LLVM produces.
+std::string TargetDescription() {
+  const HostTarget& host = GetHostTarget();
+  std::string desc = "llvm-" LLVM_VERSION_STRING ";";
+  desc += host.cpu;
+  for (const auto& feature : host.features) {
+    desc += ";" + feature;
+  }
+  return desc;
+}
+
+std::string Hex(const std::string& bytes) {
+  std::string result;
+  for (unsigned char c : bytes) {
+    result += "0123456789abcdef"[c >> 4];
+    result += "0123456789abcdef"[c & 0xf];
+  }
+  return result;
+}
+
+}  // namespace
+
+KernelCache* KernelCache::Instance() {
+  static std::unique_ptr<KernelCache> instance = []() -> std::unique_ptr<KernelCache> {
+    auto env_cache = env::Get("PLAIDML_CPU_CACHE");
+    if (!env_cache.length()) {
+      return nullptr;
+    }
+    VLOG(1) << "Using CPU kernel cache directory: " << env_cache;
+    return std::make_unique<KernelCache>(env_cache);
+  }();
+  return instance.get();
+}
+
+KernelCache::KernelCache(const fs::path& dir) : dir_{dir} { fs::create_directories(dir_); }
+
+std::string KernelCache::Key(const lang::KernelInfo& ki, bool fuse_fp_ops) {
+  static const std::string target = TargetDescription();
+  Fingerprinter fp;
+  fp.Update(kFormatVersion);
+  fp.Update(target);
+  fp.Update(fuse_fp_ops ? "fuse-fp-ops" : "no-fuse-fp-ops");
+  // Work-groups are compiled as loops over their work items, so the object
+  // code depends on the local size.  The global size only affects how many
+  // groups are dispatched, which isn't compiled in.
+  for (auto size : ki.lwork) {
+    fp.Update(static_cast<std::uint64_t>(size));
+  }
+  sem::Function kfunc = *ki.kfunc;
+  kfunc.name = kKeyedKernelName;
+  fp.Update(sem::Print(kfunc).str());
+  return Hex(fp.Digest());
+}
+
+std::string KernelCache::Symbol(const std::string& key) { return "tile_kernel_" + key; }
+
+bool KernelCache::Load(const std::string& key, std::string* object) {
+  fs::path path = (dir_ / key).replace_extension("o");
+  fs::ifstream ifs{path, std::ios::binary};
+  if (!ifs) {
+    return false;
+  }
+  object->assign(std::istreambuf_iterator<char>(ifs), std::istreambuf_iterator<char>());
+  if (ifs.bad()) {
+    LOG(WARNING) << "Unable to read cached kernel " << path;
+    return false;
+  }
+  return true;
+}
+
+void KernelCache::Store(const std::string& key, const std::string& object) {
+  fs::path path = (dir_ / key).replace_extension("o");
+  fs::path tmp = dir_ / fs::unique_path(key + ".%%%%-%%%%.tmp");
+  try {
+    {
+      fs::ofstream ofs{tmp, std::ios::binary | std::ios::trunc};
+      ofs.write(object.data(), object.size());
+      if (!ofs) {
+        throw std::runtime_error("Unable to write " + tmp.string());
+      }
+    }
+    fs::rename(tmp, path);
+  } catch (const std::exception& ex) {
+    LOG(WARNING) << "Unable to cache compiled kernel: " << ex.what();
+    boost::system::error_code ec;
+    fs::remove(tmp, ec);
+  }
+}
+
+}  // namespace cpu
+}  // namespace hal
+}  // namespace tile
+}  // namespace vertexai
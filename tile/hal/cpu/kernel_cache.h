@@ -0,0 +1,53 @@
+// Copyright 2018 Intel Corporation.
+
+#pragma once
+
+#include <string>
+
+#include <boost/filesystem.hpp>
+
+#include "tile/lang/generate.h"
+
+namespace vertexai {
+namespace tile {
+namespace hal {
+namespace cpu {
+
+// KernelCache is a content-addressed on-disk cache of compiled kernel object
+// code, holding one object per kernel.  Entries are keyed by a hash of the
+// kernel's source, the LLVM version, the host CPU and its features, and the
+// code generation options, so a cached object is only reused where it would
+// have been generated identically.  Kernel names come from a process-local
+// counter, so they're left out of the key: a cached kernel is compiled under
+// a symbol derived from its key instead, and callers find it by that symbol.
+class KernelCache {
+ public:
+  // Returns the process-wide cache in the PLAIDML_CPU_CACHE directory, or
+  // nullptr if that variable isn't set.
+  static KernelCache* Instance();
+
+  explicit KernelCache(const boost::filesystem::path& dir);
+
+  // Computes the cache key for a kernel, with or without floating point
+  // operation fusion.  Identical kernels have the same key whatever their
+  // names, in any program and any process.
+  static std::string Key(const lang::KernelInfo& ki, bool fuse_fp_ops);
+
+  // Returns the name under which the kernel with the given key is compiled.
+  static std::string Symbol(const std::string& key);
+
+  // Reads the object code stored under the key, returning false if absent.
+  bool Load(const std::string& key, std::string* object);
+
+  // Stores object code under the key.  Writes are atomic: concurrent readers
+  // (including other processes) see either the whole object or none of it.
+  void Store(const std::string& key, const std::string& object);
+
+ private:
+  boost::filesystem::path dir_;
+};
+
+}  // namespace cpu
+}  // namespace hal
+}  // namespace tile
+}  // namespace vertexai
@@ -3,6 +3,8 @@
 #include "tile/hal/cpu/library.h"
 
 #include <llvm/ExecutionEngine/ExecutionEngine.h>
+
+#include <cstring>
 #include <utility>
 
 #include "base/util/error.h"
@@ -18,8 +20,80 @@ Library* Library::Downcast(hal::Library* library) {
 }
 
 Library::Library(const std::vector<std::shared_ptr<llvm::ExecutionEngine>>& engines,
-                 const std::vector<lang::KernelInfo>& kernels)
-    : engines_{engines}, kernels_{kernels} {}
+                 const std::vector<lang::KernelInfo>& kernels, std::vector<CompiledModule> modules)
+    : engines_{engines}, kernels_{kernels}, modules_{std::move(modules)} {
+  for (const auto& module : modules_) {
+    symbols_.insert(symbols_.end(), module.symbols.begin(), module.symbols.end());
+  }
+}
+
+std::string Library::Serialize() {
+  if (symbols_.size() != kernels_.size()) {
+    return "";
+  }
+  for (const auto& module : modules_) {
+    if (module.objects.empty()) {
+      return "";
+    }
+  }
+  // The serialized form is the module count, followed by each module's
+  // symbols and objects, each list as a count followed by its strings, and
+  // each string as a size followed by its contents, in host byte order.
+  std::string result;
+  auto append_size = [&result](uint64_t size) { result.append(reinterpret_cast<const char*>(&size), sizeof(size)); };
+  auto append_strings = [&](const std::vector<std::string>& strings) {
+    append_size(strings.size());
+    for (const auto& str : strings) {
+      append_size(str.size());
+      result.append(str);
+    }
+  };
+  append_size(modules_.size());
+  for (const auto& module : modules_) {
+    append_strings(module.symbols);
+    append_strings(module.objects);
+  }
+  return result;
+}
+
+std::vector<CompiledModule> Library::Unpack(const std::string& serialized) {
+  std::vector<CompiledModule> modules;
+  std::size_t pos = 0;
+  auto read_size = [&]() {
+    uint64_t size;
+    if (serialized.size() - pos < sizeof(size)) {
+      throw error::InvalidArgument{"Truncated CPU library"};
+    }
+    std::memcpy(&size, serialized.data() + pos, sizeof(size));
+    pos += sizeof(size);
+    return size;
+  };
+  auto read_strings = [&]() {
+    uint64_t count = read_size();
+    // Each string takes at least its size.
+    if ((serialized.size() - pos) / sizeof(uint64_t) < count) {
+      throw error::InvalidArgument{"Truncated CPU library"};
+    }
+    std::vector<std::string> strings(count);
+    for (auto& str : strings) {
+      uint64_t size = read_size();
+      if (serialized.size() - pos < size) {
+        throw error::InvalidArgument{"Truncated CPU library"};
+      }
+      str = serialized.substr(pos, size);
+      pos += size;
+    }
+    return strings;
+  };
+  uint64_t count = read_size();
+  for (uint64_t i = 0; i < count; ++i) {
+    CompiledModule module;
+    module.symbols = read_strings();
+    module.objects = read_strings();
+    modules.emplace_back(std::move(module));
+  }
+  return modules;
+}
 
 }  // namespace cpu
 }  // namespace hal
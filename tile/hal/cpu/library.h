@@ -18,21 +18,48 @@ namespace tile {
 namespace hal {
 namespace cpu {
 
+// The object code for a contiguous run of a library's kernels, which are
+// loaded together into a single execution engine.
+struct CompiledModule {
+  // The invoker symbol of each of the module's kernels, in order.
+  std::vector<std::string> symbols;
+  // The object files holding the kernels' code.  These are kept only if the
+  // library was compiled with a kernel cache or loaded from a serialized
+  // library; otherwise the code exists only within the execution engine.
+  std::vector<std::string> objects;
+  // The size of the kernels' object code, whether or not it's kept.
+  std::size_t object_bytes = 0;
+};
+
 class Library final : public hal::Library {
  public:
   static Library* Downcast(hal::Library* library);
 
+  // engines holds the execution engine containing each kernel; kernels
+  // compiled in the same module share an engine.
   Library(const std::vector<std::shared_ptr<llvm::ExecutionEngine>>& engines,
-          const std::vector<lang::KernelInfo>& kernels);
+          const std::vector<lang::KernelInfo>& kernels, std::vector<CompiledModule> modules = {});
 
-  std::string Serialize() final { return ""; }
+  // Serializes the modules' object code, which cpu::Loader can load without
+  // recompiling.  Returns an empty string if any module's object code is
+  // unavailable, as it is unless the library was compiled with a kernel cache.
+  std::string Serialize() final;
+
+  // Splits a serialized library back into its modules.
+  static std::vector<CompiledModule> Unpack(const std::string& serialized);
 
   const std::vector<std::shared_ptr<llvm::ExecutionEngine>>& engines() { return engines_; }
   const std::vector<lang::KernelInfo>& kernels() { return kernels_; }
+  const std::vector<CompiledModule>& modules() { return modules_; }
+
+  // The symbol of each kernel's invoker within its engine.
+  const std::vector<std::string>& symbols() { return symbols_; }
 
  private:
   std::vector<std::shared_ptr<llvm::ExecutionEngine>> engines_;
   std::vector<lang::KernelInfo> kernels_;
+  std::vector<CompiledModule> modules_;
+  std::vector<std::string> symbols_;
 };
 
 }  // namespace cpu
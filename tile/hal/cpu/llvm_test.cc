@@ -4,10 +4,22 @@
 #include <llvm/ExecutionEngine/ExecutionEngine.h>
 #include <llvm/ExecutionEngine/MCJIT.h>
 
+#include <algorithm>
+#include <set>
+#include <string>
+#include <vector>
+
+#include <boost/filesystem.hpp>
 #include <half.hpp>
 
+#include "base/util/perf_counter.h"
+#include "tile/hal/cpu/compiler.h"
 #include "tile/hal/cpu/emitllvm.h"
+#include "tile/hal/cpu/kernel_cache.h"
+#include "tile/hal/cpu/library.h"
 #include "tile/hal/cpu/runtime.h"
+#include "tile/lang/generate.h"
+#include "tile/lang/parser.h"
 #include "tile/lang/sembuilder.h"
 #include "tile/lang/semtree.h"
 
@@ -34,8 +46,9 @@ static const sem::Type fp64Type{sem::Type::VALUE, DataType::FLOAT64};
 static const sem::Type ptrInt32Type{sem::Type::POINTER_MUT, DataType::INT32};
 static const sem::Type ptrFP32Type{sem::Type::POINTER_MUT, DataType::FLOAT32};
 
-static llvm::ExecutionEngine* JIT(const sem::Node& n) {
+static llvm::ExecutionEngine* JIT(const sem::Node& n, const lang::GridSize& lwork = {{1, 1, 1}}) {
   tile::hal::cpu::Emit emit;
+  emit.set_local_size(lwork);
   n.Accept(emit);
   std::string errStr;
   std::unique_ptr<llvm::RuntimeDyld::SymbolResolver> rez(new tile::hal::cpu::Runtime);
@@ -408,6 +421,156 @@ TEST(CpuDevice, LLVM_vec_add_loop) {
   }
 }
 
+TEST(CpuDevice, LLVM_workgroup_barrier) {
+  using namespace sem::builder;  // NOLINT
+  sem::Type sharedType{sem::Type::VALUE, DataType::INT32, 1, 4, sem::Type::LOCAL};
+  auto tid = _("tid");
+  auto f = _Function("reverse", voidType, {{ptrInt32Type, "out"}, {ptrInt32Type, "in"}},
+                     {
+                         _Declare(idxType, "tid", _Index(sem::IndexExpr::LOCAL, 0)),
+                         _Declare(sharedType, "shared", nullptr),
+                         _("shared")[tid] = _("in")[_Index(sem::IndexExpr::GLOBAL, 0)],
+                         _Barrier(),
+                         _("out")[_Index(sem::IndexExpr::GLOBAL, 0)] = _("shared")[_Const(3) - tid],
+                     });
+  auto engine = JIT(*f, {{4, 1, 1}});
+  EXPECT_THAT(engine, NotNull());
+  auto kernel = (void (*)(int32_t*, int32_t*, lang::GridSize*))engine->getFunctionAddress("reverse");
+  EXPECT_THAT(kernel, NotNull());
+  std::vector<int32_t> in{0, 1, 2, 3, 4, 5, 6, 7};
+  std::vector<int32_t> out(8, -1);
+  lang::GridSize group{{1, 0, 0}};
+  kernel(out.data(), in.data(), &group);
+  EXPECT_THAT(out, Eq(std::vector<int32_t>{-1, -1, -1, -1, 7, 6, 5, 4}));
+}
+
+// Settings for generating kernels to run on the host in these tests.
+static lang::HardwareSettings HostSettings() {
+  lang::HardwareSettings settings;
+  settings.threads = 4;
+  settings.vec_size = 1;
+  settings.use_global = false;
+  settings.mem_width = 32;
+  settings.max_mem = 18 * 1024;
+  settings.max_regs = 18 * 1024;
+  settings.goal_groups = 4;
+  settings.goal_flops_per_byte = 20;
+  settings.goal_dimension_sizes = {1024, 1024, 1024};
+  return settings;
+}
+
+// JITs a generated three-parameter kernel and runs each of its work-groups.
+static void RunKernel(const lang::KernelInfo& ki, void* p0, void* p1, void* p2) {
+  auto engine = JIT(*ki.kfunc, ki.lwork);
+  ASSERT_THAT(engine, NotNull());
+  auto kernel = (void (*)(void*, void*, void*, lang::GridSize*))engine->getFunctionAddress(ki.kname);
+  ASSERT_THAT(kernel, NotNull());
+  lang::GridSize groups;
+  for (std::size_t i = 0; i < groups.size(); ++i) {
+    std::size_t lwork = std::max<std::size_t>(1, ki.lwork[i]);
+    groups[i] = (ki.gwork[i] + lwork - 1) / lwork;
+  }
+  lang::GridSize group;
+  for (group[2] = 0; group[2] < groups[2]; ++group[2]) {
+    for (group[1] = 0; group[1] < groups[1]; ++group[1]) {
+      for (group[0] = 0; group[0] < groups[0]; ++group[0]) {
+        kernel(p0, p1, p2, &group);
+      }
+    }
+  }
+}
+
+TEST(CpuDevice, LLVM_contraction_initializes_padding) {
+  lang::Parser parser;
+  auto prog = parser.Parse(
+      "function (B[X, Y], C[Y, Z]) -> (A) { "
+      "  A[x + 1, z + 1 : X + 2, Z + 2] = +(B[x, y] * C[y, z]); "
+      "}");
+  lang::ShapeMap inputs;
+  inputs.emplace("B", SimpleShape(DataType::FLOAT32, {3, 2}));
+  inputs.emplace("C", SimpleShape(DataType::FLOAT32, {2, 3}));
+  lang::ShapeMap outputs;
+  outputs.emplace("A", SimpleShape(DataType::FLOAT32, {5, 5}));
+  lang::TileOptimizer optimizer;
+  auto klist = lang::GenerateProgram(prog, inputs, outputs, HostSettings(), optimizer, "ID");
+  ASSERT_THAT(klist.kernels.size(), Eq(1));  // No separate zeroing kernel
+
+  std::vector<float> b{1, 2, 3, 4, 5, 6};
+  std::vector<float> c{1, 2, 3, 4, 5, 6};
+  std::vector<float> a(25, -1000);  // Sentinel; every element must be written
+  RunKernel(klist.kernels[0], a.data(), b.data(), c.data());
+  for (std::size_t i = 0; i < 5; ++i) {
+    for (std::size_t j = 0; j < 5; ++j) {
+      float expected = 0;
+      if (1 <= i && i <= 3 && 1 <= j && j <= 3) {
+        for (std::size_t k = 0; k < 2; ++k) {
+          expected += b[(i - 1) * 2 + k] * c[k * 3 + (j - 1)];
+        }
+      }
+      EXPECT_THAT(a[i * 5 + j], Eq(expected)) << "at " << i << ", " << j;
+    }
+  }
+}
+
+TEST(CpuDevice, LLVM_scatter_zeroes_output) {
+  lang::Parser parser;
+  auto prog = parser.Parse("function (E[N, C], I[N], V[M, C]) -> (O) { O = scatter(E, I, V); }");
+  lang::ShapeMap inputs;
+  inputs.emplace("E", SimpleShape(DataType::FLOAT32, {3, 2}));
+  inputs.emplace("I", SimpleShape(DataType::INT32, {3}));
+  inputs.emplace("V", SimpleShape(DataType::FLOAT32, {4, 2}));
+  lang::ShapeMap outputs;
+  outputs.emplace("O", SimpleShape(DataType::FLOAT32, {4, 2}));
+  lang::TileOptimizer optimizer;
+  auto klist = lang::GenerateProgram(prog, inputs, outputs, HostSettings(), optimizer, "ID");
+  ASSERT_THAT(klist.kernels.size(), Eq(1));  // No separate zeroing kernel
+
+  std::vector<float> e{1, 2, 3, 4, 5, 6};
+  std::vector<int32_t> idx{2, 0, 2};
+  std::vector<float> o(8, -1000);  // Sentinel; every element must be written
+  RunKernel(klist.kernels[0], o.data(), e.data(), idx.data());
+  EXPECT_THAT(o, Eq(std::vector<float>{3, 4, 0, 0, 6, 8, 0, 0}));
+}
+
+TEST(CpuDevice, KernelCacheIgnoresProgramId) {
+  lang::Parser parser;
+  auto prog = parser.Parse("function (B[X, Y], C[Y, Z]) -> (A) { A[x, z : X, Z] = +(B[x, y] * C[y, z]); }");
+  lang::ShapeMap inputs;
+  inputs.emplace("B", SimpleShape(DataType::FLOAT32, {3, 2}));
+  inputs.emplace("C", SimpleShape(DataType::FLOAT32, {2, 3}));
+  lang::ShapeMap outputs;
+  outputs.emplace("A", SimpleShape(DataType::FLOAT32, {3, 3}));
+  lang::TileOptimizer optimizer;
+  auto first = lang::GenerateProgram(prog, inputs, outputs, HostSettings(), optimizer, "first");
+  auto second = lang::GenerateProgram(prog, inputs, outputs, HostSettings(), optimizer, "second");
+  ASSERT_THAT(second.kernels.size(), Eq(first.kernels.size()));
+  EXPECT_THAT(second.kernels[0].kname, Ne(first.kernels[0].kname));
+
+  auto dir = boost::filesystem::temp_directory_path() / boost::filesystem::unique_path("cpu-kernel-cache-%%%%-%%%%");
+  hal::cpu::KernelCache cache{dir};
+  hal::cpu::Compiler compiler{0, &cache};
+  context::Context ctx;
+  hal::proto::HardwareSettings settings;
+  compiler.Build(ctx, first.kernels, settings).get();
+
+  std::set<std::string> keys;
+  for (const auto& ki : second.kernels) {
+    keys.insert(hal::cpu::KernelCache::Key(ki, !settings.disable_mad()));
+  }
+  auto hits = GetPerfCounter("cpu_kernel_cache_hits");
+  auto lib = compiler.Build(ctx, second.kernels, settings).get();
+  EXPECT_THAT(GetPerfCounter("cpu_kernel_cache_hits") - hits, Eq(static_cast<int64_t>(keys.size())));
+
+  // The cached kernels are found under their own symbols, not the names the
+  // second program gave them.
+  auto cpu_lib = hal::cpu::Library::Downcast(lib.get());
+  ASSERT_THAT(cpu_lib->symbols().size(), Eq(second.kernels.size()));
+  for (std::size_t kidx = 0; kidx < second.kernels.size(); ++kidx) {
+    EXPECT_THAT(cpu_lib->engines()[kidx]->getFunctionAddress(cpu_lib->symbols()[kidx]), Ne(0u));
+  }
+  boost::filesystem::remove_all(dir);
+}
+
 }  // namespace
 }  // namespace testing
 }  // namespace tile
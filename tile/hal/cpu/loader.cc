@@ -0,0 +1,81 @@
+// Copyright 2018 Intel Corporation.
+
+#include "tile/hal/cpu/loader.h"
+
+#include <llvm/ExecutionEngine/ExecutionEngine.h>
+#include <llvm/ExecutionEngine/MCJIT.h>
+#include <llvm/Object/ObjectFile.h>
+#include <llvm/Support/MemoryBuffer.h>
+
+#include <utility>
+
+#include "base/util/error.h"
+#include "tile/base/parallel_for.h"
+#include "tile/hal/cpu/library.h"
+#include "tile/hal/cpu/runtime.h"
+
+namespace vertexai {
+namespace tile {
+namespace hal {
+namespace cpu {
+
+boost::future<std::unique_ptr<hal::Library>> Loader::Deserialize(const context::Context& ctx,
+                                                                 const std::string& serialized_executable,
+                                                                 const std::vector<lang::KernelInfo>& info) {
+  context::Activity activity{ctx, "tile::hal::cpu::Deserialize"};
+  auto modules = Library::Unpack(serialized_executable);
+  std::size_t kernel_count = 0;
+  for (const auto& module : modules) {
+    kernel_count += module.symbols.size();
+  }
+  if (kernel_count != info.size()) {
+    throw error::InvalidArgument{"Serialized CPU library does not match the supplied kernels"};
+  }
+  InitializeNativeTarget();
+  std::vector<std::shared_ptr<llvm::ExecutionEngine>> module_engines(modules.size());
+  ParallelFor(modules.size(), 0,
+              [&](std::size_t idx) { module_engines[idx] = LoadKernelObjects(modules[idx].objects); });
+  std::vector<std::shared_ptr<llvm::ExecutionEngine>> engines;
+  for (std::size_t idx = 0; idx < modules.size(); ++idx) {
+    engines.insert(engines.end(), modules[idx].symbols.size(), module_engines[idx]);
+  }
+  std::unique_ptr<hal::Library> lib{new Library(engines, info, std::move(modules))};
+  return boost::make_ready_future(std::move(lib));
+}
+
+std::shared_ptr<llvm::ExecutionEngine> LoadKernelObjects(const std::vector<std::string>& objects) {
+  // MCJIT requires a module to build an engine around; the kernels
+  // themselves arrive as object files, so the module stays empty.
+  std::string errStr;
+  std::unique_ptr<llvm::RuntimeDyld::SymbolResolver> rez(new Runtime);
+  auto context = std::make_shared<llvm::LLVMContext>();
+  std::unique_ptr<llvm::Module> module{new llvm::Module("tile-object", *context)};
+  llvm::ExecutionEngine* engine = llvm::EngineBuilder(std::move(module))
+                                      .setErrorStr(&errStr)
+                                      .setEngineKind(llvm::EngineKind::JIT)
+                                      .setSymbolResolver(std::move(rez))
+                                      .create();
+  if (!engine) {
+    throw error::Internal{"Failed to create ExecutionEngine: " + errStr};
+  }
+  auto ee = ShareEngine(engine, std::move(context));
+  for (const auto& object : objects) {
+    AddKernelObject(ee.get(), object);
+  }
+  ee->finalizeObject();
+  return ee;
+}
+
+void AddKernelObject(llvm::ExecutionEngine* engine, const std::string& object) {
+  auto buffer = llvm::MemoryBuffer::getMemBufferCopy(object, "tile-kernel");
+  auto obj = llvm::object::ObjectFile::createObjectFile(buffer->getMemBufferRef());
+  if (!obj) {
+    throw error::Internal{"Unable to load CPU kernel object: " + obj.getError().message()};
+  }
+  engine->addObjectFile(llvm::object::OwningBinary<llvm::object::ObjectFile>{std::move(obj.get()), std::move(buffer)});
+}
+
+}  // namespace cpu
+}  // namespace hal
+}  // namespace tile
+}  // namespace vertexai
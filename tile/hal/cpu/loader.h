@@ -0,0 +1,40 @@
+// Copyright 2018 Intel Corporation.
+
+#pragma once
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "tile/base/hal.h"
+
+namespace llvm {
+class ExecutionEngine;
+}  // namespace llvm
+
+namespace vertexai {
+namespace tile {
+namespace hal {
+namespace cpu {
+
+// Loads libraries serialized by cpu::Library::Serialize.
+class Loader final : public hal::Loader {
+ public:
+  boost::future<std::unique_ptr<hal::Library>> Deserialize(const context::Context& ctx,
+                                                           const std::string& serialized_executable,
+                                                           const std::vector<lang::KernelInfo>& info) final;
+};
+
+// Creates an execution engine from the previously compiled object code of a
+// module of kernels, without running any of LLVM's optimization or code
+// generation.
+std::shared_ptr<llvm::ExecutionEngine> LoadKernelObjects(const std::vector<std::string>& objects);
+
+// Adds previously compiled object code to an execution engine, which must
+// then be finalized.
+void AddKernelObject(llvm::ExecutionEngine* engine, const std::string& object);
+
+}  // namespace cpu
+}  // namespace hal
+}  // namespace tile
+}  // namespace vertexai
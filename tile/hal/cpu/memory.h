@@ -8,6 +8,7 @@
 #include <ratio>
 
 #include "tile/base/hal.h"
+#include "tile/hal/cpu/arena.h"
 
 namespace vertexai {
 namespace tile {
@@ -23,7 +24,7 @@ class Memory final : public hal::Memory {
     return 16 * std::giga::num;
   }
   BufferAccessMask AllowedAccesses() const final { return BufferAccessMask::ALL; }
-  std::size_t ArenaBufferAlignment() const final { return alignof(long double); /* TODO: Use std::max_align_t */ }
+  std::size_t ArenaBufferAlignment() const final { return kBufferAlignment; }
 
   std::shared_ptr<hal::Buffer> MakeBuffer(std::uint64_t size, BufferAccessMask access) final;
   std::shared_ptr<hal::Arena> MakeArena(std::uint64_t size, BufferAccessMask access) final;
@@ -2,7 +2,12 @@
 
 #include "tile/hal/cpu/runtime.h"
 
+#include <map>
+#include <string>
+
+#include <llvm/ExecutionEngine/MCJIT.h>
 #include <llvm/Support/DynamicLibrary.h>
+#include <llvm/Support/TargetSelect.h>
 
 #include <half.hpp>
 
@@ -29,7 +34,9 @@ SymbolInfo symInfo(T ptr) {
 }
 
 SymbolInfo Runtime::findSymbol(const std::string& name) {
-  static std::map<std::string, SymbolInfo> symbols{
+  // Kernels are finalized concurrently, so the table is never modified; symbols
+  // found through DynamicLibrary (which synchronizes itself) aren't cached.
+  static const std::map<std::string, SymbolInfo> symbols{
       {"Barrier", symInfo(rt::barrier)},   {"__gnu_h2f_ieee", symInfo(rt::h2f)}, {"__gnu_f2h_ieee", symInfo(rt::f2h)},
       {"___truncsfhf2", symInfo(rt::f2h)}, {"___extendhfsf2", symInfo(rt::h2f)},
   };
@@ -46,9 +53,7 @@ SymbolInfo Runtime::findSymbol(const std::string& name) {
     ptr = llvm::sys::DynamicLibrary::SearchForAddressOfSymbol(name.substr(1));
   }
   if (ptr) {
-    auto info = symInfo(ptr);
-    symbols.emplace(name, info);
-    return info;
+    return symInfo(ptr);
   }
   std::string msg("cpu runtime failed to resolve external symbol reference: \"" + name + "\"");
   VLOG(1) << msg;
@@ -57,6 +62,23 @@ SymbolInfo Runtime::findSymbol(const std::string& name) {
 
 SymbolInfo Runtime::findSymbolInLogicalDylib(const std::string& name) { return SymbolInfo(nullptr); }
 
+void InitializeNativeTarget() {
+  static std::once_flag init_once;
+  std::call_once(init_once, []() {
+    LLVMInitializeNativeTarget();
+    LLVMLinkInMCJIT();
+    LLVMInitializeNativeAsmPrinter();
+    LLVMInitializeNativeAsmParser();
+  });
+}
+
+std::shared_ptr<llvm::ExecutionEngine> ShareEngine(llvm::ExecutionEngine* engine,
+                                                   std::shared_ptr<llvm::LLVMContext> context) {
+  // The deleter destroys the engine (and with it, its modules) before
+  // releasing its reference to the context.
+  return std::shared_ptr<llvm::ExecutionEngine>{engine, [context](llvm::ExecutionEngine* ee) { delete ee; }};
+}
+
 }  // namespace cpu
 }  // namespace hal
 }  // namespace tile
@@ -3,6 +3,8 @@
 #pragma once
 
 #include <llvm/ExecutionEngine/ExecutionEngine.h>
+
+#include <memory>
 #include <string>
 
 #include "tile/lang/generate.h"
@@ -18,6 +20,16 @@ class Runtime : public llvm::RuntimeDyld::SymbolResolver {
   llvm::RuntimeDyld::SymbolInfo findSymbolInLogicalDylib(const std::string&) override;
 };
 
+// Performs LLVM's one-time native target initialization.
+void InitializeNativeTarget();
+
+// Takes ownership of an execution engine whose modules were created in the
+// supplied context, keeping the context alive until the engine is destroyed.
+// Kernels are compiled in contexts of their own so that they can be compiled
+// concurrently; LLVM contexts are not thread-safe.
+std::shared_ptr<llvm::ExecutionEngine> ShareEngine(llvm::ExecutionEngine* engine,
+                                                   std::shared_ptr<llvm::LLVMContext> context);
+
 }  // namespace cpu
 }  // namespace hal
 }  // namespace tile
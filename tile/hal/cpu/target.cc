@@ -0,0 +1,141 @@
+// Copyright 2018 Intel Corporation.
+
+#include "tile/hal/cpu/target.h"
+
+#include <llvm/ADT/StringMap.h>
+#include <llvm/ADT/Triple.h>
+#include <llvm/ExecutionEngine/ExecutionEngine.h>
+#include <llvm/Support/Host.h>
+#include <llvm/Target/TargetOptions.h>
+
+#if defined(__APPLE__)
+#include <sys/sysctl.h>
+#include <sys/types.h>
+#elif !defined(_WIN32)
+#include <unistd.h>
+#endif
+
+#include <algorithm>
+#include <cstdint>
+#include <map>
+
+#include "base/util/logging.h"
+
+namespace vertexai {
+namespace tile {
+namespace hal {
+namespace cpu {
+namespace {
+
+// Reads one of the processor's cache parameters from the operating system,
+// returning zero if it isn't available.
+std::size_t CacheParameter(const char* sysctl_name, int sysconf_name) {
+#if defined(__APPLE__)
+  std::int64_t value = 0;
+  std::size_t length = sizeof(value);
+  if (sysctlbyname(sysctl_name, &value, &length, nullptr, 0) == 0 && 0 < value) {
+    return value;
+  }
+#elif !defined(_WIN32)
+  if (sysconf_name) {
+    long value = sysconf(sysconf_name);  // NOLINT(runtime/int)
+    if (0 < value) {
+      return value;
+    }
+  }
+#endif
+  return 0;
+}
+
+#if defined(_SC_LEVEL1_DCACHE_SIZE)
+constexpr int kL1Size = _SC_LEVEL1_DCACHE_SIZE;
+constexpr int kL2Size = _SC_LEVEL2_CACHE_SIZE;
+constexpr int kLineSize = _SC_LEVEL1_DCACHE_LINESIZE;
+#else
+constexpr int kL1Size = 0;
+constexpr int kL2Size = 0;
+constexpr int kLineSize = 0;
+#endif
+
+HostTarget DetectHostTarget() {
+  HostTarget host;
+  host.cpu = llvm::sys::getHostCPUName().str();
+
+  std::map<std::string, bool> features;
+  llvm::StringMap<bool> feature_map;
+  if (llvm::sys::getHostCPUFeatures(feature_map)) {
+    for (const auto& feature : feature_map) {
+      features.emplace(feature.getKey().str(), feature.getValue());
+    }
+  }
+  for (const auto& feature : features) {
+    host.features.push_back((feature.second ? "+" : "-") + feature.first);
+  }
+  auto has = [&features](const char* name) {
+    auto it = features.find(name);
+    return it != features.end() && it->second;
+  };
+
+  // The feature flags only report the vector extensions the operating system
+  // saves across context switches, so they're safe to use as-is.
+  llvm::Triple triple{llvm::sys::getProcessTriple()};
+  if (has("avx512f")) {
+    host.vector_bits = 512;
+    host.vector_registers = 32;
+  } else if (has("avx")) {
+    host.vector_bits = 256;
+    host.vector_registers = triple.getArch() == llvm::Triple::x86 ? 8 : 16;
+  } else if (triple.getArch() == llvm::Triple::aarch64) {
+    host.vector_bits = 128;
+    host.vector_registers = 32;
+  } else {
+    host.vector_bits = 128;
+    host.vector_registers = triple.getArch() == llvm::Triple::x86 ? 8 : 16;
+  }
+
+  // When the operating system can't tell us, assume the cache geometry common
+  // to the x86 and ARM cores we care about.
+  host.cache_line = CacheParameter("hw.cachelinesize", kLineSize);
+  host.l1_cache = CacheParameter("hw.l1dcachesize", kL1Size);
+  host.l2_cache = CacheParameter("hw.l2cachesize", kL2Size);
+  if (!host.cache_line) {
+    host.cache_line = 64;
+  }
+  if (!host.l1_cache) {
+    host.l1_cache = 32 * 1024;
+  }
+  if (!host.l2_cache) {
+    host.l2_cache = 256 * 1024;
+  }
+  host.l2_cache = std::max(host.l2_cache, host.l1_cache);
+
+  VLOG(1) << "CPU target: " << host.cpu << ", " << host.vector_registers << " x " << host.vector_bits
+          << "-bit vector registers, " << host.l1_cache << " byte L1, " << host.l2_cache << " byte L2, "
+          << host.cache_line << " byte cache lines";
+  return host;
+}
+
+}  // namespace
+
+const HostTarget& GetHostTarget() {
+  static const HostTarget host = DetectHostTarget();
+  return host;
+}
+
+void ConfigureForHost(llvm::EngineBuilder* builder, bool fuse_fp_ops) {
+  const HostTarget& host = GetHostTarget();
+  // Tile makes no promises about the rounding of intermediate results (GPUs
+  // routinely fuse multiply-adds), so unless the device settings disable it,
+  // multiplies and adds may be contracted into FMAs.
+  llvm::TargetOptions options;
+  options.AllowFPOpFusion = fuse_fp_ops ? llvm::FPOpFusion::Fast : llvm::FPOpFusion::Standard;
+  builder->setMCPU(host.cpu)
+      .setMAttrs(host.features)
+      .setOptLevel(llvm::CodeGenOpt::Aggressive)
+      .setTargetOptions(options);
+}
+
+}  // namespace cpu
+}  // namespace hal
+}  // namespace tile
+}  // namespace vertexai
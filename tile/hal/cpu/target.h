@@ -0,0 +1,41 @@
+// Copyright 2018 Intel Corporation.
+
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+namespace llvm {
+class EngineBuilder;
+}  // namespace llvm
+
+namespace vertexai {
+namespace tile {
+namespace hal {
+namespace cpu {
+
+// Describes the processor the CPU HAL is running on, and therefore generating
+// code for.
+struct HostTarget {
+  std::string cpu;                    // LLVM's name for the CPU, e.g. "skylake-avx512"
+  std::vector<std::string> features;  // Sorted LLVM feature attributes, e.g. "+avx2"
+  unsigned vector_bits;               // Width of the widest usable vector registers
+  unsigned vector_registers;          // Number of vector registers
+  std::size_t cache_line;             // Bytes per cache line
+  std::size_t l1_cache;               // Bytes of L1 data cache per core
+  std::size_t l2_cache;               // Bytes of L2 cache per core
+};
+
+// Returns the description of the host processor, detected on first use.
+const HostTarget& GetHostTarget();
+
+// Configures an engine builder to generate code for the host processor.
+// When fuse_fp_ops is set, separate floating point multiplies and adds may be
+// fused into FMA instructions.
+void ConfigureForHost(llvm::EngineBuilder* builder, bool fuse_fp_ops);
+
+}  // namespace cpu
+}  // namespace hal
+}  // namespace tile
+}  // namespace vertexai
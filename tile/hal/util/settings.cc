@@ -63,6 +63,7 @@ lang::HardwareSettings ToHardwareSettings(const proto::HardwareSettings& setting
   result.mem_width = settings.mem_width();
   result.max_mem = settings.max_mem();
   result.max_regs = settings.max_regs();
+  result.max_cache = settings.max_cache();
   result.goal_groups = settings.goal_groups();
   result.goal_flops_per_byte = settings.goal_flops_per_byte();
   result.goal_dimension_sizes = std::move(dim_sizes);
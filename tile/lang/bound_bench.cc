@@ -0,0 +1,71 @@
+// Times the bounds computation for typical contractions: the constraint
+// gathering and ComputeBounds steps of contraction compilation, whose cost is
+// dominated by rational arithmetic in the ILP solver.
+
+#include <chrono>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include "tile/lang/bound.h"
+#include "tile/lang/parser.h"
+
+namespace vertexai {
+namespace tile {
+namespace lang {
+namespace {
+
+struct Case {
+  const char* name;
+  const char* contraction;
+  std::vector<TensorShape> shapes;
+};
+
+void Run(const Case& c, int iters) {
+  Parser parser;
+  Contraction cion = ConstrainIndexVarsToInts(parser.ParseContraction(c.contraction));
+  auto start = std::chrono::steady_clock::now();
+  std::size_t sink = 0;
+  for (int i = 0; i < iters; ++i) {
+    auto cons = GatherConstraints(cion, c.shapes);
+    MergeParallelConstraints(&cons);
+    auto bounds = ComputeBounds(cons);
+    sink += std::get<0>(bounds).size();
+  }
+  std::chrono::duration<double, std::micro> elapsed = std::chrono::steady_clock::now() - start;
+  std::printf("%-24s %10.1f us/iter  (%zu)\n", c.name, elapsed.count() / iters, sink);
+}
+
+}  // namespace
+}  // namespace lang
+}  // namespace tile
+}  // namespace vertexai
+
+int main(int argc, char** argv) {
+  using vertexai::tile::DataType;
+  using vertexai::tile::SimpleShape;
+  using vertexai::tile::lang::Case;
+  int iters = argc > 1 ? std::stoi(argv[1]) : 200;
+  std::vector<Case> cases = {
+      {"matmul",
+       "O[i, j : 1024, 1024] = +(A[i, k] * B[k, j])",
+       {SimpleShape(DataType::FLOAT32, {1024, 1024}), SimpleShape(DataType::FLOAT32, {1024, 1024}),
+        SimpleShape(DataType::FLOAT32, {1024, 1024})}},
+      {"conv3x3",
+       "O[n, x, y, co : 32, 56, 56, 64] = +(I[n, x + i - 1, y + j - 1, ci] * K[i, j, ci, co])",
+       {SimpleShape(DataType::FLOAT32, {32, 56, 56, 64}), SimpleShape(DataType::FLOAT32, {32, 56, 56, 64}),
+        SimpleShape(DataType::FLOAT32, {3, 3, 64, 64})}},
+      {"conv7x7_stride2",
+       "O[n, x, y, co : 32, 112, 112, 64] = +(I[n, 2 * x + i - 3, 2 * y + j - 3, ci] * K[i, j, ci, co])",
+       {SimpleShape(DataType::FLOAT32, {32, 112, 112, 64}), SimpleShape(DataType::FLOAT32, {32, 224, 224, 3}),
+        SimpleShape(DataType::FLOAT32, {7, 7, 3, 64})}},
+      {"conv3x3_dilated",
+       "O[n, x, y, co : 8, 28, 28, 128] = +(I[n, x + 2 * i - 2, y + 2 * j - 2, ci] * K[i, j, ci, co])",
+       {SimpleShape(DataType::FLOAT32, {8, 28, 28, 128}), SimpleShape(DataType::FLOAT32, {8, 28, 28, 128}),
+        SimpleShape(DataType::FLOAT32, {3, 3, 128, 128})}},
+  };
+  for (const auto& c : cases) {
+    vertexai::tile::lang::Run(c, iters);
+  }
+  return 0;
+}
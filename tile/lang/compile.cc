@@ -1,8 +1,13 @@
 #include "tile/lang/compile.h"
 
 #include <cinttypes>
+#include <memory>
 #include <sstream>
 
+#include <boost/algorithm/string/replace.hpp>
+
+#include "base/util/perf_counter.h"
+#include "tile/base/lru_cache.h"
 #include "tile/lang/bound.h"
 #include "tile/lang/defract.h"
 #include "tile/lang/parser.h"
@@ -16,13 +21,62 @@ namespace lang {
 
 using namespace math;  // NOLINT
 
-FlatContraction Compile(const Contraction& c, const std::vector<TensorShape>& shapes,
-                        std::vector<Polynomial<Rational>>* out_poly) {
-  if (c.specs.size() != 2 && c.specs.size() != 3 && c.specs.size() != 4) {
-    throw std::runtime_error("Currently, we only support 1, 2, or 3 element Contractions");
+namespace {
+
+PerfCounter flat_cache_hits("flat_cache_hits");
+PerfCounter flat_cache_misses("flat_cache_misses");
+
+// The number of distinct contraction/shape combinations to remember.
+constexpr std::size_t kFlatCacheSize = 4096;
+
+struct CompiledContraction {
+  FlatContraction flat;
+  std::vector<Polynomial<Rational>> out_poly;
+};
+
+// The placeholder standing in for the i'th tensor of a canonical contraction.
+std::string TensorPlaceholder(std::size_t i) { return "_T" + std::to_string(i) + "_"; }
+
+// Returns a copy of the contraction carrying only what compilation depends
+// on, with tensor names replaced by positional placeholders, so that
+// contractions differing only in tensor names share a cache entry.
+Contraction Canonicalize(const Contraction& c) {
+  Contraction canon;
+  canon.comb_op = c.comb_op;
+  canon.agg_op = c.agg_op;
+  canon.no_defract = c.no_defract;
+  canon.specs.resize(c.specs.size());
+  for (std::size_t i = 0; i < c.specs.size(); i++) {
+    canon.specs[i].id = TensorPlaceholder(i);
+    canon.specs[i].spec = c.specs[i].spec;
   }
+  for (const auto& con : c.constraints) {
+    canon.constraints.emplace_back(con.bound);
+  }
+  return canon;
+}
+
+std::string CacheKey(const Contraction& canon, const std::vector<TensorShape>& shapes) {
+  std::ostringstream key;
+  key << to_string(canon);
+  for (const auto& shape : shapes) {
+    key << ';' << shape;
+  }
+  return key.str();
+}
+
+// Rewrites the canonical placeholders in compilation comments back to the
+// caller's tensor names.
+std::string RenameTensors(std::string text, const Contraction& c) {
+  for (std::size_t i = 0; i < c.specs.size(); i++) {
+    boost::replace_all(text, TensorPlaceholder(i), c.specs[i].id);
+  }
+  return text;
+}
+
+FlatContraction CompileUncached(const Contraction& c, const std::vector<TensorShape>& shapes,
+                                std::vector<Polynomial<Rational>>* out_poly) {
   std::ostringstream cs;
-  SVLOG(cs, 3, "Original:\n" << to_string(c).c_str());
   Contraction int_idx_cntrc = ConstrainIndexVarsToInts(c);
   SVLOG(cs, 3, "With Index Variables Made Integral:\n" << to_string(int_idx_cntrc).c_str());
   // Check if we can skip reduce
@@ -58,6 +112,46 @@ FlatContraction Compile(const Contraction& c, const std::vector<TensorShape>& sh
   return flat;
 }
 
+}  // namespace
+
+FlatContraction Compile(const Contraction& c, const std::vector<TensorShape>& shapes,
+                        std::vector<Polynomial<Rational>>* out_poly) {
+  if (c.specs.size() != 2 && c.specs.size() != 3 && c.specs.size() != 4) {
+    throw std::runtime_error("Currently, we only support 1, 2, or 3 element Contractions");
+  }
+  std::ostringstream cs;
+  SVLOG(cs, 3, "Original:\n" << to_string(c).c_str());
+
+  // Bounds and flattening depend only on the index polynomials, constraints
+  // and shapes, so identical layers of a network (and repeated compiles of the
+  // same network) are solved once per process.
+  static LruCache<std::string, std::shared_ptr<const CompiledContraction>> cache{kFlatCacheSize};
+  Contraction canon = Canonicalize(c);
+  bool built = false;
+  auto compiled = cache.Lookup(CacheKey(canon, shapes), [&] {
+    built = true;
+    auto result = std::make_shared<CompiledContraction>();
+    result->flat = CompileUncached(canon, shapes, &result->out_poly);
+    return std::shared_ptr<const CompiledContraction>{std::move(result)};
+  });
+  if (built) {
+    flat_cache_misses.inc();
+  } else {
+    flat_cache_hits.inc();
+  }
+
+  FlatContraction flat = compiled->flat;
+  flat.inputs.clear();
+  for (const auto& spec : c.specs) {
+    flat.inputs.push_back(spec.id);
+  }
+  flat.comments = cs.str() + RenameTensors(flat.comments, c);
+  if (out_poly) {
+    *out_poly = compiled->out_poly;
+  }
+  return flat;
+}
+
 }  // namespace lang
 }  // namespace tile
 }  // namespace vertexai
@@ -234,6 +234,9 @@ struct RunInfo {
   std::map<std::string, std::shared_ptr<BufferBase>> input_buffers;
   std::map<std::string, std::shared_ptr<BufferBase>> output_buffers;
   std::set<std::string> const_inputs;
+  // The program cache fingerprint of code and shapes; filled in lazily by the
+  // first invocation, so that later invocations skip rehashing the program.
+  std::string fingerprint;
 };
 
 class FunctionApplication;
@@ -1,5 +1,6 @@
 #include "tile/lang/flat.h"
 
+#include <algorithm>
 #include <cinttypes>
 #include <set>
 #include <stdexcept>
@@ -25,7 +26,13 @@ using namespace math;  // NOLINT
 
 boost::uuids::string_generator string_uuid_gen;
 boost::uuids::uuid master_uuid = string_uuid_gen("754653de-4796-4a89-ad95-da88a9e92ceb");
-boost::uuids::name_generator name_uuid_gen(master_uuid);
+
+// Kernels are generated concurrently, and a name_generator carries hashing
+// state across calls, so each key gets a generator of its own.
+static boost::uuids::uuid name_uuid_gen(const std::string& name) {
+  boost::uuids::name_generator gen(master_uuid);
+  return gen(name);
+}
 
 FlatContraction::FlatContraction(const Contraction& c) : access(c.specs.size()), comb_op(c.comb_op), agg_op(c.agg_op) {}
 
@@ -97,9 +104,28 @@ std::string FlatContraction::CacheKeyString(const Bindings& vars) const {
   for (const auto& op_input : post_op_inputs) {
     r += json_serialize(op_input.access);
   }
+  for (const auto& kvp : prologues) {
+    std::map<std::string, std::string> pmap;
+    r += std::to_string(kvp.first) + ":" + vars.at(kvp.second.source).key() + " ";
+    NormalizeName(&pmap, vars, kvp.second.source, true);
+    for (const auto& op : kvp.second.ops) {
+      std::string inner;
+      for (const auto& iname : op.inputs) {
+        if (inner.size()) {
+          inner += ",";
+        }
+        inner += NormalizeName(&pmap, vars, iname, false);
+      }
+      r += NormalizeName(&pmap, vars, op.output, true);
+      r += "=" + op.f.fn + "(" + inner + "); ";
+    }
+  }
   for (const auto& s : kernel_outputs) {
     r += NormalizeName(&map, vars, s, false);
   }
+  if (init_output) {
+    r += " init(" + (init_source.empty() ? std::string() : vars.at(init_source).key()) + ")";
+  }
   std::replace(r.begin(), r.end(), '\n', ' ');
   boost::uuids::uuid id = name_uuid_gen(r);
   return to_string(id);
@@ -146,6 +172,29 @@ std::string FlatContraction::toString() const {
   return ss.str();
 }
 
+bool OutputIndexOrder(const FlatContraction& flat, std::vector<std::size_t>* order) {
+  std::vector<std::size_t> idxs;
+  for (size_t i = 0; i < flat.names.size(); i++) {
+    if (flat.access[0].strides[i] < 0) {
+      return false;
+    }
+    if (flat.access[0].strides[i] != 0) {
+      idxs.push_back(i);
+    }
+  }
+  const auto& strides = flat.access[0].strides;
+  std::sort(idxs.begin(), idxs.end(), [&](std::size_t a, std::size_t b) { return strides[a] < strides[b]; });
+  int64_t span = 0;
+  for (auto i : idxs) {
+    if (strides[i] <= span) {
+      return false;
+    }
+    span += strides[i] * (static_cast<int64_t>(flat.ranges[i]) - 1);
+  }
+  order->assign(idxs.rbegin(), idxs.rend());
+  return true;
+}
+
 FlatContraction Flatten(const Contraction& c, const std::vector<TensorShape>& shapes) {
   if (shapes.size() != c.specs.size()) {
     throw std::runtime_error(
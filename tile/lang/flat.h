@@ -47,6 +47,15 @@ struct FlatPostOpInput {
   Binding binding;
 };
 
+// Elementwise operations computing a contraction input from another tensor of
+// the same shape.  Rather than materializing the input, the contraction reads
+// the source and applies the operations to each element as it's loaded.
+struct FlatPrologue {
+  std::string source;
+  DataType source_type = DataType::INVALID;
+  std::vector<Op> ops;  // In program order; the last computes the input.
+};
+
 struct FlatContraction {
   FlatContraction() = default;
   explicit FlatContraction(const Contraction& c);
@@ -74,15 +83,29 @@ struct FlatContraction {
 
   // Full cache primary key (names replaced to protect the innocent)
   std::vector<Op> post_ops;
-  std::vector<FlatPostOpInput> post_op_inputs;  // Additional inputs for the post_ops
-  std::vector<std::string> kernel_outputs;      // Outputs written by the kernel.
+  std::vector<FlatPostOpInput> post_op_inputs;    // Additional inputs for the post_ops
+  std::vector<std::string> kernel_outputs;        // Outputs written by the kernel.
+  std::map<std::size_t, FlatPrologue> prologues;  // Fused input computations, by access index
   std::map<std::string, std::vector<math::Polynomial<math::Rational>>> index_mapping;
 
+  // If set, the kernel also writes the output elements the contraction doesn't
+  // compute: copying them from init_source if it's non-empty, or zeroing them.
+  bool init_output = false;
+  std::string init_source;
+
   std::string CacheKeyString(const Bindings& vars) const;
 
   std::string toString() const;
 };
 
+// Finds the order in which to divide an output element's position (relative
+// to the output offset) by the output strides to recover the index values
+// that write it.  This requires non-negative output strides, each larger than
+// the span of the smaller ones, so that any division that leaves no remainder
+// within the index ranges identifies the only such element.  Returns false if
+// the output strides don't allow it.
+bool OutputIndexOrder(const FlatContraction& flat, std::vector<std::size_t>* order);
+
 // Require Contraction to be in reduced form
 FlatContraction Flatten(const Contraction& c, const std::vector<TensorShape>& shapes);
 
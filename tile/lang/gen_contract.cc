@@ -2,6 +2,8 @@
 
 #include <assert.h>
 
+#include <functional>
+
 #include <boost/algorithm/string/replace.hpp>
 
 #include "base/util/logging.h"
@@ -75,6 +77,180 @@ static sem::ExprPtr aggregate(const AggregationOp& op, sem::ExprPtr lhs, sem::Ex
   }
 }
 
+// Returns the value of a constant input to an elementwise operation.
+static sem::ExprPtr ConstantExpr(const Binding& binding, uint64_t vec) {
+  using namespace sem::builder;  // NOLINT
+  sem::ExprPtr val;
+  switch (binding.tag) {
+    case Binding::ICONST:
+      val = std::make_shared<sem::IntConst>(binding.iconst);
+      break;
+    case Binding::FCONST:
+      val = std::make_shared<sem::FloatConst>(binding.fconst);
+      break;
+    default:
+      throw std::runtime_error("Cannot use tuple as contraction local");
+  }
+  if (vec > 1) {
+    // TODO: This is hacky.  It works (unlike using an
+    // integer type -- int4 and float4 don't interoperate
+    // well), but we should come up with a better way to do
+    // this.
+    sem::Type type = {sem::Type::VALUE, DataType::FLOAT32, vec};
+    val = _Cast(type, val);
+  }
+  return val;
+}
+
+// Returns the value of an elementwise operation, given the values of its
+// inputs.
+static sem::ExprPtr ElementwiseExpr(const Op& eop, std::vector<sem::ExprPtr> inexprs, const Bindings& vars,
+                                    const FlatContraction& op, uint64_t vec) {
+  using namespace sem::builder;  // NOLINT
+  const auto& bin_ops = BinaryOpMap();
+  sem::ExprPtr opexpr = nullptr;
+  if (bin_ops.count(eop.f.fn)) {
+    std::string opname = bin_ops.at(eop.f.fn);
+    opexpr = std::make_shared<sem::BinaryExpr>(opname, inexprs[0], inexprs[1]);
+  } else if (eop.f.fn == "cond") {
+    switch (vars.at(eop.inputs[0]).shape.type) {
+      case DataType::FLOAT16:
+      case DataType::FLOAT32:
+      case DataType::FLOAT64:
+        inexprs[0] = (inexprs[0] != 0.0);
+        break;
+      case DataType::BOOLEAN:
+        break;
+      default:
+        inexprs[0] = (inexprs[0] != 0);
+        break;
+    }
+    opexpr = _Cond(inexprs[0], inexprs[1], inexprs[2]);
+  } else if (eop.f.fn == "neg") {
+    opexpr = std::make_shared<sem::UnaryExpr>("-", inexprs[0]);
+  } else if (eop.f.fn == "bit_not") {
+    opexpr = std::make_shared<sem::UnaryExpr>("~", inexprs[0]);
+  } else if (eop.f.fn == "ident" || eop.f.fn == "reshape") {
+    opexpr = inexprs[0];
+  } else if (eop.f.fn == "as_float" || eop.f.fn == "as_int" || eop.f.fn == "as_uint") {
+    sem::Type declatype{sem::Type::VALUE, vars.at(eop.output).shape.type, vec};
+    opexpr = _Cast(declatype, inexprs[0]);
+  } else if (eop.f.fn == "index") {
+    // Pull constant back out of semtree node
+    sem::IntConst* val = dynamic_cast<sem::IntConst*>(inexprs[1].get());
+    if (val == nullptr) {
+      throw std::runtime_error("Second argument of index must be an integer");
+    }
+    int64_t idx_num = val->value;
+    const auto& polys = op.index_mapping.at(eop.inputs[0]);
+    if (idx_num < 0 || idx_num >= polys.size()) {
+      throw std::runtime_error("In call to index, index number is out of bounds");
+    }
+    const auto& poly = polys[idx_num];
+    sem::ExprPtr poly_eval = _Const(0);
+    for (const auto& kvp : poly.getMap()) {
+      sem::ExprPtr mul = _Const(static_cast<int64_t>(Floor(kvp.second)));
+      if (kvp.first == "") {
+        poly_eval = poly_eval + mul;
+      } else {
+        poly_eval = poly_eval + mul * _(kvp.first);
+      }
+    }
+    opexpr = poly_eval;
+  } else {
+    opexpr = std::make_shared<sem::CallExpr>(_(eop.f.fn), inexprs);
+  }
+  assert(static_cast<bool>(opexpr));
+  return opexpr;
+}
+
+// Computes a fused contraction input from an element of its prologue's
+// source.  Each operation's result is converted to the type of its output,
+// as it would be if it were stored.
+static sem::ExprPtr PrologueExpr(const FlatPrologue& prologue, const sem::ExprPtr& loaded, const Bindings& vars,
+                                 const FlatContraction& op, uint64_t vec) {
+  using namespace sem::builder;  // NOLINT
+  std::map<std::string, sem::ExprPtr> values{{prologue.source, loaded}};
+  for (const auto& pre_op : prologue.ops) {
+    std::vector<sem::ExprPtr> inexprs;
+    for (const std::string& in : pre_op.inputs) {
+      const auto& tin = vars.at(in);
+      if (tin.tag == Binding::TENSOR) {
+        inexprs.push_back(values.at(in));
+      } else {
+        inexprs.push_back(ConstantExpr(tin, vec));
+      }
+    }
+    sem::ExprPtr value = ElementwiseExpr(pre_op, std::move(inexprs), vars, op, vec);
+    DataType type = vars.at(pre_op.output).shape.type;
+    if (type != DataType::BOOLEAN) {
+      value = _Cast({sem::Type::VALUE, type, vec}, value);
+    }
+    values[pre_op.output] = value;
+  }
+  return values.at(prologue.ops.back().output);
+}
+
+// Initializes the output elements which the contraction doesn't compute.  The
+// kernel's threads stride across the output; each decomposes the position of
+// its element over the output strides, and writes the element unless some
+// in-range index values satisfying the output-only constraints compute it.
+static sem::StmtPtr InitOutput(const FlatContraction& op, const GridSize& gwork) {
+  using namespace sem::builder;  // NOLINT
+  std::vector<std::size_t> order;
+  if (!OutputIndexOrder(op, &order)) {
+    throw std::runtime_error("Unable to find the uncomputed elements of " + op.output);
+  }
+  const auto& oacc = op.access[0];
+  uint64_t total = gwork[0] * gwork[1] * gwork[2];
+  auto block = _Block({});
+  sem::ExprPtr gid = _Index(sem::IndexExpr::GLOBAL, 0) +
+                     gwork[0] * (_Index(sem::IndexExpr::GLOBAL, 1) + gwork[1] * _Index(sem::IndexExpr::GLOBAL, 2));
+  block->append(_Declare({sem::Type::INDEX}, "init_gid", gid));
+
+  auto inner = _Block({});
+  inner->append(_Declare({sem::Type::INDEX}, "init_idx", _("init_base") + _("init_gid") - oacc.offset));
+  inner->append(_Declare({sem::Type::INDEX}, "init_rem", _("init_idx")));
+  sem::ExprPtr computed = _Const(1);
+  for (auto i : order) {
+    std::string var = op.names[i] + "_init";
+    inner->append(_Declare({sem::Type::INDEX}, var, _("init_rem") / oacc.strides[i]));
+    inner->append(_("init_rem") = _("init_rem") - _(var) * oacc.strides[i]);
+    computed = _LogicalAnd(computed, _LogicalAnd(_(var) >= 0, _(var) < op.ranges[i]));
+  }
+  computed = _LogicalAnd(computed, _("init_rem") == 0);
+  for (const FlatConstraint& fc : op.constraints) {
+    sem::ExprPtr sum = _Const(0);
+    bool only_output = true;
+    for (size_t i = 0; i < op.names.size(); i++) {
+      if (fc.lhs[i] != 0) {
+        if (oacc.strides[i] == 0) {
+          only_output = false;
+          break;
+        }
+        sum = sum + fc.lhs[i] * _(op.names[i] + "_init");
+      }
+    }
+    if (only_output) {
+      computed = _LogicalAnd(computed, sum <= fc.rhs);
+    }
+  }
+
+  sem::ExprPtr value;
+  if (op.init_source.empty()) {
+    value = _LimitConst(sem::LimitConst::ZERO, oacc.type);
+    if (oacc.vector > 1) {
+      value = _Cast({sem::Type::VALUE, oacc.type, oacc.vector}, value);
+    }
+  } else {
+    value = _(op.init_source)[_("init_idx")];
+  }
+  sem::ExprPtr in_bounds = _("init_base") + _("init_gid") < oacc.global_index_limit;
+  inner->append(_If(_LogicalAnd(in_bounds, !computed), _(op.output)[_("init_idx")] = value));
+  block->append(_For("init_base", RoundUp(oacc.global_index_limit, total), total, inner));
+  return block;
+}
+
 KernelInfo GenContract(const string& kname, const DirectSettings& settings, const FlatContraction& op,
                        const std::vector<uint64_t>& tile, const Bindings& vars, const std::vector<std::string>& inputs,
                        const proto::PerfStats& perf) {
@@ -178,6 +354,9 @@ KernelInfo GenContract(const string& kname, const DirectSettings& settings, cons
     for (const auto& out : op.kernel_outputs) {
       kblock->append(_(out) = _(out) + op.access[0].offset);
     }
+    if (!op.init_source.empty()) {
+      kblock->append(_(op.init_source) = _(op.init_source) + op.access[0].offset);
+    }
   }
   for (size_t i = 1; i < op.access.size(); i++) {
     if (op.access[i].offset != 0) {
@@ -196,7 +375,9 @@ KernelInfo GenContract(const string& kname, const DirectSettings& settings, cons
     sem::Type type = {sem::Type::VALUE, op.agg_type, op.agg_vec};
 
     // Initalize local output variable to correct value based on agg_type
-    auto tc = INITIAL_VALUES[op.agg_op];
+    // N.B. Kernels are generated concurrently, so the table is only read.
+    auto it = INITIAL_VALUES.find(op.agg_op);
+    auto tc = it == INITIAL_VALUES.end() ? sem::LimitConst::MIN : it->second;
     sem::ExprPtr agg_base = _LimitConst(tc, op.agg_type);
     if (type.vec_width > 1) {
       agg_base = _Cast(type, agg_base);
@@ -240,8 +421,16 @@ KernelInfo GenContract(const string& kname, const DirectSettings& settings, cons
       for (size_t i = 1; i < op.access.size(); i++) {
         if (bindings[i] && bindings[i]->tag == Binding::TENSOR) {
           string sname = "in" + std::to_string(i);
+          // A fused input is computed once per element as it's loaded.
+          std::function<sem::ExprPtr(const sem::ExprPtr&)> load;
+          auto pit = op.prologues.find(i);
+          if (pit != op.prologues.end()) {
+            load = [&, pit, i](const sem::ExprPtr& loaded) {
+              return PrologueExpr(pit->second, loaded, vars, op, op.access[i].vector);
+            };
+          }
           iblock->push_back(pins[i - 1].generate(sname + "_shared", sname, threads, op.access[i].global_index_limit,
-                                                 op.access[i].offset));
+                                                 op.access[i].offset, load));
           loaded_input = true;
         }
       }
@@ -294,6 +483,11 @@ KernelInfo GenContract(const string& kname, const DirectSettings& settings, cons
         case Binding::TENSOR:
           if (settings.use_global) {
             input = _("in" + num)[pin.globalOffset()];
+            // Without shared memory, a fused input is computed at each use.
+            auto pit = op.prologues.find(i);
+            if (pit != op.prologues.end()) {
+              input = PrologueExpr(pit->second, input, vars, op, op.access[i].vector);
+            }
           } else {
             input = _("in" + num + "_shared")[pin.sharedOffset()];
           }
@@ -494,101 +688,21 @@ KernelInfo GenContract(const string& kname, const DirectSettings& settings, cons
     checked_output_block->append(declstmt);
   }
 
-  auto bin_ops = BinaryOpMap();
-
   for (const auto& post_op : op.post_ops) {
     IVLOG(4, "Unifying elementwise op " << post_op.f.fn << " into kernel " << kname);
     std::vector<sem::ExprPtr> inexprs;
 
     for (const std::string& in : post_op.inputs) {
       const auto& tin = vars.at(in);
-      switch (tin.tag) {
-        case Binding::TENSOR: {
-          sem::Type type = {sem::Type::VALUE, tin.shape.type, op.agg_vec};
-          inexprs.push_back(_Cast(type, _("L" + in)));
-          break;
-        }
-        case Binding::ICONST: {
-          sem::ExprPtr val = std::make_shared<sem::IntConst>(tin.iconst);
-          if (op.agg_vec > 1) {
-            // TODO: This is hacky.  It works (unlike using an
-            // integer type -- int4 and float4 don't interoperate
-            // well), but we should come up with a better way to do
-            // this.
-            sem::Type type = {sem::Type::VALUE, DataType::FLOAT32, op.agg_vec};
-            val = _Cast(type, val);
-          }
-          inexprs.push_back(val);
-          break;
-        }
-        case Binding::FCONST: {
-          sem::ExprPtr val = std::make_shared<sem::FloatConst>(tin.fconst);
-          if (op.agg_vec > 1) {
-            sem::Type type = {sem::Type::VALUE, DataType::FLOAT32, op.agg_vec};
-            val = _Cast(type, val);
-          }
-          inexprs.push_back(val);
-          break;
-        }
-        case Binding::TUPLE: {
-          throw std::runtime_error("Cannot use tuple as contraction local");
-        }
+      if (tin.tag == Binding::TENSOR) {
+        sem::Type type = {sem::Type::VALUE, tin.shape.type, op.agg_vec};
+        inexprs.push_back(_Cast(type, _("L" + in)));
+      } else {
+        inexprs.push_back(ConstantExpr(tin, op.agg_vec));
       }
     }
 
-    sem::ExprPtr opexpr = nullptr;
-    if (bin_ops.count(post_op.f.fn)) {
-      std::string opname = bin_ops.at(post_op.f.fn);
-      opexpr = std::make_shared<sem::BinaryExpr>(opname, inexprs[0], inexprs[1]);
-    } else if (post_op.f.fn == "cond") {
-      switch (vars.at(post_op.inputs[0]).shape.type) {
-        case DataType::FLOAT16:
-        case DataType::FLOAT32:
-        case DataType::FLOAT64:
-          inexprs[0] = (inexprs[0] != 0.0);
-          break;
-        case DataType::BOOLEAN:
-          break;
-        default:
-          inexprs[0] = (inexprs[0] != 0);
-          break;
-      }
-      opexpr = _Cond(inexprs[0], inexprs[1], inexprs[2]);
-    } else if (post_op.f.fn == "neg") {
-      opexpr = std::make_shared<sem::UnaryExpr>("-", inexprs[0]);
-    } else if (post_op.f.fn == "bit_not") {
-      opexpr = std::make_shared<sem::UnaryExpr>("~", inexprs[0]);
-    } else if (post_op.f.fn == "ident" || post_op.f.fn == "reshape") {
-      opexpr = inexprs[0];
-    } else if (post_op.f.fn == "as_float" || post_op.f.fn == "as_int" || post_op.f.fn == "as_uint") {
-      sem::Type declatype{sem::Type::VALUE, vars.at(post_op.output).shape.type, op.agg_vec};
-      opexpr = _Cast(declatype, inexprs[0]);
-    } else if (post_op.f.fn == "index") {
-      // Pull constant back out of semtree node
-      sem::IntConst* val = dynamic_cast<sem::IntConst*>(inexprs[1].get());
-      if (val == nullptr) {
-        throw std::runtime_error("Second argument of index must be an integer");
-      }
-      int64_t idx_num = val->value;
-      const auto& polys = op.index_mapping.at(post_op.inputs[0]);
-      if (idx_num < 0 || idx_num >= polys.size()) {
-        throw std::runtime_error("In call to index, index number is out of bounds");
-      }
-      const auto& poly = polys[idx_num];
-      sem::ExprPtr poly_eval = _Const(0);
-      for (const auto& kvp : poly.getMap()) {
-        sem::ExprPtr mul = _Const(static_cast<int64_t>(Floor(kvp.second)));
-        if (kvp.first == "") {
-          poly_eval = poly_eval + mul;
-        } else {
-          poly_eval = poly_eval + mul * _(kvp.first);
-        }
-      }
-      opexpr = poly_eval;
-    } else {
-      opexpr = std::make_shared<sem::CallExpr>(_(post_op.f.fn), inexprs);
-    }
-    assert(static_cast<bool>(opexpr));
+    sem::ExprPtr opexpr = ElementwiseExpr(post_op, std::move(inexprs), vars, op, op.agg_vec);
 
     std::string declname = std::string("L") + post_op.output;
     sem::Type declatype{sem::Type::VALUE, vars.at(post_op.output).shape.type, op.agg_vec};
@@ -640,6 +754,10 @@ KernelInfo GenContract(const string& kname, const DirectSettings& settings, cons
 
   kblock->append(out_loop.generate(threads, 1, false, 0));
 
+  if (op.init_output) {
+    kblock->append(InitOutput(op, ki.gwork));
+  }
+
   // Wrap entire function
   auto func = std::make_shared<sem::Function>();
   func->name = kname;
@@ -650,7 +768,10 @@ KernelInfo GenContract(const string& kname, const DirectSettings& settings, cons
   }
   for (size_t i = 1; i < op.access.size(); i++) {
     if (bindings[i] && bindings[i]->tag == Binding::TENSOR) {
-      sem::Type in_type = {sem::Type::POINTER_CONST, op.access[i].type, op.access[i].vector, 0, sem::Type::GLOBAL};
+      // A fused input's parameter is its prologue's source.
+      auto pit = op.prologues.find(i);
+      DataType type = pit == op.prologues.end() ? op.access[i].type : pit->second.source_type;
+      sem::Type in_type = {sem::Type::POINTER_CONST, type, op.access[i].vector, 0, sem::Type::GLOBAL};
       func->params.emplace_back(in_type, "in" + std::to_string(i));
     }
   }
@@ -658,6 +779,10 @@ KernelInfo GenContract(const string& kname, const DirectSettings& settings, cons
     sem::Type in_type = {sem::Type::POINTER_CONST, op_input.binding.shape.type, op.agg_vec, 0, sem::Type::GLOBAL};
     func->params.emplace_back(in_type, op_input.name);
   }
+  if (!op.init_source.empty()) {
+    sem::Type in_type = {sem::Type::POINTER_CONST, op.access[0].type, op.access[0].vector, 0, sem::Type::GLOBAL};
+    func->params.emplace_back(in_type, op.init_source);
+  }
   func->body = kblock;
 
   // Assign function to kernel
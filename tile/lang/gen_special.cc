@@ -155,6 +155,17 @@ static void GenScatter(KernelList& r, const Op& op, const Bindings& bindings,  /
     lid_vars.push_back(_(var));
   }
 
+  // Each thread owns the output elements at its logical indices, for every
+  // row of the output's first dimension; it zeroes them before accumulating
+  // into them, so the output needs no separate initialization.
+  sem::ExprPtr col_offset = _Const(0);
+  for (size_t i = 1; i < out_shape.dims.size(); i++) {
+    col_offset = col_offset + lid_vars[i - 1] * out_shape.dims[i].stride;
+  }
+  body->append(_Declare({sem::Type::INDEX}, "col_offset", col_offset));
+  body->append(_For("row", out_shape.dims[0].size, 1,
+                    _Block({_("out")[_("row") * out_shape.dims[0].stride + _("col_offset")] = _Const(0)})));
+
   // inner is what will be inside the for loops over the index dimensions
   auto inner = _Block({});
   // Generate the expansion offset
@@ -177,10 +188,7 @@ static void GenScatter(KernelList& r, const Op& op, const Bindings& bindings,  /
 
   // Generate the output offset
   sem::ExprPtr out_offset = _Clamp(_("idx")[_("idx_offset")], _Const(0), _Const(out_shape.dims[0].size - 1));
-  out_offset = out_offset * out_shape.dims[0].stride;
-  for (size_t i = 1; i < out_shape.dims.size(); i++) {
-    out_offset = out_offset + lid_vars[i - 1] * out_shape.dims[i].stride;
-  }
+  out_offset = out_offset * out_shape.dims[0].stride + _("col_offset");
   inner->append(_Declare({sem::Type::INDEX}, "out_offset", out_offset));
 
   // Add in this entry
@@ -3,14 +3,17 @@
 #include <algorithm>
 #include <cctype>
 #include <iterator>
+#include <map>
 #include <memory>
 #include <set>
+#include <stack>
 #include <string>
 #include <utility>
 
 #include <boost/format.hpp>
 
 #include "base/util/logging.h"
+#include "tile/base/parallel_for.h"
 #include "tile/lang/compile.h"
 #include "tile/lang/flat.h"
 #include "tile/lang/fpconv.h"
@@ -67,10 +70,32 @@ static bool NeedsZero(const FlatContraction& flat, const TensorShape& ts) {
   return curskip != flat.access[0].global_index_limit;
 }
 
+// Returns the buffers a contraction kernel reads, after variable rewrites.
+// A fused input is read from its prologue's source.
+static std::vector<std::string> KernelInputs(const std::vector<std::string>& inputs, const FlatContraction& flat,
+                                             const Bindings& vars, const VarRewrites& var_rewrites) {
+  std::vector<std::string> result;
+  for (std::size_t idx = 0; idx < inputs.size(); ++idx) {
+    const auto& input = inputs[idx];
+    if (vars.at(input).tag != Binding::TENSOR) {
+      continue;
+    }
+    auto pit = flat.prologues.find(idx + 1);
+    result.emplace_back(var_rewrites.Lookup(pit == flat.prologues.end() ? input : pit->second.source));
+  }
+  for (const auto& op_input : flat.post_op_inputs) {
+    result.emplace_back(var_rewrites.Lookup(op_input.name));
+  }
+  if (!flat.init_source.empty()) {
+    result.emplace_back(var_rewrites.Lookup(flat.init_source));
+  }
+  return result;
+}
+
 static KernelInfo GenerateContractionKernel(const std::string& kname, const HardwareSettings& settings,
                                             const Contraction* c, const FlatContraction& flat, const TileOption& option,
                                             const std::vector<std::string>& inputs, const Bindings& vars,
-                                            const VarRewrites& var_rewrites) {
+                                            const std::vector<std::string>& kernel_inputs) {
   proto::PerfStats perf = ComputeTileStats(settings, flat, option.shape);
   KernelInfo ki = GenContract(kname, settings, flat, option.shape, vars, inputs, perf);
   ki.outputs = flat.kernel_outputs;
@@ -78,14 +103,7 @@ static KernelInfo GenerateContractionKernel(const std::string& kname, const Hard
   ki.settings = settings;
   ki.flat = flat;
   ki.tile = option;
-  for (const auto& input : inputs) {
-    if (vars.at(input).tag == Binding::TENSOR) {
-      ki.inputs.emplace_back(var_rewrites.Lookup(input));
-    }
-  }
-  for (const auto& op_input : flat.post_op_inputs) {
-    ki.inputs.emplace_back(var_rewrites.Lookup(op_input.name));
-  }
+  ki.inputs = kernel_inputs;
   ki.tot_bytes = perf.work_groups() * ((perf.inner_loops() * perf.mem_read()) + perf.mem_write());
   ki.tot_flops = perf.true_ops();
   *(ki.info.mutable_perf_stats()) = perf;
@@ -228,10 +246,35 @@ static bool SimplifyFlat(FlatContraction* flat) {
   return false;
 }
 
+// A contraction kernel whose tile optimization and code generation has been
+// deferred, so that the kernels of a program can be generated concurrently.
+struct PendingKernel {
+  std::size_t slot;  // The kernel's index in the KernelList.
+  const Contraction* c;
+  FlatContraction flat;
+  std::string kname;
+  std::vector<std::string> inputs;
+  std::vector<std::string> kernel_inputs;
+};
+
+// A kernel that reuses the code generated for an identical earlier kernel,
+// with its own inputs and outputs.
+struct ReusedKernel {
+  std::size_t slot;
+  std::size_t source_slot;
+  std::vector<std::string> kernel_inputs;
+  std::vector<std::string> outputs;
+};
+
+struct PendingKernels {
+  std::vector<PendingKernel> generate;
+  std::vector<ReusedKernel> reuse;
+  std::map<std::string, std::size_t> slots_by_key;
+};
+
 static void ContractionWrap(KernelList& r, const Contraction* c, FlatContraction flat,  // NOLINT(runtime/references)
                             const std::string& kname, const HardwareSettings& settings, const Bindings& vars,
-                            size_t tile_trials, const VarRewrites& var_rewrites, const TileOptimizer& optimizer,
-                            std::map<std::string, KernelInfo>* flat_cache) {
+                            const VarRewrites& var_rewrites, PendingKernels* pending) {
   if (!flat.generate_contraction && !flat.post_ops.size()) {
     // The kernel consists entirely of elided elementwise operations; nothing to do.
     return;
@@ -262,49 +305,120 @@ static void ContractionWrap(KernelList& r, const Contraction* c, FlatContraction
     flat = Vectorize(flat, vec_size);
   }
   std::string flat_key = flat.CacheKeyString(vars);
-  auto it = flat_cache->find(flat_key);
-  if (it != flat_cache->end()) {
+  std::vector<std::string> kernel_inputs = KernelInputs(inputs, flat, vars, var_rewrites);
+  std::size_t slot = r.kernels.size();
+  r.kernels.emplace_back();
+  auto it = pending->slots_by_key.find(flat_key);
+  if (it != pending->slots_by_key.end()) {
     IVLOG(2, "Cache key: " << flat_key << ", Hit!");
-    r.kernels.emplace_back(it->second);
-
-    auto update_kernel_info = [&](KernelInfo& ki) {
-      ki.outputs = flat.kernel_outputs;
-      ki.inputs.clear();
-      for (const auto& input : inputs) {
-        if (vars.at(input).tag == Binding::TENSOR) {
-          ki.inputs.emplace_back(var_rewrites.Lookup(input));
-        }
-      }
-      for (const auto& op_input : flat.post_op_inputs) {
-        ki.inputs.emplace_back(var_rewrites.Lookup(op_input.name));
-      }
-    };
-
-    auto& ki = r.kernels.back();
-    update_kernel_info(ki);
-    for (KernelInfo& candidate : ki.candidates) {
-      update_kernel_info(candidate);
-    }
-
+    pending->reuse.emplace_back(ReusedKernel{slot, it->second, std::move(kernel_inputs), flat.kernel_outputs});
     return;
   }
   IVLOG(2, "Cache key: " << flat_key << ", Miss!");
+  pending->slots_by_key.emplace(flat_key, slot);
+  pending->generate.emplace_back(
+      PendingKernel{slot, c, std::move(flat), kname, std::move(inputs), std::move(kernel_inputs)});
+}
 
-  IVLOG(4, "Optimizing " << kname);
-  auto options = optimizer.OptionsFor(kname, settings, flat, tile_trials);
+// Runs tile optimization and code generation for the pending kernels, filling
+// in their KernelList entries.  Kernels are generated concurrently, but each
+// lands in the slot reserved for it, so the result doesn't depend on timing.
+static void GeneratePending(KernelList* r, const PendingKernels& pending, const HardwareSettings& settings,
+                            const Bindings& vars, size_t tile_trials, const TileOptimizer& optimizer,
+                            std::size_t compile_threads) {
+  ParallelFor(pending.generate.size(), compile_threads, [&](std::size_t idx) {
+    const auto& pk = pending.generate[idx];
+    IVLOG(4, "Optimizing " << pk.kname);
+    auto options = optimizer.OptionsFor(pk.kname, settings, pk.flat, tile_trials);
+    KernelInfo primary;
+    for (size_t i = 0; i < options.size(); i++) {
+      KernelInfo ki =
+          GenerateContractionKernel(pk.kname, settings, pk.c, pk.flat, options[i], pk.inputs, vars, pk.kernel_inputs);
+      if (i == 0) {
+        primary = std::move(ki);
+      } else {
+        primary.candidates.emplace_back(std::move(ki));
+      }
+    }
+    r->kernels[pk.slot] = std::move(primary);
+  });
+
+  for (const auto& reused : pending.reuse) {
+    KernelInfo& ki = r->kernels[reused.slot];
+    ki = r->kernels[reused.source_slot];
+    ki.inputs = reused.kernel_inputs;
+    ki.outputs = reused.outputs;
+    for (KernelInfo& candidate : ki.candidates) {
+      candidate.inputs = reused.kernel_inputs;
+      candidate.outputs = reused.outputs;
+    }
+  }
+}
 
-  KernelInfo primary;
-  for (size_t i = 0; i < options.size(); i++) {
-    const auto& option = options[i];
-    KernelInfo ki = GenerateContractionKernel(kname, settings, c, flat, option, inputs, vars, var_rewrites);
-    if (i == 0) {
-      primary = ki;
-    } else {
-      primary.candidates.push_back(ki);
+// The most elementwise operations fused into a single contraction input.
+// Prologues are recomputed for every element the contraction loads, so only
+// short ones are worth fusing.
+constexpr std::size_t kMaxPrologueOps = 4;
+
+// Checks whether the elementwise operations computing a contraction input can
+// instead be computed as the contraction reads the input, and if so, fills in
+// the prologue.  The operations must compute the input from exactly one
+// tensor, of the same shape, plus constants; their results must not be used
+// anywhere else; and the source must not be produced by a kernel which could
+// have fused the operations as its own output operations instead.
+static bool FindPrologue(const Program& prog, const Bindings& vars, const ShapeMap& outputs, const UseDef& ud,
+                         std::size_t contraction_opidx, const std::string& input, FlatPrologue* prologue) {
+  const auto& dims = vars.at(input).shape.dims;
+  std::set<std::size_t> opidxs;
+  std::set<std::string> seen{input};
+  std::stack<std::string> pending;
+  pending.push(input);
+  std::string source;
+  while (!pending.empty()) {
+    std::string var = std::move(pending.top());
+    pending.pop();
+    const auto& binding = vars.at(var);
+    if (binding.tag != Binding::TENSOR) {
+      continue;
+    }
+    if (binding.shape.dims != dims) {
+      return false;
+    }
+    auto it = ud.op_defs().find(var);
+    const Op* def = it == ud.op_defs().end() ? nullptr : &prog.ops[it->second];
+    bool fusable = def && def->tag == Op::FUNCTION && !def->f.is_special() && def->f.fn != "index" &&
+                   def->f.fn != "reshape" && !outputs.count(var);
+    if (fusable) {
+      opidxs.insert(it->second);
+      for (const auto& in : def->inputs) {
+        if (seen.emplace(in).second) {
+          pending.push(in);
+        }
+      }
+      continue;
+    }
+    // The source is a program input, or the output of a special function.
+    if (var == input || !source.empty() || (def && !(def->tag == Op::FUNCTION && def->f.is_special()))) {
+      return false;
+    }
+    source = var;
+  }
+  if (source.empty() || kMaxPrologueOps < opidxs.size()) {
+    return false;
+  }
+  for (auto opidx : opidxs) {
+    for (auto use_opidx : ud.uses().at(prog.ops[opidx].output)) {
+      if (use_opidx != contraction_opidx && !opidxs.count(use_opidx)) {
+        return false;
+      }
     }
   }
-  flat_cache->emplace(flat_key, primary);
-  r.kernels.emplace_back(std::move(primary));
+  prologue->source = source;
+  prologue->source_type = vars.at(source).shape.type;
+  for (auto opidx : opidxs) {
+    prologue->ops.push_back(prog.ops[opidx]);
+  }
+  return true;
 }
 
 static bool DifferentSize(const Binding& a, const Binding& b) {
@@ -766,7 +880,7 @@ static void DoUnification(FlatContraction* flat, std::set<std::size_t>* computed
 
 static KernelList Compile(const Program& orig_prog, const ShapeMap& inputs, const ShapeMap& outputs,
                           const HardwareSettings& settings, const std::string& kid, size_t tile_trials,
-                          const TileOptimizer& optimizer) {
+                          const TileOptimizer& optimizer, std::size_t compile_threads) {
   IVLOG(2, "Compile");
   KernelList r;
   Program prog = orig_prog;
@@ -784,12 +898,32 @@ static KernelList Compile(const Program& orig_prog, const ShapeMap& inputs, cons
   // (necessary since a given kernel may encompass multiple ops).
   std::set<size_t> computed;
 
+  // Find the elementwise operations which will be fused into the input reads
+  // of later contractions; they're covered by those contractions' kernels.
+  std::map<std::size_t, std::map<std::size_t, FlatPrologue>> prologues;  // By contraction, then access index
+  for (size_t i = 0; i < prog.ops.size(); i++) {
+    const Op& op = prog.ops[i];
+    if (op.tag != Op::CONTRACTION) {
+      continue;
+    }
+    for (size_t idx = 1; idx < op.c.specs.size(); idx++) {
+      FlatPrologue prologue;
+      if (FindPrologue(prog, vars, outputs, ud, i, op.c.specs[idx].id, &prologue)) {
+        IVLOG(3, "Fusing the computation of " << op.c.specs[idx].id << " from " << prologue.source << " into " << op);
+        for (const auto& pre_op : prologue.ops) {
+          computed.insert(ud.op_defs().at(pre_op.output));
+        }
+        prologues[i].emplace(idx, std::move(prologue));
+      }
+    }
+  }
+
   // Now, go over all of the program operations; make a convolution kernel for each convolution, and a function kernel
   // for each group of connected functions.
   size_t knum = 0;
   auto next_kname = [&knum, kid] { return str(boost::format("%s_%zu") % kid % knum++); };
   time_t last_update = time(nullptr);
-  std::map<std::string, KernelInfo> flat_cache;
+  PendingKernels pending;
   for (size_t i = 0; i < prog.ops.size(); i++) {
     if (time(nullptr) - last_update >= 2) {
       LOG(INFO) << "Analyzing Ops: " << i << " of " << prog.ops.size() << " operations complete";
@@ -807,12 +941,23 @@ static KernelList Compile(const Program& orig_prog, const ShapeMap& inputs, cons
       std::vector<Polynomial<Rational>> out_poly;
       FlatContraction flat = Compile(op.c, tshapes, &out_poly);
       flat.output = op.output;
+      auto pit = prologues.find(i);
+      if (pit != prologues.end()) {
+        flat.prologues = pit->second;
+      }
 
       auto kname = next_kname();
       if (NeedsZero(flat, tshapes[0])) {
         // N.B. We currently don't unify kernels with subsequent
         // operations unless they cover the entire output space.
-        if (op.c.use_default != "") {
+        std::vector<std::size_t> order;
+        bool same_default = op.c.use_default == "" || vars.at(op.c.use_default) == Binding(tshapes[0]);
+        if (same_default && OutputIndexOrder(flat, &order)) {
+          // The contraction kernel can find the elements it doesn't compute,
+          // and initialize them itself.
+          flat.init_output = true;
+          flat.init_source = op.c.use_default;
+        } else if (op.c.use_default != "") {
           r.kernels.push_back(GenCopy(tshapes[0], op.output, op.c.use_default, "copy_" + kname));
         } else {
           r.kernels.push_back(GenZero(tshapes[0], op.output, "zero_" + kname));
@@ -821,8 +966,7 @@ static KernelList Compile(const Program& orig_prog, const ShapeMap& inputs, cons
       } else {
         DoUnification(&flat, &computed, &r.var_rewrites, prog, i, ud, vars, inputs, outputs, out_poly, settings);
       }
-      ContractionWrap(r, &op.c, std::move(flat), kname, settings, vars, tile_trials, r.var_rewrites, optimizer,
-                      &flat_cache);
+      ContractionWrap(r, &op.c, std::move(flat), kname, settings, vars, r.var_rewrites, &pending);
       continue;
     }
     // Ignore constants
@@ -873,9 +1017,6 @@ static KernelList Compile(const Program& orig_prog, const ShapeMap& inputs, cons
         dop.f.params.push_back(sout);
         dop.f.params.push_back(vout);
       }
-      if (op.f.fn == "scatter") {
-        r.kernels.push_back(GenZero(vars.at(op.output).shape, op.output, "zero_" + next_kname()));
-      }
       GenSpecial(r, dop, vars, next_kname(), settings);
       continue;
     }
@@ -924,10 +1065,11 @@ static KernelList Compile(const Program& orig_prog, const ShapeMap& inputs, cons
 
     DoUnification(&flat, &computed, &r.var_rewrites, prog, i, ud, vars, inputs, outputs, out_poly, settings);
 
-    ContractionWrap(r, nullptr, std::move(flat), next_kname(), settings, vars, tile_trials, r.var_rewrites, optimizer,
-                    &flat_cache);
+    ContractionWrap(r, nullptr, std::move(flat), next_kname(), settings, vars, r.var_rewrites, &pending);
   }
 
+  GeneratePending(&r, pending, settings, vars, tile_trials, optimizer, compile_threads);
+
   // Copy only the relevant typing info across
   for (const KernelInfo& ki : r.kernels) {
     for (const std::string& s : ki.inputs) {
@@ -942,7 +1084,7 @@ static KernelList Compile(const Program& orig_prog, const ShapeMap& inputs, cons
 
 KernelList GenerateProgram(const Program& prog, const ShapeMap& inputs, const ShapeMap& outputs,
                            const HardwareSettings& settings, const TileOptimizer& optimizer, const std::string& id,
-                           size_t tile_trials) {
+                           size_t tile_trials, std::size_t compile_threads) {
   // The caller can pass whatever it likes as the program ID, but for OpenCL, we require a valid C identifier.  We do
   // this by prefixing the supplied identifier with "kernel_" and translating all non-alnum characters to '_'.
   IVLOG(1, "Doing a compilation of:\n" << to_string(prog) << "\n");
@@ -957,8 +1099,8 @@ KernelList GenerateProgram(const Program& prog, const ShapeMap& inputs, const Sh
 
   // Do the primary compilations
   KernelList result;
-  result = Compile(prog, inputs, outputs, settings, kid, tile_trials, optimizer);
-  Simplify(result.kernels);
+  result = Compile(prog, inputs, outputs, settings, kid, tile_trials, optimizer, compile_threads);
+  Simplify(result.kernels, compile_threads);
   return result;
 }
 
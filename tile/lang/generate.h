@@ -43,8 +43,9 @@ struct HardwareSettings : public DirectSettings {
   // Vector size
   uint64_t vec_size;  // How wide to vectorize data (if possible)
   // Hard limits
-  uint64_t max_mem;   // Maximum local memory in bytes
-  uint64_t max_regs;  // Maximum output register memory in bytes
+  uint64_t max_mem;        // Maximum local memory in bytes
+  uint64_t max_regs;       // Maximum output register memory in bytes
+  uint64_t max_cache = 0;  // Maximum cached input memory in bytes when using global memory (0 = unlimited)
   // Numbers that impact scoring
   uint64_t goal_groups;                           // How many workgroups till we hit full occupancy
   uint64_t goal_flops_per_byte;                   // Where do we hit the ceiling on flops/byte
@@ -142,9 +143,13 @@ class TileOptimizer {
   std::vector<TileCostFunction> models_;
 };
 
+// Generates the kernels for a program.  Kernels are optimized and generated
+// on up to compile_threads threads (zero meaning one per core); the resulting
+// kernel list and kernel names don't depend on the thread count.  Registered
+// tile cost models may therefore be called concurrently.
 KernelList GenerateProgram(const Program& prog, const ShapeMap& inputs, const ShapeMap& outputs,
                            const HardwareSettings& settings, const TileOptimizer& optimizer,
-                           const std::string& id = "no_id", size_t tile_trials = 1);
+                           const std::string& id = "no_id", size_t tile_trials = 1, std::size_t compile_threads = 0);
 
 inline std::string to_string(const KernelInfo& ki) {
   std::ostringstream out;
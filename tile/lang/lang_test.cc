@@ -23,6 +23,7 @@
 
 #include "base/util/catch.h"
 #include "base/util/logging.h"
+#include "base/util/perf_counter.h"
 
 namespace vertexai {
 namespace tile {
@@ -114,6 +115,33 @@ TEST_CASE("Optimization of Matrix Multiply", "[mat_opt][opt]") {
   REQUIRE(it->first == best_score);
 }
 
+TEST_CASE("Optimization keeps global memory tiles in cache", "[mat_opt][opt]") {
+  Parser p;
+  auto c = p.ParseContraction("O[i,j] = +(A[i,k] * B[k,j])");
+  FlatContraction f =
+      Flatten(c, {SimpleShape(DataType::FLOAT32, {1024, 1024}), SimpleShape(DataType::FLOAT32, {1024, 1024}),
+                  SimpleShape(DataType::FLOAT32, {1024, 1024})});
+  HardwareSettings settings;
+  settings.threads = 1;
+  settings.vec_size = 1;
+  settings.use_global = true;
+  settings.mem_width = 64;
+  settings.max_mem = 32 * 1024;
+  settings.max_regs = 256;
+  settings.goal_groups = 1;
+  settings.goal_flops_per_byte = 20;
+
+  auto unbounded = TileOptimize(settings, f, false);
+  REQUIRE(ComputeTileStats(settings, f, unbounded.rbegin()->second).cache_mem() > 16 * 1024);
+
+  settings.max_cache = 16 * 1024;
+  auto bounded = TileOptimize(settings, f, false);
+  auto it = bounded.rbegin();
+  IVLOG(1, "Cache bounded score = " << it->first << " " << it->second);
+  REQUIRE(it->first > 0);
+  REQUIRE(ComputeTileStats(settings, f, it->second).cache_mem() <= settings.max_cache);
+}
+
 TEST_CASE("Subdivision 1D input width 2**n", "[subdivision]") {
   const std::size_t kernelSize = 5;
 
@@ -142,6 +170,33 @@ TEST_CASE("Awkward Flatten") {
   IVLOG(1, "Flat:\n" << f.toString());
 }
 
+TEST_CASE("Compile reuses flattening across tensor names", "[flat_cache]") {
+  Parser p;
+  std::vector<TensorShape> shapes = {
+      SimpleShape(DataType::FLOAT32, {16, 12, 12, 8}),
+      SimpleShape(DataType::FLOAT32, {16, 14, 14, 4}),
+      SimpleShape(DataType::FLOAT32, {3, 3, 4, 8}),
+  };
+  Contraction c1 = p.ParseContraction("O1[n, x, y, co] = +(I1[n, x+i, y+j, ci] * K1[i, j, ci, co])");
+  Contraction c2 = p.ParseContraction("O2[n, x, y, co] = +(I2[n, x+i, y+j, ci] * K2[i, j, ci, co])");
+  std::vector<Polynomial<Rational>> poly1;
+  std::vector<Polynomial<Rational>> poly2;
+  FlatContraction f1 = Compile(c1, shapes, &poly1);
+  int64_t hits = GetPerfCounter("flat_cache_hits");
+  FlatContraction f2 = Compile(c2, shapes, &poly2);
+  REQUIRE(GetPerfCounter("flat_cache_hits") == hits + 1);
+  REQUIRE(f1.TileKeyString() == f2.TileKeyString());
+  REQUIRE((f2.inputs == std::vector<std::string>{"O2", "I2", "K2"}));
+  REQUIRE(f2.comments.find("I1") == std::string::npos);
+  REQUIRE(f2.comments.find("I2") != std::string::npos);
+  REQUIRE(poly1 == poly2);
+
+  shapes[1] = SimpleShape(DataType::FLOAT32, {16, 15, 15, 4});
+  FlatContraction f3 = Compile(c2, shapes);
+  REQUIRE(GetPerfCounter("flat_cache_hits") == hits + 1);
+  REQUIRE(f3.TileKeyString() != f2.TileKeyString());
+}
+
 TEST_CASE("Optimization of Convolution", "[conv_opt][opt]") {
   Parser p;
   auto c = p.ParseContraction("O[n, x, y, co] = +(K[i, j, co, ci] * I[n, x+i, y+j, ci])");
@@ -330,6 +385,41 @@ TEST_CASE("Whole ball of wax", "[emit]") {
   KernelList r = GenerateProgram(prog, inputs, outputs, TestGPU(), optimizer);
 }
 
+TEST_CASE("Parallel kernel generation is deterministic", "[compile]") {
+  Parser p;
+  Program prog = p.Parse(R"(
+    function (A[I, K], B[K, J], C[J, L]) -> (O1, O2, O3) {
+      T1[i, j : I, J] = +(A[i, k] * B[k, j]);
+      O1 = exp(T1);
+      T2[i, l : I, L] = +(T1[i, j] * C[j, l]);
+      O2 = T2 + 1;
+      T3[i, j : I, J] = +(A[i, k] * B[k, j]);
+      O3[i : I] = >(T3[i, j]);
+    }
+  )");
+  ShapeMap inputs;
+  ShapeMap outputs;
+  inputs.emplace("A", SimpleShape(DataType::FLOAT32, {64, 32}));
+  inputs.emplace("B", SimpleShape(DataType::FLOAT32, {32, 48}));
+  inputs.emplace("C", SimpleShape(DataType::FLOAT32, {48, 16}));
+  outputs.emplace("O1", SimpleShape(DataType::FLOAT32, {64, 48}));
+  outputs.emplace("O2", SimpleShape(DataType::FLOAT32, {64, 16}));
+  outputs.emplace("O3", SimpleShape(DataType::FLOAT32, {64}));
+  TileOptimizer optimizer;
+  KernelList serial = GenerateProgram(prog, inputs, outputs, TestGPU(), optimizer, "ID", 3, 1);
+  KernelList parallel = GenerateProgram(prog, inputs, outputs, TestGPU(), optimizer, "ID", 3, 8);
+  REQUIRE(serial.kernels.size() == parallel.kernels.size());
+  for (std::size_t idx = 0; idx < serial.kernels.size(); ++idx) {
+    const auto& expected = serial.kernels[idx];
+    const auto& actual = parallel.kernels[idx];
+    REQUIRE(expected.kname == actual.kname);
+    REQUIRE(expected.inputs == actual.inputs);
+    REQUIRE(expected.outputs == actual.outputs);
+    REQUIRE(expected.candidates.size() == actual.candidates.size());
+    REQUIRE(sem::Print(*expected.kfunc).str() == sem::Print(*actual.kfunc).str());
+  }
+}
+
 TEST_CASE("Two outputs", "[multiout]") {
   Parser p;
   Program prog = p.Parse("function (I[N]) -> (O1, O2) { O1 = I; O2 = I; }");
@@ -811,6 +901,93 @@ TEST_CASE("CombineConvolutionAndRelu", "[emit]") {
   REQUIRE(klist.kernels.size() == 1);
 }
 
+TEST_CASE("CombineScaleShiftAndConvolution", "[emit]") {
+  Parser parser;
+  Program prog = parser.Parse(
+      "function (B[X,Y], C[Y,Z]) -> (A) { "
+      "  S = 0.5 * B + 1; "
+      "  M = (S < 0 ? 0 : S); "
+      "  A[x,z:X,Z] = +(M[x,y] * C[y,z]); "
+      "}");
+  ShapeMap inputs;
+  inputs.emplace("B", SimpleShape(DataType::FLOAT32, {10, 10}));
+  inputs.emplace("C", SimpleShape(DataType::FLOAT32, {10, 10}));
+  ShapeMap outputs;
+  outputs.emplace("A", SimpleShape(DataType::FLOAT32, {10, 10}));
+  TileOptimizer optimizer;
+  auto klist = GenerateProgram(prog, inputs, outputs, TestGPU(), optimizer, "ID");
+  if (VLOG_IS_ON(1)) {
+    for (const auto& kinfo : klist.kernels) {
+      sem::Print emit(*kinfo.kfunc);
+      VLOG(1) << "Got kernel: " << emit.str();
+    }
+  }
+  REQUIRE(klist.kernels.size() == 1);
+  REQUIRE(klist.kernels[0].inputs == std::vector<std::string>({"B", "C"}));
+}
+
+TEST_CASE("Shared elementwise producers are not fused", "[emit]") {
+  Parser parser;
+  Program prog = parser.Parse(
+      "function (B[X,Y], C[Y,Z]) -> (A, S) { "
+      "  S = 0.5 * B; "
+      "  A[x,z:X,Z] = +(S[x,y] * C[y,z]); "
+      "}");
+  ShapeMap inputs;
+  inputs.emplace("B", SimpleShape(DataType::FLOAT32, {10, 10}));
+  inputs.emplace("C", SimpleShape(DataType::FLOAT32, {10, 10}));
+  ShapeMap outputs;
+  outputs.emplace("A", SimpleShape(DataType::FLOAT32, {10, 10}));
+  outputs.emplace("S", SimpleShape(DataType::FLOAT32, {10, 10}));
+  TileOptimizer optimizer;
+  auto klist = GenerateProgram(prog, inputs, outputs, TestGPU(), optimizer, "ID");
+  REQUIRE(klist.kernels.size() == 2);
+}
+
+TEST_CASE("Padded contractions initialize their own outputs", "[emit]") {
+  Parser parser;
+  Program prog = parser.Parse(
+      "function (B[X,Y], C[Y,Z]) -> (A) { "
+      "  A[x + 1, z + 1 : X + 2, Z + 2] = +(B[x,y] * C[y,z]); "
+      "}");
+  ShapeMap inputs;
+  inputs.emplace("B", SimpleShape(DataType::FLOAT32, {10, 10}));
+  inputs.emplace("C", SimpleShape(DataType::FLOAT32, {10, 10}));
+  ShapeMap outputs;
+  outputs.emplace("A", SimpleShape(DataType::FLOAT32, {12, 12}));
+  TileOptimizer optimizer;
+  auto klist = GenerateProgram(prog, inputs, outputs, TestGPU(), optimizer, "ID");
+  if (VLOG_IS_ON(1)) {
+    for (const auto& kinfo : klist.kernels) {
+      sem::Print emit(*kinfo.kfunc);
+      VLOG(1) << "Got kernel: " << emit.str();
+    }
+  }
+  REQUIRE(klist.kernels.size() == 1);
+  REQUIRE(klist.kernels[0].ktype == KernelType::kFunction);
+  // The kernel strides over all 144 elements of A, zeroing the ones it
+  // doesn't compute.
+  std::string code = sem::Print(*klist.kernels[0].kfunc).str();
+  REQUIRE(code.find("init_base") != std::string::npos);
+  REQUIRE(code.find("144") != std::string::npos);
+}
+
+TEST_CASE("Scatter zeroes its own output", "[emit]") {
+  Parser parser;
+  Program prog = parser.Parse("function (E[N, C], I[N], V[M, C]) -> (O) { O = scatter(E, I, V); }");
+  ShapeMap inputs;
+  inputs.emplace("E", SimpleShape(DataType::FLOAT32, {3, 2}));
+  inputs.emplace("I", SimpleShape(DataType::INT32, {3}));
+  inputs.emplace("V", SimpleShape(DataType::FLOAT32, {4, 2}));
+  ShapeMap outputs;
+  outputs.emplace("O", SimpleShape(DataType::FLOAT32, {4, 2}));
+  TileOptimizer optimizer;
+  auto klist = GenerateProgram(prog, inputs, outputs, TestGPU(), optimizer, "ID");
+  REQUIRE(klist.kernels.size() == 1);
+  std::string code = sem::Print(*klist.kernels[0].kfunc).str();
+  REQUIRE(code.find("col_offset") != std::string::npos);
+}
+
 TEST_CASE("Tupleism", "[tuple]") {
   Parser parser;
   Program prog = parser.Parse(R"***(
@@ -175,7 +175,7 @@ sem::ExprPtr ReadPlan::globalOffset() const {
 }
 
 sem::StmtPtr ReadPlan::generate(const std::string& to, const std::string& from, uint64_t threads, uint64_t limit,
-                                uint64_t offset) const {
+                                uint64_t offset, const std::function<sem::ExprPtr(const sem::ExprPtr&)>& load) const {
   using namespace sem::builder;  // NOLINT
   LoopInfo loop;
   sem::ExprPtr lidx = _Const(0);
@@ -189,7 +189,11 @@ sem::StmtPtr ReadPlan::generate(const std::string& to, const std::string& from,
   auto b2 = _Block({});
   b2->append(_Declare({sem::Type::INDEX}, "lidx", lidx));
   b2->append(_Declare({sem::Type::INDEX}, "gidx", gidx));
-  sem::StmtPtr assign = (_(to)[_("lidx")] = _(from)[_Clamp(_("gidx"), _Const(-offset), _Const(limit - offset - 1))]);
+  sem::ExprPtr value = _(from)[_Clamp(_("gidx"), _Const(-offset), _Const(limit - offset - 1))];
+  if (load) {
+    value = load(value);
+  }
+  sem::StmtPtr assign = (_(to)[_("lidx")] = value);
   b2->append(assign);
   loop.inner = b2;
   loop.thread(threads);
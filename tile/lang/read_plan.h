@@ -2,6 +2,7 @@
 
 #include <algorithm>
 #include <array>
+#include <functional>
 #include <string>
 #include <vector>
 
@@ -56,12 +57,14 @@ class ReadPlan {
   sem::ExprPtr sharedOffset() const;
   // Compute the global load expression
   sem::ExprPtr globalOffset() const;
-  // New version of transfer code generation
+  // New version of transfer code generation.  If supplied, load computes the
+  // value stored to shared memory from the value read from global memory.
   sem::StmtPtr generate(const std::string& to,    //
                         const std::string& from,  //
                         uint64_t threads,         //
                         uint64_t limit,           //
-                        uint64_t offset) const;
+                        uint64_t offset,          //
+                        const std::function<sem::ExprPtr(const sem::ExprPtr&)>& load = nullptr) const;
 
  private:
   uint64_t mem_width_;               // The minimum read size (due to cache, etc)
@@ -307,6 +307,77 @@ TEST_CASE("Example function used in conv2d", "[conv2d][keras]") {
   }
 }
 
+TEST_CASE("Padded output initialized by the contraction", "[simulate][init]") {
+  Parser p;
+  auto c = p.ParseContraction("O[x + 1, y + 1 : 4, 5] = +(A[x, k] * B[k, y])");
+  Tensor<float, 2> O(boost::extents[4][5]);
+  Tensor<float, 2> D(boost::extents[4][5]);
+  Tensor<float, 2> A(boost::extents[2][3]);
+  Tensor<float, 2> B(boost::extents[3][3]);
+  for (size_t i = 0; i < 4 * 5; i++) {
+    O.origin()[i] = -1;  // Garbage, which must all be overwritten
+    D.origin()[i] = 100 + i;
+  }
+  for (size_t i = 0; i < 2 * 3; i++) {
+    A.origin()[i] = i + 1;
+  }
+  for (size_t i = 0; i < 3 * 3; i++) {
+    B.origin()[i] = i + 1;
+  }
+  std::vector<TensorShape> shapes = {ShapeOf(O), ShapeOf(A), ShapeOf(B)};
+  FlatContraction fc = Compile(c, shapes);
+  REQUIRE(fc.access[0].offset == 6);
+  fc.init_output = true;
+  fc.init_source = "D";
+  ExecuteInit(fc, O, A, B, &D);
+  for (size_t i = 0; i < 4; i++) {
+    for (size_t j = 0; j < 5; j++) {
+      float expected = D[i][j];
+      if (1 <= i && i < 3 && 1 <= j && j < 4) {
+        expected = 0;
+        for (size_t k = 0; k < 3; k++) {
+          expected += A[i - 1][k] * B[k][j - 1];
+        }
+      }
+      IVLOG(3, O[i][j] << " vs " << expected);
+      REQUIRE(O[i][j] == expected);
+    }
+  }
+}
+
+TEST_CASE("Constrained output initialized by the contraction", "[simulate][init]") {
+  Parser p;
+  auto c = p.ParseContraction("O[i, j] = +(A[i, k] * B[k, j]), i + j < 3");
+  Tensor<float, 2> O(boost::extents[3][4]);
+  Tensor<float, 2> A(boost::extents[3][2]);
+  Tensor<float, 2> B(boost::extents[2][4]);
+  for (size_t i = 0; i < 3 * 4; i++) {
+    O.origin()[i] = -1;  // Garbage, which must all be overwritten
+  }
+  for (size_t i = 0; i < 3 * 2; i++) {
+    A.origin()[i] = i + 1;
+  }
+  for (size_t i = 0; i < 2 * 4; i++) {
+    B.origin()[i] = i + 1;
+  }
+  std::vector<TensorShape> shapes = {ShapeOf(O), ShapeOf(A), ShapeOf(B)};
+  FlatContraction fc = Compile(c, shapes);
+  fc.init_output = true;
+  ExecuteInit(fc, O, A, B, static_cast<const Tensor<float, 2>*>(nullptr));
+  for (size_t i = 0; i < 3; i++) {
+    for (size_t j = 0; j < 4; j++) {
+      float expected = 0;
+      if (i + j < 3) {
+        for (size_t k = 0; k < 2; k++) {
+          expected += A[i][k] * B[k][j];
+        }
+      }
+      IVLOG(3, O[i][j] << " vs " << expected);
+      REQUIRE(O[i][j] == expected);
+    }
+  }
+}
+
 }  // namespace lang
 }  // namespace tile
 }  // namespace vertexai
@@ -1,5 +1,8 @@
 #include "tile/lang/simplifier.h"
 
+#include <set>
+
+#include "tile/base/parallel_for.h"
 #include "tile/lang/scope.h"
 #include "tile/lang/sembuilder.h"
 #include "tile/lang/semprinter.h"
@@ -450,8 +453,18 @@ class Simplifier : public Visitor {
 }  // namespace sem
 
 namespace lang {
-void Simplify(const std::vector<KernelInfo>& kernels) {
+void Simplify(const std::vector<KernelInfo>& kernels, std::size_t threads) {
+  // Kernels reused for identical contractions share their function; each
+  // function is simplified exactly once.
+  std::vector<const KernelInfo*> unique;
+  std::set<const sem::Function*> seen;
   for (const auto& ki : kernels) {
+    if (seen.insert(ki.kfunc.get()).second) {
+      unique.push_back(&ki);
+    }
+  }
+  ParallelFor(unique.size(), threads, [&](std::size_t idx) {
+    const auto& ki = *unique[idx];
     if (VLOG_IS_ON(4)) {
       sem::Print emit_debug(*ki.kfunc);
       VLOG(4) << "Generic debug kernel before simplification:";
@@ -468,7 +481,7 @@ void Simplify(const std::vector<KernelInfo>& kernels) {
       sem::Simplifier simplifier{&scope};
       candidate.kfunc->Accept(simplifier);
     }
-  }
+  });
 }
 
 }  // namespace lang
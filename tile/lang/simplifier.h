@@ -1,5 +1,6 @@
 #pragma once
 
+#include <cstddef>
 #include <vector>
 
 #include "tile/lang/generate.h"
@@ -8,7 +9,9 @@ namespace vertexai {
 namespace tile {
 namespace lang {
 
-void Simplify(const std::vector<KernelInfo>& kernels);
+// Simplifies the kernel functions of the supplied kernels (and their tile
+// candidates), using up to `threads` threads (zero meaning one per core).
+void Simplify(const std::vector<KernelInfo>& kernels, std::size_t threads = 1);
 
 }  // namespace lang
 }  // namespace tile
@@ -2,6 +2,7 @@
 
 #include <algorithm>
 #include <map>
+#include <stdexcept>
 #include <string>
 #include <utility>
 #include <vector>
@@ -122,6 +123,61 @@ void Execute(const FlatContraction& f, Tensor<T1, D1>& out, const Tensor<T2, D2>
                                 0);
 }
 
+// Determines whether a kernel for a contraction with init_output computes the
+// output element at the given position (relative to the output offset), the
+// same way the kernel does: by decomposing the position over the output
+// strides, and checking the output-only constraints.
+inline bool OutputComputed(const FlatContraction& f, const std::vector<std::size_t>& order, int64_t rel) {
+  std::vector<int64_t> vars(f.ranges.size());
+  for (auto i : order) {
+    vars[i] = rel / f.access[0].strides[i];
+    rel -= vars[i] * f.access[0].strides[i];
+    if (vars[i] < 0 || vars[i] >= static_cast<int64_t>(f.ranges[i])) {
+      return false;
+    }
+  }
+  if (rel != 0) {
+    return false;
+  }
+  for (const FlatConstraint& fc : f.constraints) {
+    int64_t tot = 0;
+    bool only_output = true;
+    for (size_t i = 0; i < fc.lhs.size(); i++) {
+      if (fc.lhs[i] != 0 && f.access[0].strides[i] == 0) {
+        only_output = false;
+        break;
+      }
+      tot += fc.lhs[i] * vars[i];
+    }
+    if (only_output && tot > fc.rhs) {
+      return false;
+    }
+  }
+  return true;
+}
+
+// Simulates a kernel for a contraction with init_output: the elements it
+// computes are overwritten with the contraction's results, and the rest are
+// copied from init, or zeroed if init is null.
+template <typename T1, typename T2, typename T3, size_t D1, size_t D2, size_t D3>
+void ExecuteInit(const FlatContraction& f, Tensor<T1, D1>& out,  // NOLINT(runtime/references)
+                 const Tensor<T2, D2>& in1, const Tensor<T3, D3>& in2, const Tensor<T1, D1>* init) {
+  std::vector<std::size_t> order;
+  if (!f.init_output || !OutputIndexOrder(f, &order)) {
+    throw std::runtime_error("Contraction doesn't initialize its output");
+  }
+  Tensor<T1, D1> computed(out);
+  std::fill(computed.origin(), computed.origin() + computed.num_elements(), T1());
+  Execute(f, computed, in1, in2);
+  for (int64_t idx = 0; idx < static_cast<int64_t>(out.num_elements()); idx++) {
+    if (OutputComputed(f, order, idx - f.access[0].offset)) {
+      out.origin()[idx] = computed.origin()[idx];
+    } else {
+      out.origin()[idx] = init ? init->origin()[idx] : T1();
+    }
+  }
+}
+
 }  // namespace lang
 }  // namespace tile
 }  // namespace vertexai
@@ -1,35 +1,113 @@
 
 #include "tile/lang/tile_cache.h"
 
+#include <cstring>
+
+#include <boost/filesystem.hpp>
+#include <boost/interprocess/file_mapping.hpp>
+#include <boost/interprocess/mapped_region.hpp>
+#include <boost/interprocess/sync/file_lock.hpp>
+#include <boost/interprocess/sync/scoped_lock.hpp>
+
 #include "base/util/env.h"
 #include "base/util/json_transfer.h"
+#include "base/util/logging.h"
+#include "tile/lang/fnv1a64.h"
+
+namespace bi = boost::interprocess;
+namespace fs = boost::filesystem;
 
 namespace vertexai {
 namespace tile {
 namespace lang {
+namespace {
+
+// The binary file format is a header followed by a sequence of records.  Each
+// record is a magic number, the payload length, an FNV-1a checksum of the
+// payload, and the payload itself.  Values are stored in host byte order.
+const char kHeader[8] = {'P', 'M', 'L', 'T', 'C', 'v', '1', '\n'};
+const uint32_t kRecordMagic = 0x52435450;  // "PTCR"
+
+struct RecordHeader {
+  uint32_t magic;
+  uint32_t length;
+  uint64_t checksum;
+};
+
+uint64_t Checksum(const char* data, std::size_t size) {
+  uint64_t hash = fnv1a64::basis;
+  for (std::size_t i = 0; i < size; ++i) {
+    hash ^= static_cast<unsigned char>(data[i]);
+    hash *= fnv1a64::prime;
+  }
+  return hash;
+}
+
+template <typename T>
+void Put(std::string* out, T value) {
+  out->append(reinterpret_cast<const char*>(&value), sizeof(value));
+}
+
+void PutString(std::string* out, const std::string& value) {
+  Put<uint32_t>(out, value.size());
+  out->append(value);
+}
+
+// Reads fields from a record payload, failing (rather than reading past the
+// end) on truncated data.
+class Reader {
+ public:
+  Reader(const char* data, std::size_t size) : cur_{data}, end_{data + size} {}
+
+  template <typename T>
+  bool Get(T* value) {
+    if (static_cast<std::size_t>(end_ - cur_) < sizeof(T)) {
+      return false;
+    }
+    std::memcpy(value, cur_, sizeof(T));
+    cur_ += sizeof(T);
+    return true;
+  }
+
+  bool GetString(std::string* value) {
+    uint32_t size;
+    if (!Get(&size) || static_cast<std::size_t>(end_ - cur_) < size) {
+      return false;
+    }
+    value->assign(cur_, size);
+    cur_ += size;
+    return true;
+  }
+
+ private:
+  const char* cur_;
+  const char* end_;
+};
 
-TileCache::TileCache(const std::string& filename, bool use_env) {
-  std::string openname = filename;
-  if (filename == "") {
+}  // namespace
+
+TileCache::TileCache(const std::string& filename, bool use_env) : filename_{filename} {
+  if (filename_ == "") {
     if (!use_env) {
       return;
     }
-    openname = env::Get("PLAIDML_TILE_CACHE");
-    if (!openname.length()) {
+    filename_ = env::Get("PLAIDML_TILE_CACHE");
+    if (!filename_.length()) {
       return;
     }
   }
-  file_.exceptions(std::fstream::failbit | std::fstream::badbit);
-  file_.open(openname, std::fstream::in | std::fstream::out | std::fstream::app);
-  file_.seekp(0);
-  std::string line;
-  file_.exceptions(std::fstream::badbit);
-  while (std::getline(file_, line)) {
-    Entry e = inline_json_deserialize<Entry>(line);
-    AddEntry(e.key, e.subkey, e.value);
+  file_.exceptions(std::ofstream::failbit | std::ofstream::badbit);
+  file_.open(filename_, std::ofstream::out | std::ofstream::app | std::ofstream::binary);
+  {
+    bi::file_lock flock{filename_.c_str()};
+    bi::scoped_lock<bi::file_lock> guard{flock};
+    Load();
+  }
+  if (legacy_) {
+    LOG(WARNING) << "Tile cache " << filename_ << " is in the legacy JSON format; new entries will not be saved. "
+                 << "Compact it with tile_cache_tool to convert it.";
+    file_.close();
   }
-  file_.clear();
-  file_.exceptions(std::fstream::failbit | std::fstream::badbit);
 }
 
 TileCache* TileCache::Instance() {
@@ -37,25 +115,27 @@ TileCache* TileCache::Instance() {
   return &instance;
 }
 
-void TileCache::AddEntry(const std::string& key, const DirectSettings& settings, const std::vector<uint64_t>& tile_size,
-                         int64_t dur) {
-  Entry e;
-  e.key = key;
-  e.subkey = Subkey(settings, tile_size);
-  e.value = dur;
-  AddEntry(key, e.subkey, dur);
+void TileCache::AddEntry(const std::string& device, const std::string& key, const DirectSettings& settings,
+                         const std::vector<uint64_t>& tile_size, int64_t dur) {
+  FCKey fckey{device, key};
+  Subkey subkey(settings, tile_size);
+  std::lock_guard<std::mutex> lock{mu_};
+  AddEntry(fckey, subkey, dur);
   if (file_.is_open()) {
-    std::string row = json_serialize(e);
-    file_.write(row.data(), row.size());
-    file_.flush();
+    Append(Record(fckey, subkey, dur));
   }
 }
 
-int64_t TileCache::GetDuration(const std::string& key, const DirectSettings& settings,
+int64_t TileCache::GetDuration(const std::string& device, const std::string& key, const DirectSettings& settings,
                                const std::vector<uint64_t>& tile_size) {
-  auto it = cache_.find(key);
+  std::lock_guard<std::mutex> lock{mu_};
+  auto it = cache_.find(FCKey{device, key});
   if (it == cache_.end()) {
-    return -1;
+    // Entries loaded from legacy files aren't scoped to a device.
+    it = cache_.find(FCKey{"", key});
+    if (it == cache_.end()) {
+      return -1;
+    }
   }
   auto it2 = it->second.times.find(Subkey(settings, tile_size));
   if (it2 == it->second.times.end()) {
@@ -64,7 +144,66 @@ int64_t TileCache::GetDuration(const std::string& key, const DirectSettings& set
   return it2->second;
 }
 
-void TileCache::AddEntry(const std::string& key, const Subkey& subkey, int64_t dur) {
+void TileCache::Compact() {
+  std::lock_guard<std::mutex> lock{mu_};
+  if (filename_.empty()) {
+    return;
+  }
+  bi::file_lock flock{filename_.c_str()};
+  bi::scoped_lock<bi::file_lock> guard{flock};
+
+  // Pick up anything other processes have appended since we loaded.
+  if (!legacy_) {
+    Load();
+  }
+
+  std::string tmpname = filename_ + ".tmp";
+  {
+    std::ofstream out;
+    out.exceptions(std::ofstream::failbit | std::ofstream::badbit);
+    out.open(tmpname, std::ofstream::out | std::ofstream::trunc | std::ofstream::binary);
+    out.write(kHeader, sizeof(kHeader));
+    for (const auto& kvp : cache_) {
+      for (const auto& time : kvp.second.times) {
+        std::string record = Record(kvp.first, time.first, time.second);
+        out.write(record.data(), record.size());
+      }
+    }
+  }
+  if (file_.is_open()) {
+    file_.close();
+  }
+  fs::rename(tmpname, filename_);
+  legacy_ = false;
+  file_.open(filename_, std::ofstream::out | std::ofstream::app | std::ofstream::binary);
+}
+
+void TileCache::Dump(std::ostream& os) {
+  std::lock_guard<std::mutex> lock{mu_};
+  for (const auto& kvp : cache_) {
+    for (const auto& time : kvp.second.times) {
+      const auto& settings = time.first.settings;
+      os << "device=" << kvp.first.first << " key=" << kvp.first.second << " threads=" << settings.threads
+         << " use_global=" << settings.use_global << " mem_width=" << settings.mem_width << " tile=[";
+      for (std::size_t i = 0; i < time.first.tile_size.size(); ++i) {
+        os << (i ? ", " : "") << time.first.tile_size[i];
+      }
+      os << "] duration=" << time.second << (kvp.second.best.tile_size == time.first.tile_size ? " (best)" : "")
+         << "\n";
+    }
+  }
+}
+
+std::size_t TileCache::size() {
+  std::lock_guard<std::mutex> lock{mu_};
+  std::size_t result = 0;
+  for (const auto& kvp : cache_) {
+    result += kvp.second.times.size();
+  }
+  return result;
+}
+
+void TileCache::AddEntry(const FCKey& key, const Subkey& subkey, int64_t dur) {
   PerFC& p = cache_[key];
   p.times[subkey] = dur;
   if (p.times.size() == 1 || p.times[p.best] > dur) {
@@ -72,6 +211,147 @@ void TileCache::AddEntry(const std::string& key, const Subkey& subkey, int64_t d
   }
 }
 
+void TileCache::Load() {
+  // N.B. The caller holds the file lock.
+  auto size = fs::file_size(filename_);
+  if (!size) {
+    file_.write(kHeader, sizeof(kHeader));
+    file_.flush();
+    return;
+  }
+  std::size_t good_size;
+  {
+    bi::file_mapping mapping{filename_.c_str(), bi::read_only};
+    bi::mapped_region region{mapping, bi::read_only, 0, static_cast<std::size_t>(size)};
+    const char* data = static_cast<const char*>(region.get_address());
+    if (size < sizeof(kHeader) || std::memcmp(data, kHeader, sizeof(kHeader))) {
+      legacy_ = true;
+      LoadLegacy();
+      return;
+    }
+    good_size = sizeof(kHeader) + LoadBinary(data + sizeof(kHeader), size - sizeof(kHeader));
+  }
+  if (good_size < size) {
+    // Drop the torn write at the end of the file, so that records appended
+    // from now on directly follow the last good one.
+    LOG(WARNING) << "Discarding corrupt or truncated records at the end of tile cache " << filename_;
+    fs::resize_file(filename_, good_size);
+  }
+}
+
+std::size_t TileCache::LoadBinary(const char* data, std::size_t size) {
+  // A process that crashed mid-write leaves a torn record, which may be
+  // followed by records appended later; on a bad record, resynchronize on the
+  // next record magic number.
+  const char* begin = data;
+  const char* end = data + size;
+  const char* good_end = data;
+  bool resynced = false;
+  while (data < end) {
+    const char* next = LoadRecord(data, end);
+    if (next) {
+      data = next;
+      good_end = next;
+      continue;
+    }
+    resynced = true;
+    for (++data; data < end; ++data) {
+      uint32_t magic;
+      if (static_cast<std::size_t>(end - data) < sizeof(magic)) {
+        data = end;
+        break;
+      }
+      std::memcpy(&magic, data, sizeof(magic));
+      if (magic == kRecordMagic) {
+        break;
+      }
+    }
+  }
+  if (resynced && good_end != end) {
+    return good_end - begin;
+  }
+  if (resynced) {
+    LOG(WARNING) << "Skipped corrupt records in tile cache " << filename_;
+  }
+  return size;
+}
+
+const char* TileCache::LoadRecord(const char* data, const char* end) {
+  RecordHeader header;
+  if (static_cast<std::size_t>(end - data) < sizeof(header)) {
+    return nullptr;
+  }
+  std::memcpy(&header, data, sizeof(header));
+  data += sizeof(header);
+  if (header.magic != kRecordMagic || static_cast<std::size_t>(end - data) < header.length ||
+      Checksum(data, header.length) != header.checksum) {
+    return nullptr;
+  }
+  Reader reader{data, header.length};
+
+  FCKey key;
+  Subkey subkey;
+  uint8_t use_global;
+  uint32_t dims;
+  int64_t dur;
+  if (!reader.GetString(&key.first) || !reader.GetString(&key.second) || !reader.Get(&subkey.settings.threads) ||
+      !reader.Get(&use_global) || !reader.Get(&subkey.settings.mem_width) || !reader.Get(&dims)) {
+    return nullptr;
+  }
+  subkey.settings.use_global = use_global;
+  subkey.tile_size.resize(dims);
+  for (auto& dim : subkey.tile_size) {
+    if (!reader.Get(&dim)) {
+      return nullptr;
+    }
+  }
+  if (!reader.Get(&dur)) {
+    return nullptr;
+  }
+  AddEntry(key, subkey, dur);
+  return data + header.length;
+}
+
+void TileCache::LoadLegacy() {
+  std::ifstream in;
+  in.exceptions(std::ifstream::badbit);
+  in.open(filename_);
+  std::string line;
+  while (std::getline(in, line)) {
+    Entry e = inline_json_deserialize<Entry>(line);
+    AddEntry(FCKey{"", e.key}, e.subkey, e.value);
+  }
+}
+
+void TileCache::Append(const std::string& record) {
+  // The record goes out in a single write to a file opened for appending,
+  // under an advisory lock, so records from concurrent processes never
+  // interleave.
+  bi::file_lock flock{filename_.c_str()};
+  bi::scoped_lock<bi::file_lock> guard{flock};
+  file_.write(record.data(), record.size());
+  file_.flush();
+}
+
+std::string TileCache::Record(const FCKey& key, const Subkey& subkey, int64_t dur) {
+  std::string payload;
+  PutString(&payload, key.first);
+  PutString(&payload, key.second);
+  Put<uint64_t>(&payload, subkey.settings.threads);
+  Put<uint8_t>(&payload, subkey.settings.use_global);
+  Put<uint64_t>(&payload, subkey.settings.mem_width);
+  Put<uint32_t>(&payload, subkey.tile_size.size());
+  for (auto dim : subkey.tile_size) {
+    Put<uint64_t>(&payload, dim);
+  }
+  Put<int64_t>(&payload, dur);
+
+  RecordHeader header{kRecordMagic, static_cast<uint32_t>(payload.size()), Checksum(payload.data(), payload.size())};
+  std::string record(reinterpret_cast<const char*>(&header), sizeof(header));
+  record.append(payload);
+  return record;
+}
+
 TileCache::Subkey::Subkey(const DirectSettings& _settings, const std::vector<uint64_t>& _tile_size)
     : settings(_settings), tile_size(_tile_size) {}
 
@@ -1,10 +1,12 @@
-
 #pragma once
 
 #include <fstream>
 #include <limits>
 #include <map>
+#include <mutex>
+#include <ostream>
 #include <string>
+#include <utility>
 #include <vector>
 
 #include "base/util/transfer_object.h"
@@ -14,17 +16,39 @@ namespace vertexai {
 namespace tile {
 namespace lang {
 
+// TileCache records measured kernel durations per tile size, so that repeated
+// tile scans can skip kernels that have already been timed.  Entries are
+// scoped to a device fingerprint, since timings don't transfer between
+// devices or driver versions.
+//
+// The cache is internally synchronized.  When backed by a file, the file is
+// memory-mapped and scanned once at startup, and each new entry is appended as
+// a single checksummed binary record under an advisory file lock, so several
+// processes may share one cache file.  Files written in the older JSON-lines
+// format are still loaded, but are not appended to; compacting such a file
+// rewrites it in the binary format.
 class TileCache {
  public:
   // Construct a cache, if given a filename, use that for storage
   explicit TileCache(const std::string& filename = "", bool use_env = false);
+
   // Get the 'singlton' instance, loads for PLAIDML_TILE_CACHE if set
   static TileCache* Instance();
   // Add a new entry with a duration
-  void AddEntry(const std::string& key, const DirectSettings& settings, const std::vector<uint64_t>& tile_size,
-                int64_t dur);
+  void AddEntry(const std::string& device, const std::string& key, const DirectSettings& settings,
+                const std::vector<uint64_t>& tile_size, int64_t dur);
   // Checks for an exact matching entry (to skip tile scan for repeats), or -1 if not found
-  int64_t GetDuration(const std::string& key, const DirectSettings& settings, const std::vector<uint64_t>& tile_size);
+  int64_t GetDuration(const std::string& device, const std::string& key, const DirectSettings& settings,
+                      const std::vector<uint64_t>& tile_size);
+  // Rewrites the backing file in the binary format, keeping only the latest
+  // duration of each entry.  Entries appended concurrently by other processes
+  // while the file is being rewritten may be lost, so this is intended for
+  // offline use (see tile_cache_tool).
+  void Compact();
+  // Writes a human-readable listing of the cache to the stream.
+  void Dump(std::ostream& os);  // NOLINT(runtime/references)
+  // Returns the number of entries.
+  std::size_t size();
 
  private:
   struct Subkey {
@@ -42,6 +66,7 @@ class TileCache {
     }
   };
 
+  // The legacy JSON-lines entry format.
   struct Entry {
     std::string key;
     TileCache::Subkey subkey;
@@ -60,11 +85,26 @@ class TileCache {
     std::map<Subkey, int64_t> times;
   };
 
-  void AddEntry(const std::string& key, const Subkey& subkey, int64_t dur);
+  // Cache entries are keyed by (device fingerprint, kernel key).
+  typedef std::pair<std::string, std::string> FCKey;
+
+  void AddEntry(const FCKey& key, const Subkey& subkey, int64_t dur);
+  void Load();
+  // Loads the records in data, returning the size of the prefix that ends
+  // with the last good record.
+  std::size_t LoadBinary(const char* data, std::size_t size);
+  // Loads the record at data, returning its end, or nullptr if it's corrupt.
+  const char* LoadRecord(const char* data, const char* end);
+  void LoadLegacy();
+  void Append(const std::string& record);
 
-  std::map<const std::string, PerFC> cache_;
+  static std::string Record(const FCKey& key, const Subkey& subkey, int64_t dur);
 
-  std::fstream file_;
+  std::mutex mu_;
+  std::map<FCKey, PerFC> cache_;
+  std::string filename_;
+  std::ofstream file_;
+  bool legacy_ = false;
 };
 
 }  // namespace lang
@@ -0,0 +1,123 @@
+#include <fstream>
+#include <iterator>
+#include <string>
+
+#include <boost/filesystem.hpp>
+
+#include "base/util/catch.h"
+#include "tile/lang/tile_cache.h"
+
+namespace fs = boost::filesystem;
+
+namespace vertexai {
+namespace tile {
+namespace lang {
+
+namespace {
+
+DirectSettings MakeSettings(uint64_t threads) {
+  DirectSettings settings;
+  settings.threads = threads;
+  settings.use_global = false;
+  settings.mem_width = 64;
+  return settings;
+}
+
+}  // namespace
+
+TEST_CASE("TileCache persists entries per device", "[tile_cache]") {
+  fs::path path = fs::temp_directory_path() / fs::unique_path("tile_cache_%%%%-%%%%.bin");
+  {
+    TileCache cache{path.string()};
+    cache.AddEntry("dev0", "k", MakeSettings(64), {4, 8}, 100);
+    cache.AddEntry("dev0", "k", MakeSettings(64), {8, 8}, 50);
+    cache.AddEntry("dev1", "k", MakeSettings(64), {4, 8}, 200);
+    REQUIRE(cache.GetDuration("dev0", "k", MakeSettings(64), {4, 8}) == 100);
+  }
+  {
+    TileCache cache{path.string()};
+    REQUIRE(cache.size() == 3);
+    REQUIRE(cache.GetDuration("dev0", "k", MakeSettings(64), {4, 8}) == 100);
+    REQUIRE(cache.GetDuration("dev0", "k", MakeSettings(64), {8, 8}) == 50);
+    REQUIRE(cache.GetDuration("dev1", "k", MakeSettings(64), {4, 8}) == 200);
+    REQUIRE(cache.GetDuration("dev2", "k", MakeSettings(64), {4, 8}) == -1);
+    REQUIRE(cache.GetDuration("dev0", "k", MakeSettings(32), {4, 8}) == -1);
+    cache.AddEntry("dev0", "k", MakeSettings(64), {4, 8}, 75);
+  }
+
+  // A torn record at the end of the file is ignored.
+  {
+    std::ofstream out{path.string(), std::ofstream::app | std::ofstream::binary};
+    out.write("PTCR\x10", 5);
+  }
+  {
+    TileCache cache{path.string()};
+    REQUIRE(cache.size() == 3);
+    REQUIRE(cache.GetDuration("dev0", "k", MakeSettings(64), {4, 8}) == 75);
+    cache.Compact();
+  }
+  {
+    TileCache cache{path.string()};
+    REQUIRE(cache.size() == 3);
+    REQUIRE(cache.GetDuration("dev0", "k", MakeSettings(64), {4, 8}) == 75);
+  }
+  fs::remove(path);
+}
+
+TEST_CASE("TileCache keeps records appended after a torn write", "[tile_cache]") {
+  fs::path path = fs::temp_directory_path() / fs::unique_path("tile_cache_%%%%-%%%%.bin");
+  fs::path other = fs::temp_directory_path() / fs::unique_path("tile_cache_%%%%-%%%%.bin");
+  {
+    TileCache cache{path.string()};
+    cache.AddEntry("dev0", "k", MakeSettings(64), {4, 8}, 100);
+  }
+  {
+    TileCache cache{other.string()};
+    cache.AddEntry("dev0", "k", MakeSettings(64), {8, 8}, 50);
+  }
+
+  // A process crashes partway through a record, and another process appends
+  // a good record before anyone reloads the file.
+  {
+    std::ifstream in{other.string(), std::ifstream::binary};
+    std::string records{std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>()};
+    std::ofstream out{path.string(), std::ofstream::app | std::ofstream::binary};
+    out.write("PTCR\x40\0\0\0\x01\x02", 10);
+    out.write(records.data() + 8, records.size() - 8);  // Skip the header
+  }
+  {
+    TileCache cache{path.string()};
+    REQUIRE(cache.size() == 2);
+    REQUIRE(cache.GetDuration("dev0", "k", MakeSettings(64), {8, 8}) == 50);
+  }
+
+  // A torn record at the end of the file is discarded when the file is
+  // loaded, so records appended afterwards are kept.
+  {
+    std::ofstream out{path.string(), std::ofstream::app | std::ofstream::binary};
+    out.write("PTCR\x40", 5);
+  }
+  {
+    TileCache cache{path.string()};
+    REQUIRE(cache.size() == 2);
+    cache.AddEntry("dev1", "k", MakeSettings(64), {4, 8}, 200);
+  }
+  {
+    TileCache cache{path.string()};
+    REQUIRE(cache.size() == 3);
+    REQUIRE(cache.GetDuration("dev0", "k", MakeSettings(64), {4, 8}) == 100);
+    REQUIRE(cache.GetDuration("dev0", "k", MakeSettings(64), {8, 8}) == 50);
+    REQUIRE(cache.GetDuration("dev1", "k", MakeSettings(64), {4, 8}) == 200);
+    cache.Compact();
+  }
+  {
+    TileCache cache{path.string()};
+    REQUIRE(cache.size() == 3);
+  }
+  fs::remove(path);
+  fs::remove(other);
+}
+
+}  // namespace lang
+}  // namespace tile
+}  // namespace vertexai
@@ -0,0 +1,35 @@
+// Maintains PlaidML tile cache files (see PLAIDML_TILE_CACHE).
+//
+// Usage:
+//   tile_cache_tool compact <file>   Rewrites the file in the binary format, keeping only the
+//                                    latest duration of each entry; also converts legacy JSON files.
+//   tile_cache_tool dump <file>      Lists the cache entries.
+
+#include <iostream>
+#include <string>
+
+#include "tile/lang/tile_cache.h"
+
+int main(int argc, char* argv[]) {
+  if (argc != 3) {
+    std::cerr << "Usage: " << argv[0] << " (compact|dump) <file>" << std::endl;
+    return 1;
+  }
+  std::string command = argv[1];
+  try {
+    vertexai::tile::lang::TileCache cache{argv[2]};
+    if (command == "compact") {
+      cache.Compact();
+      std::cout << "Compacted " << argv[2] << ": " << cache.size() << " entries" << std::endl;
+    } else if (command == "dump") {
+      cache.Dump(std::cout);
+    } else {
+      std::cerr << "Unknown command: " << command << std::endl;
+      return 1;
+    }
+  } catch (const std::exception& ex) {
+    std::cerr << "Error: " << ex.what() << std::endl;
+    return 1;
+  }
+  return 0;
+}
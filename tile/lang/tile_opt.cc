@@ -147,6 +147,11 @@ proto::PerfStats ComputeTileStats(const DirectSettings& settings, const FlatCont
 
   std::uint64_t mem_read = 0;
   std::uint64_t shared_mem = 0;
+  std::uint64_t cache_mem = 0;
+  // Fused input prologues are recomputed: once for each element loaded into
+  // shared memory per tile, or at every use when reading global memory.
+  std::uint64_t prologue_tile_ops = 0;
+  std::uint64_t prologue_use_ops = 0;
 
   for (size_t i = 1; i < op.access.size(); i++) {
     const auto& a = op.access[i];
@@ -156,9 +161,19 @@ proto::PerfStats ComputeTileStats(const DirectSettings& settings, const FlatCont
     }
     ReadPlan mi(op.names, a.strides, tile, mem_width);
     mem_read += mi.numLoads() * settings.mem_width;
-    if (!settings.use_global) {
+    if (settings.use_global) {
+      cache_mem += mi.localSize() * a.elem_size();
+    } else {
       shared_mem += mi.localSize() * a.elem_size();
     }
+    auto pit = op.prologues.find(i);
+    if (pit != op.prologues.end()) {
+      if (settings.use_global) {
+        prologue_use_ops += pit->second.ops.size() * a.vector;
+      } else {
+        prologue_tile_ops += pit->second.ops.size() * mi.localSize() * a.vector;
+      }
+    }
   }
   for (const auto& op_input : op.post_op_inputs) {
     // We read the post-op inputs during the output phase.
@@ -167,12 +182,14 @@ proto::PerfStats ComputeTileStats(const DirectSettings& settings, const FlatCont
 
   std::uint64_t rollups = 0;
   std::uint64_t true_ops = 1;
+  std::uint64_t uses = 1;
   std::uint64_t out_tiles = 1;
   std::uint64_t all_tiles = 1;
   std::uint64_t out_max_threads = 1;
   std::uint64_t all_max_threads = 1;
   for (size_t i = 0; i < sz; i++) {
     true_ops *= op.ranges[i];
+    uses *= op.ranges[i];
     all_max_threads *= tile[i];
     all_tiles *= RoundUp(op.ranges[i], tile[i]);
     if (op.access[0].strides[i] != 0) {
@@ -185,6 +202,7 @@ proto::PerfStats ComputeTileStats(const DirectSettings& settings, const FlatCont
   r.set_inner_loops(all_tiles / out_tiles);
   r.set_operations(std::min(settings.threads, all_max_threads));
   true_ops *= op.agg_vec;
+  true_ops += prologue_tile_ops * all_tiles + prologue_use_ops * uses;
   if (out_max_threads < r.operations()) {
     shared_mem += settings.threads * op.access[0].elem_size();
   }
@@ -199,6 +217,7 @@ proto::PerfStats ComputeTileStats(const DirectSettings& settings, const FlatCont
   r.set_threads_used(std::max(r.operations(), output_threads));
   r.set_mem_read(mem_read);
   r.set_shared_mem(shared_mem);
+  r.set_cache_mem(cache_mem);
   r.set_true_ops(true_ops);
   r.set_rollups(rollups);
 
@@ -209,9 +228,9 @@ proto::PerfStats ComputeTileStats(const DirectSettings& settings, const FlatCont
 double ComputeScore(const HardwareSettings& settings, const proto::PerfStats& perf) {
   IVLOG(4, "Compute score:"
                << " to=" << perf.true_ops() << " wg=" << perf.work_groups() << " il=" << perf.inner_loops()
-               << " sm=" << perf.shared_mem() << " or=" << perf.out_regs() << " mr=" << perf.mem_read()
-               << " mw=" << perf.mem_write() << " op=" << perf.operations() << " rp=" << perf.rollups()
-               << " tu=" << perf.threads_used());
+               << " sm=" << perf.shared_mem() << " cm=" << perf.cache_mem() << " or=" << perf.out_regs()
+               << " mr=" << perf.mem_read() << " mw=" << perf.mem_write() << " op=" << perf.operations()
+               << " rp=" << perf.rollups() << " tu=" << perf.threads_used());
   if (perf.shared_mem() > settings.max_mem) {
     IVLOG(4, "  over memory");
     return -1;
@@ -220,6 +239,10 @@ double ComputeScore(const HardwareSettings& settings, const proto::PerfStats& pe
     IVLOG(4, "  over regs");
     return -1;
   }
+  if (settings.max_cache && perf.cache_mem() > settings.max_cache) {
+    IVLOG(4, "  over cache");
+    return -1;
+  }
   // Compute the logical amount memory io (ignoring OOB)
   double bytes = perf.work_groups() * (perf.inner_loops() * perf.mem_read() + perf.mem_write());
   double flops_per_byte = perf.true_ops() / bytes;
@@ -1,12 +1,58 @@
 
 #include "tile/math/bignum.h"
 
-#include <boost/math/common_factor_rt.hpp>
+#include <stdexcept>
 
 namespace vertexai {
 namespace tile {
 namespace math {
 
+Integer::Integer(const BigInteger& value) {
+  if (-detail::kSmallMax <= value && value <= detail::kSmallMax) {
+    small_ = value.convert_to<int64_t>();
+  } else {
+    big_ = std::make_shared<const BigInteger>(value);
+  }
+}
+
+Rational::Rational(const Integer& num, const Integer& den) {
+  if (den == 0) {
+    throw std::overflow_error("Division by zero.");
+  }
+  if (num.is_small() && den.is_small()) {
+    int64_t g = detail::Gcd(num.small(), den.small());
+    num_ = num.small() / g;
+    den_ = den.small() / g;
+    if (den_ < 0) {
+      num_ = -num_;
+      den_ = -den_;
+    }
+  } else {
+    *this = Rational(BigRational(num.big(), den.big()));
+  }
+}
+
+Rational::Rational(const BigRational& value) {
+  Integer num = boost::multiprecision::numerator(value);
+  Integer den = boost::multiprecision::denominator(value);
+  if (num.is_small() && den.is_small()) {
+    num_ = num.small();
+    den_ = den.small();
+  } else {
+    big_ = std::make_shared<const BigRational>(value);
+  }
+}
+
+std::string Rational::str() const {
+  if (big_) {
+    return big_->str();
+  }
+  if (den_ == 1) {
+    return std::to_string(num_);
+  }
+  return std::to_string(num_) + "/" + std::to_string(den_);
+}
+
 Integer Floor(const Rational& x) {
   if (x < 0) {
     return (numerator(x) - denominator(x) + 1) / denominator(x);
@@ -56,7 +102,7 @@ Integer XGCD(const Integer& a, const Integer& b, Integer& x, Integer& y) {  // N
 }
 
 Rational XGCD(const Rational& a, const Rational& b, Integer& x, Integer& y) {  // NOLINT(runtime/references)
-  Integer m = boost::math::lcm(denominator(a), denominator(b));
+  Integer m = LCM(denominator(a), denominator(b));
   Rational o;
   o = Rational(XGCD(numerator(a * m), numerator(b * m), x, y), m);
 
@@ -69,14 +115,24 @@ Rational XGCD(const Rational& a, const Rational& b, Integer& x, Integer& y) {  /
 }
 
 Rational GCD(const Rational& a, const Rational& b) {
-  Integer m = boost::math::lcm(denominator(a), denominator(b));
-  Integer g = boost::math::gcd(numerator(a * m), numerator(b * m));
+  Integer m = LCM(denominator(a), denominator(b));
+  Integer g = GCD(numerator(a * m), numerator(b * m));
   return Rational(g, m);
 }
 
-Integer GCD(const Integer& a, const Integer& b) { return boost::math::gcd(a, b); }
+Integer GCD(const Integer& a, const Integer& b) {
+  if (a.is_small() && b.is_small()) {
+    return detail::Gcd(a.small(), b.small());
+  }
+  return boost::multiprecision::gcd(a.big(), b.big());
+}
 
-Integer LCM(const Integer& a, const Integer& b) { return boost::math::lcm(a, b); }
+Integer LCM(const Integer& a, const Integer& b) {
+  if (a == 0 || b == 0) {
+    return 0;
+  }
+  return Abs(a / GCD(a, b) * b);
+}
 
 Integer Min(const Integer& a, const Integer& b) {
   if (a < b)
@@ -1,6 +1,11 @@
 #pragma once
 
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <ostream>
 #include <string>
+#include <type_traits>
 
 #include <boost/multiprecision/cpp_int.hpp>
 
@@ -10,8 +15,343 @@ namespace math {
 
 typedef boost::multiprecision::cpp_int_backend<> IntegerBackend;
 typedef boost::multiprecision::rational_adaptor<IntegerBackend> RationalBackend;
-typedef boost::multiprecision::number<IntegerBackend, boost::multiprecision::et_off> Integer;
-typedef boost::multiprecision::number<RationalBackend, boost::multiprecision::et_off> Rational;
+typedef boost::multiprecision::number<IntegerBackend, boost::multiprecision::et_off> BigInteger;
+typedef boost::multiprecision::number<RationalBackend, boost::multiprecision::et_off> BigRational;
+
+namespace detail {
+
+// Values held inline are limited to [-kSmallMax, kSmallMax], so that negation
+// and absolute values never overflow.
+constexpr int64_t kSmallMax = std::numeric_limits<int64_t>::max();
+
+// Checked arithmetic on inline values; each returns false if the result
+// doesn't fit.
+inline bool CheckedAdd(int64_t a, int64_t b, int64_t* r) {
+#if defined(__GNUC__) || defined(__clang__)
+  return !__builtin_add_overflow(a, b, r) && *r != -kSmallMax - 1;
+#else
+  if ((0 < b && kSmallMax - b < a) || (b < 0 && a < -kSmallMax - b)) {
+    return false;
+  }
+  *r = a + b;
+  return true;
+#endif
+}
+
+inline bool CheckedSub(int64_t a, int64_t b, int64_t* r) { return CheckedAdd(a, -b, r); }
+
+inline bool CheckedMul(int64_t a, int64_t b, int64_t* r) {
+#if defined(__GNUC__) || defined(__clang__)
+  return !__builtin_mul_overflow(a, b, r) && *r != -kSmallMax - 1;
+#else
+  if (a && b && kSmallMax / (b < 0 ? -b : b) < (a < 0 ? -a : a)) {
+    return false;
+  }
+  *r = a * b;
+  return true;
+#endif
+}
+
+// The greatest common divisor of two inline values, which is never negative.
+inline int64_t Gcd(int64_t a, int64_t b) {
+  a = a < 0 ? -a : a;
+  b = b < 0 ? -b : b;
+  while (b) {
+    int64_t t = a % b;
+    a = b;
+    b = t;
+  }
+  return a;
+}
+
+template <typename T>
+bool FitsSmall(T value, std::true_type /* is_signed */) {
+  return -kSmallMax <= static_cast<int64_t>(value);
+}
+
+template <typename T>
+bool FitsSmall(T value, std::false_type /* is_signed */) {
+  return static_cast<uint64_t>(value) <= static_cast<uint64_t>(kSmallMax);
+}
+
+}  // namespace detail
+
+// An arbitrary-precision integer.  Values which fit in 64 bits are held
+// inline and operated on directly; an operation whose result would overflow
+// is redone on a BigInteger, and results which fit are demoted back to the
+// inline form.
+class Integer {
+ public:
+  Integer() {}
+
+  template <typename T, typename = typename std::enable_if<std::is_integral<T>::value>::type>
+  Integer(T value) {  // NOLINT(runtime/explicit)
+    if (sizeof(T) < sizeof(int64_t) || detail::FitsSmall(value, std::is_signed<T>{})) {
+      small_ = static_cast<int64_t>(value);
+    } else {
+      big_ = std::make_shared<const BigInteger>(value);
+    }
+  }
+
+  Integer(const BigInteger& value);  // NOLINT(runtime/explicit)
+
+  bool is_small() const { return !big_; }
+  int64_t small() const { return small_; }
+  BigInteger big() const { return big_ ? *big_ : BigInteger(small_); }
+
+  template <typename T, typename = typename std::enable_if<std::is_arithmetic<T>::value>::type>
+  explicit operator T() const {
+    return big_ ? big_->convert_to<T>() : static_cast<T>(small_);
+  }
+
+  std::string str() const { return big_ ? big_->str() : std::to_string(small_); }
+
+  Integer operator-() const { return big_ ? Integer(-*big_) : Integer(-small_); }
+
+  Integer& operator+=(const Integer& rhs) { return *this = *this + rhs; }
+  Integer& operator-=(const Integer& rhs) { return *this = *this - rhs; }
+  Integer& operator*=(const Integer& rhs) { return *this = *this * rhs; }
+  Integer& operator/=(const Integer& rhs) { return *this = *this / rhs; }
+  Integer& operator%=(const Integer& rhs) { return *this = *this % rhs; }
+
+  friend Integer operator+(const Integer& lhs, const Integer& rhs) {
+    int64_t r;
+    if (lhs.is_small() && rhs.is_small() && detail::CheckedAdd(lhs.small_, rhs.small_, &r)) {
+      return Integer(r);
+    }
+    return Integer(lhs.big() + rhs.big());
+  }
+
+  friend Integer operator-(const Integer& lhs, const Integer& rhs) {
+    int64_t r;
+    if (lhs.is_small() && rhs.is_small() && detail::CheckedSub(lhs.small_, rhs.small_, &r)) {
+      return Integer(r);
+    }
+    return Integer(lhs.big() - rhs.big());
+  }
+
+  friend Integer operator*(const Integer& lhs, const Integer& rhs) {
+    int64_t r;
+    if (lhs.is_small() && rhs.is_small() && detail::CheckedMul(lhs.small_, rhs.small_, &r)) {
+      return Integer(r);
+    }
+    return Integer(lhs.big() * rhs.big());
+  }
+
+  // Division truncates toward zero, as for the built-in types.
+  friend Integer operator/(const Integer& lhs, const Integer& rhs) {
+    if (lhs.is_small() && rhs.is_small() && rhs.small_) {
+      return Integer(lhs.small_ / rhs.small_);
+    }
+    return Integer(lhs.big() / rhs.big());
+  }
+
+  friend Integer operator%(const Integer& lhs, const Integer& rhs) {
+    if (lhs.is_small() && rhs.is_small() && rhs.small_) {
+      return Integer(lhs.small_ % rhs.small_);
+    }
+    return Integer(lhs.big() % rhs.big());
+  }
+
+  // Inline and big values never overlap, so mixed forms are never equal.
+  friend bool operator==(const Integer& lhs, const Integer& rhs) {
+    if (lhs.is_small() && rhs.is_small()) {
+      return lhs.small_ == rhs.small_;
+    }
+    return lhs.is_small() == rhs.is_small() && *lhs.big_ == *rhs.big_;
+  }
+
+  friend bool operator<(const Integer& lhs, const Integer& rhs) {
+    if (lhs.is_small() && rhs.is_small()) {
+      return lhs.small_ < rhs.small_;
+    }
+    return lhs.big() < rhs.big();
+  }
+
+  friend bool operator!=(const Integer& lhs, const Integer& rhs) { return !(lhs == rhs); }
+  friend bool operator>(const Integer& lhs, const Integer& rhs) { return rhs < lhs; }
+  friend bool operator<=(const Integer& lhs, const Integer& rhs) { return !(rhs < lhs); }
+  friend bool operator>=(const Integer& lhs, const Integer& rhs) { return !(lhs < rhs); }
+
+ private:
+  int64_t small_ = 0;
+  std::shared_ptr<const BigInteger> big_;
+};
+
+// An arbitrary-precision rational number, always in lowest terms with a
+// positive denominator.  As with Integer, values whose numerator and
+// denominator fit in 64 bits are held and operated on inline, with
+// overflowing operations redone on a BigRational.
+class Rational {
+ public:
+  Rational() {}
+
+  template <typename T, typename = typename std::enable_if<std::is_integral<T>::value>::type>
+  Rational(T value) : Rational(Integer(value)) {}  // NOLINT(runtime/explicit)
+
+  Rational(const Integer& value) {  // NOLINT(runtime/explicit)
+    if (value.is_small()) {
+      num_ = value.small();
+    } else {
+      big_ = std::make_shared<const BigRational>(value.big());
+    }
+  }
+
+  // Constructs num / den; throws std::overflow_error if den is zero.
+  Rational(const Integer& num, const Integer& den);
+
+  Rational(const BigRational& value);  // NOLINT(runtime/explicit)
+
+  bool is_small() const { return !big_; }
+  BigRational big() const { return big_ ? *big_ : BigRational(BigInteger(num_), BigInteger(den_)); }
+
+  // Integral conversions truncate toward zero.
+  template <typename T, typename = typename std::enable_if<std::is_arithmetic<T>::value>::type>
+  explicit operator T() const {
+    if (big_) {
+      return Convert<T>(std::is_floating_point<T>{});
+    }
+    return std::is_floating_point<T>::value ? static_cast<T>(static_cast<T>(num_) / static_cast<T>(den_))
+                                            : static_cast<T>(num_ / den_);
+  }
+
+  std::string str() const;
+
+  friend Integer numerator(const Rational& x) {
+    return x.big_ ? Integer(boost::multiprecision::numerator(*x.big_)) : Integer(x.num_);
+  }
+  friend Integer denominator(const Rational& x) {
+    return x.big_ ? Integer(boost::multiprecision::denominator(*x.big_)) : Integer(x.den_);
+  }
+
+  Rational operator-() const {
+    if (big_) {
+      return Rational(BigRational(-*big_));
+    }
+    Rational r;
+    r.num_ = -num_;
+    r.den_ = den_;
+    return r;
+  }
+
+  Rational& operator+=(const Rational& rhs) { return *this = *this + rhs; }
+  Rational& operator-=(const Rational& rhs) { return *this = *this - rhs; }
+  Rational& operator*=(const Rational& rhs) { return *this = *this * rhs; }
+  Rational& operator/=(const Rational& rhs) { return *this = *this / rhs; }
+
+  friend Rational operator+(const Rational& lhs, const Rational& rhs) {
+    Rational r;
+    if (lhs.is_small() && rhs.is_small() && Add(lhs, rhs, &r)) {
+      return r;
+    }
+    return Rational(lhs.big() + rhs.big());
+  }
+
+  friend Rational operator-(const Rational& lhs, const Rational& rhs) { return lhs + -rhs; }
+
+  friend Rational operator*(const Rational& lhs, const Rational& rhs) {
+    Rational r;
+    if (lhs.is_small() && rhs.is_small() && Mul(lhs.num_, lhs.den_, rhs.num_, rhs.den_, &r)) {
+      return r;
+    }
+    return Rational(lhs.big() * rhs.big());
+  }
+
+  friend Rational operator/(const Rational& lhs, const Rational& rhs) {
+    Rational r;
+    if (lhs.is_small() && rhs.is_small() && rhs.num_) {
+      // Multiply by the reciprocal, keeping its denominator positive.
+      int64_t rnum = rhs.num_ < 0 ? -rhs.den_ : rhs.den_;
+      int64_t rden = rhs.num_ < 0 ? -rhs.num_ : rhs.num_;
+      if (Mul(lhs.num_, lhs.den_, rnum, rden, &r)) {
+        return r;
+      }
+    }
+    return Rational(lhs.big() / rhs.big());
+  }
+
+  friend bool operator==(const Rational& lhs, const Rational& rhs) {
+    if (lhs.is_small() && rhs.is_small()) {
+      return lhs.num_ == rhs.num_ && lhs.den_ == rhs.den_;
+    }
+    return lhs.is_small() == rhs.is_small() && *lhs.big_ == *rhs.big_;
+  }
+
+  friend bool operator<(const Rational& lhs, const Rational& rhs) {
+    if (lhs.is_small() && rhs.is_small()) {
+      if (lhs.den_ == rhs.den_) {
+        return lhs.num_ < rhs.num_;
+      }
+      int64_t l, r;
+      if (detail::CheckedMul(lhs.num_, rhs.den_, &l) && detail::CheckedMul(rhs.num_, lhs.den_, &r)) {
+        return l < r;
+      }
+    }
+    return lhs.big() < rhs.big();
+  }
+
+  friend bool operator!=(const Rational& lhs, const Rational& rhs) { return !(lhs == rhs); }
+  friend bool operator>(const Rational& lhs, const Rational& rhs) { return rhs < lhs; }
+  friend bool operator<=(const Rational& lhs, const Rational& rhs) { return !(rhs < lhs); }
+  friend bool operator>=(const Rational& lhs, const Rational& rhs) { return !(lhs < rhs); }
+
+ private:
+  template <typename T>
+  T Convert(std::true_type /* is_floating_point */) const {
+    return big_->convert_to<T>();
+  }
+
+  template <typename T>
+  T Convert(std::false_type /* is_floating_point */) const {
+    BigInteger q = boost::multiprecision::numerator(*big_) / boost::multiprecision::denominator(*big_);
+    return q.convert_to<T>();
+  }
+
+  // Sets *r to the inline sum of two inline values, returning false on overflow.
+  static bool Add(const Rational& lhs, const Rational& rhs, Rational* r) {
+    if (lhs.den_ == 1 && rhs.den_ == 1) {
+      r->den_ = 1;
+      return detail::CheckedAdd(lhs.num_, rhs.num_, &r->num_);
+    }
+    int64_t g = detail::Gcd(lhs.den_, rhs.den_);
+    int64_t l, rr, num, den;
+    if (!detail::CheckedMul(lhs.num_, rhs.den_ / g, &l) || !detail::CheckedMul(rhs.num_, lhs.den_ / g, &rr) ||
+        !detail::CheckedAdd(l, rr, &num) || !detail::CheckedMul(lhs.den_ / g, rhs.den_, &den)) {
+      return false;
+    }
+    int64_t h = detail::Gcd(num, den);
+    r->num_ = num / h;
+    r->den_ = den / h;
+    return true;
+  }
+
+  // Sets *r to the inline product of (an / ad) and (bn / bd), each in lowest
+  // terms with a positive denominator, returning false on overflow.
+  static bool Mul(int64_t an, int64_t ad, int64_t bn, int64_t bd, Rational* r) {
+    int64_t g1 = detail::Gcd(an, bd);
+    int64_t g2 = detail::Gcd(bn, ad);
+    g1 = g1 ? g1 : 1;
+    g2 = g2 ? g2 : 1;
+    if (!detail::CheckedMul(an / g1, bn / g2, &r->num_) || !detail::CheckedMul(ad / g2, bd / g1, &r->den_)) {
+      return false;
+    }
+    if (!r->num_) {
+      r->den_ = 1;
+    }
+    return true;
+  }
+
+  int64_t num_ = 0;
+  int64_t den_ = 1;
+  std::shared_ptr<const BigRational> big_;
+};
+
+inline std::ostream& operator<<(std::ostream& os, const Integer& x) { return os << x.str(); }
+inline std::ostream& operator<<(std::ostream& os, const Rational& x) { return os << x.str(); }
+
+// As provided for the boost multiprecision types.
+inline Integer abs(const Integer& x) { return x < 0 ? -x : x; }
+inline Rational abs(const Rational& x) { return x < 0 ? -x : x; }
 
 inline std::string to_string(const Integer& x) { return x.str(); }
 inline std::string to_string(const Rational& x) { return x.str(); }
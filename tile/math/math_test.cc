@@ -1,3 +1,4 @@
+#include <limits>
 
 #include "base/util/catch.h"
 #include "base/util/logging.h"
@@ -66,6 +67,44 @@ TEST_CASE("XGCD", "[lattice]") {
   ValidateXGCD(Rational(-15, 8), Rational(-25, 6));
 }
 
+TEST_CASE("Integer overflow promotes and demotes", "[bignum]") {
+  Integer max = std::numeric_limits<int64_t>::max();
+  REQUIRE(max.is_small());
+  Integer over = max + 1;
+  REQUIRE(!over.is_small());
+  REQUIRE(over.str() == "9223372036854775808");
+  REQUIRE(over > max);
+  Integer back = over - 1;
+  REQUIRE(back.is_small());
+  REQUIRE(back == max);
+  Integer square = max * max;
+  REQUIRE(!square.is_small());
+  REQUIRE(square / max == max);
+  REQUIRE((square / max).is_small());
+  REQUIRE(-(-max) == max);
+  REQUIRE(Integer(BigInteger(42)).is_small());
+  REQUIRE(Integer(BigInteger(42)) == 42);
+}
+
+TEST_CASE("Rational overflow promotes and demotes", "[bignum]") {
+  int64_t max = std::numeric_limits<int64_t>::max();
+  Rational a(max, 3);
+  Rational b(max, 5);
+  REQUIRE(a.is_small());
+  Rational product = a * b;
+  REQUIRE(!product.is_small());
+  REQUIRE(product > a);
+  REQUIRE(product / b == a);
+  REQUIRE((product / b).is_small());
+  Rational sum = Rational(1, max) + Rational(1, max - 1);
+  REQUIRE(!sum.is_small());
+  REQUIRE(sum - Rational(1, max - 1) == Rational(1, max));
+  REQUIRE(Rational(6, -4).str() == "-3/2");
+  REQUIRE(Rational(4, 2).str() == "2");
+  REQUIRE(Floor(Rational(Integer(max) * 4, 3)) == Integer(max) + Integer(max) / 3);
+  REQUIRE(Ceil(-product) == -Floor(product));
+}
+
 TEST_CASE("From Poly Test", "[matrix][fromPoly]") {
   Polynomial<Rational> x("x"), y("y"), z("z");
   Matrix m;
@@ -2,26 +2,160 @@
 
 #include "tile/platform/local_machine/mem_cache.h"
 
+#include <algorithm>
+#include <limits>
 #include <utility>
 
+#include "base/util/perf_counter.h"
+
 namespace vertexai {
 namespace tile {
 namespace local_machine {
+namespace {
 
-std::shared_ptr<hal::Buffer> MemCache::TryAlloc(std::size_t size) {
-  std::lock_guard<std::mutex> lock{mu_};
-  auto& l = mem_[size];
-  if (l.size()) {
-    std::shared_ptr<hal::Buffer> result{std::move(l.top())};
-    l.pop();
-    return result;
+// Requests smaller than this share a single size class.
+constexpr std::uint64_t kMinSizeClass = 256;
+
+PerfCounter hits_counter("tmp_mem_hits");
+PerfCounter misses_counter("tmp_mem_misses");
+PerfCounter bytes_held_counter("tmp_mem_bytes_held");
+PerfCounter bytes_in_use_counter("tmp_mem_bytes_in_use");
+PerfCounter bytes_requested_counter("tmp_mem_bytes_requested");
+PerfCounter bytes_released_counter("tmp_mem_bytes_released");
+
+std::uint32_t FloorLog2(std::uint64_t value) {
+  std::uint32_t result = 0;
+  while (value >>= 1) {
+    ++result;
+  }
+  return result;
+}
+
+}  // namespace
+
+MemCache::MemCache(hal::Memory* source, std::uint64_t high_water_bytes, std::uint32_t classes_per_doubling,
+                   std::uint64_t max_bytes)
+    : source_{source},
+      high_water_bytes_{high_water_bytes},
+      max_bytes_{max_bytes},
+      class_shift_{FloorLog2(std::max<std::uint32_t>(1, classes_per_doubling))} {}
+
+MemCache::~MemCache() { Trim(0); }
+
+std::uint64_t MemCache::SizeClass(std::uint64_t size) const {
+  if (size <= kMinSizeClass) {
+    return kMinSizeClass;
   }
-  return std::shared_ptr<hal::Buffer>{};
+  // Between each pair of powers of two, 2^n < size <= 2^(n+1), there are
+  // 2^class_shift_ evenly spaced classes.
+  std::uint32_t n = FloorLog2(size - 1);
+  std::uint64_t step = std::uint64_t{1} << (n > class_shift_ ? n - class_shift_ : 0);
+  return (size + step - 1) & ~(step - 1);
 }
 
-void MemCache::Free(std::size_t size, std::shared_ptr<hal::Buffer> mem) {
+std::shared_ptr<hal::Buffer> MemCache::Alloc(std::uint64_t size) {
+  std::uint64_t size_class = SizeClass(size);
+  std::shared_ptr<hal::Buffer> result;
+  std::vector<std::shared_ptr<hal::Buffer>> released;
+  {
+    std::lock_guard<std::mutex> lock{mu_};
+    auto it = free_.find(size_class);
+    if (it != free_.end()) {
+      auto ent = it->second.back();
+      it->second.pop_back();
+      if (it->second.empty()) {
+        free_.erase(it);
+      }
+      result = std::move(ent->buffer);
+      lru_.erase(ent);
+      stats_.bytes_held -= size_class;
+      bytes_held_counter.add(-static_cast<std::int64_t>(size_class));
+      stats_.hits++;
+      hits_counter.inc();
+    } else {
+      stats_.misses++;
+      misses_counter.inc();
+    }
+    stats_.bytes_in_use += size_class;
+    stats_.bytes_requested += size;
+    if (!result && max_bytes_) {
+      // Make room under the cap for the new buffer.
+      TrimLocked(HeldLimit(stats_.bytes_in_use), &released);
+    }
+  }
+  released.clear();
+  bytes_in_use_counter.add(size_class);
+  bytes_requested_counter.add(size);
+
+  if (!result) {
+    try {
+      result = source_->MakeBuffer(size_class, hal::BufferAccessMask::DEVICE_RW);
+    } catch (...) {
+      {
+        std::lock_guard<std::mutex> lock{mu_};
+        stats_.bytes_in_use -= size_class;
+        stats_.bytes_requested -= size;
+      }
+      bytes_in_use_counter.add(-static_cast<std::int64_t>(size_class));
+      bytes_requested_counter.add(-static_cast<std::int64_t>(size));
+      throw;
+    }
+  }
+  return result;
+}
+
+void MemCache::Free(std::uint64_t size, std::shared_ptr<hal::Buffer> buffer) {
+  std::uint64_t size_class = SizeClass(size);
+  std::vector<std::shared_ptr<hal::Buffer>> released;
+  {
+    std::lock_guard<std::mutex> lock{mu_};
+    stats_.bytes_in_use -= size_class;
+    stats_.bytes_requested -= size;
+    lru_.emplace_front(FreeEnt{size_class, std::move(buffer)});
+    free_[size_class].emplace_back(lru_.begin());
+    stats_.bytes_held += size_class;
+    bytes_held_counter.add(size_class);
+    TrimLocked(HeldLimit(stats_.bytes_in_use), &released);
+  }
+  bytes_in_use_counter.add(-static_cast<std::int64_t>(size_class));
+  bytes_requested_counter.add(-static_cast<std::int64_t>(size));
+}
+
+void MemCache::Trim(std::uint64_t bytes_held_max) {
+  std::vector<std::shared_ptr<hal::Buffer>> released;
+  std::lock_guard<std::mutex> lock{mu_};
+  TrimLocked(bytes_held_max, &released);
+}
+
+MemCache::Stats MemCache::stats() {
   std::lock_guard<std::mutex> lock{mu_};
-  mem_[size].push(std::move(mem));
+  return stats_;
+}
+
+std::uint64_t MemCache::HeldLimit(std::uint64_t bytes_in_use) const {
+  std::uint64_t limit = high_water_bytes_ ? high_water_bytes_ : std::numeric_limits<std::uint64_t>::max();
+  if (max_bytes_) {
+    limit = std::min(limit, max_bytes_ - std::min(max_bytes_, bytes_in_use));
+  }
+  return limit;
+}
+
+void MemCache::TrimLocked(std::uint64_t bytes_held_max, std::vector<std::shared_ptr<hal::Buffer>>* released) {
+  while (bytes_held_max < stats_.bytes_held) {
+    auto ent = std::prev(lru_.end());
+    auto it = free_.find(ent->size_class);
+    auto& ents = it->second;
+    ents.erase(std::find(ents.begin(), ents.end(), ent));
+    if (ents.empty()) {
+      free_.erase(it);
+    }
+    stats_.bytes_held -= ent->size_class;
+    stats_.bytes_released += ent->size_class;
+    bytes_held_counter.add(-static_cast<std::int64_t>(ent->size_class));
+    bytes_released_counter.add(ent->size_class);
+    released->emplace_back(std::move(ent->buffer));
+    lru_.erase(ent);
+  }
 }
 
 }  // namespace local_machine
@@ -3,10 +3,11 @@
 #pragma once
 
 #include <cstdint>
+#include <list>
+#include <map>
 #include <memory>
 #include <mutex>
-#include <stack>
-#include <unordered_map>
+#include <vector>
 
 #include "tile/base/hal.h"
 
@@ -15,14 +16,87 @@ namespace tile {
 namespace local_machine {
 
 // Caches device memory allocations.
+//
+// Requests are rounded up to a size class: there are a fixed number of classes
+// per power of two, so a buffer may be reused by any request within a small
+// fraction of its size, and rounding wastes at most that fraction.  Freed
+// buffers are retained for reuse up to a high-water mark; past that, the least
+// recently freed buffers are released back to the underlying memory.  A cache
+// may also be capped: free buffers are released whenever holding them would
+// take the cache's total footprint (buffers in use plus buffers held) past the
+// cap.  Buffers in use are never reclaimed, so the cap bounds what the cache
+// keeps around, not what its callers may allocate.
+//
+// A single cache may be shared by any number of clients (see TmpMemStrategy),
+// letting clients that don't run concurrently reuse each other's buffers.
+//
+// The cache is internally synchronized.  Its statistics are also accumulated
+// into the process-wide "tmp_mem_*" performance counters.
 class MemCache {
  public:
-  std::shared_ptr<hal::Buffer> TryAlloc(std::size_t size);
-  void Free(std::size_t size, std::shared_ptr<hal::Buffer>);
+  struct Stats {
+    std::uint64_t hits = 0;             // Allocations satisfied from the cache
+    std::uint64_t misses = 0;           // Allocations requiring a new buffer
+    std::uint64_t bytes_held = 0;       // Bytes of free buffers retained for reuse
+    std::uint64_t bytes_in_use = 0;     // Bytes of buffers currently allocated
+    std::uint64_t bytes_requested = 0;  // Bytes requested by current allocations
+    std::uint64_t bytes_released = 0;   // Bytes of free buffers released by trimming
+  };
+
+  static constexpr std::uint32_t kDefaultClassesPerDoubling = 4;
+
+  // Constructs a cache of buffers allocated from the supplied memory.  A
+  // high-water mark or cap of zero leaves the corresponding limit unbounded.
+  MemCache(hal::Memory* source, std::uint64_t high_water_bytes,
+           std::uint32_t classes_per_doubling = kDefaultClassesPerDoubling, std::uint64_t max_bytes = 0);
+  ~MemCache();
+
+  // Returns the size of the buffers used to satisfy requests of the supplied size.
+  std::uint64_t SizeClass(std::uint64_t size) const;
+
+  // Allocates a buffer of at least the requested size.
+  std::shared_ptr<hal::Buffer> Alloc(std::uint64_t size);
+
+  // Returns a buffer obtained from Alloc(size) to the cache.
+  void Free(std::uint64_t size, std::shared_ptr<hal::Buffer> buffer);
+
+  // Releases least recently freed buffers until at most the supplied number of
+  // bytes are held.
+  void Trim(std::uint64_t bytes_held_max);
+
+  Stats stats();
+
+  std::uint64_t max_bytes() const { return max_bytes_; }
 
  private:
+  struct FreeEnt {
+    std::uint64_t size_class;
+    std::shared_ptr<hal::Buffer> buffer;
+  };
+
+  // Returns the most free bytes the cache may hold while the supplied number of
+  // bytes are in use.
+  std::uint64_t HeldLimit(std::uint64_t bytes_in_use) const;
+
+  // Drops entries until no more than bytes_held_max bytes are held, moving their
+  // buffers to *released so that they can be destroyed outside the lock.
+  void TrimLocked(std::uint64_t bytes_held_max, std::vector<std::shared_ptr<hal::Buffer>>* released);
+
+  hal::Memory* source_;
+  const std::uint64_t high_water_bytes_;
+  const std::uint64_t max_bytes_;
+  std::uint32_t class_shift_;
+
   std::mutex mu_;
-  std::unordered_map<std::size_t, std::stack<std::shared_ptr<hal::Buffer>>> mem_;
+
+  // Free buffers, most recently freed first.
+  std::list<FreeEnt> lru_;
+
+  // Free buffers by size class; the most recently freed buffer of each class
+  // is at the back.
+  std::map<std::uint64_t, std::vector<std::list<FreeEnt>::iterator>> free_;
+
+  Stats stats_;
 };
 
 }  // namespace local_machine
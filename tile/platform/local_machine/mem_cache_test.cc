@@ -0,0 +1,162 @@
+// Copyright 2018 Intel Corporation.
+
+#include <gmock/gmock.h>
+
+#include <algorithm>
+#include <vector>
+
+#include "tile/platform/local_machine/mem_cache.h"
+#include "tile/platform/local_machine/tmp_mem_strategy.h"
+
+namespace vertexai {
+namespace tile {
+namespace local_machine {
+namespace {
+
+class FakeBuffer final : public hal::Buffer {
+ public:
+  explicit FakeBuffer(std::uint64_t size) : size_{size} {}
+
+  boost::future<void*> MapCurrent(const std::vector<std::shared_ptr<hal::Event>>&) final {
+    throw std::logic_error{"unimplemented"};
+  }
+  boost::future<void*> MapDiscard(const std::vector<std::shared_ptr<hal::Event>>&) final {
+    throw std::logic_error{"unimplemented"};
+  }
+  std::shared_ptr<hal::Event> Unmap(const context::Context&) final { throw std::logic_error{"unimplemented"}; }
+
+  std::uint64_t size() const { return size_; }
+
+ private:
+  std::uint64_t size_;
+};
+
+class FakeMemory final : public hal::Memory {
+ public:
+  std::uint64_t size_goal() const final { return 0; }
+  hal::BufferAccessMask AllowedAccesses() const final { return hal::BufferAccessMask::ALL; }
+  std::size_t ArenaBufferAlignment() const final { return 1; }
+  std::shared_ptr<hal::Buffer> MakeBuffer(std::uint64_t size, hal::BufferAccessMask) final {
+    allocs.push_back(size);
+    return std::make_shared<FakeBuffer>(size);
+  }
+  std::shared_ptr<hal::Arena> MakeArena(std::uint64_t, hal::BufferAccessMask) final {
+    throw std::logic_error{"unimplemented"};
+  }
+
+  std::vector<std::uint64_t> allocs;
+};
+
+TEST(MemCacheTest, SizeClassesBoundWaste) {
+  FakeMemory memory;
+  MemCache cache{&memory, 0, 4};
+  EXPECT_EQ(256, cache.SizeClass(0));
+  EXPECT_EQ(256, cache.SizeClass(256));
+  EXPECT_EQ(320, cache.SizeClass(257));
+  EXPECT_EQ(1024, cache.SizeClass(1024));
+  EXPECT_EQ(1280, cache.SizeClass(1025));
+  for (std::uint64_t size = 1; size < 100000; size += 97) {
+    std::uint64_t size_class = cache.SizeClass(size);
+    EXPECT_GE(size_class, size);
+    EXPECT_LE(size_class, std::max<std::uint64_t>(256, size + size / 4));
+  }
+}
+
+TEST(MemCacheTest, ReusesBuffersWithinASizeClass) {
+  FakeMemory memory;
+  MemCache cache{&memory, 0};
+  auto buf = cache.Alloc(1000);
+  auto* raw = buf.get();
+  cache.Free(1000, std::move(buf));
+  auto reused = cache.Alloc(1001);
+  EXPECT_EQ(raw, reused.get());
+  EXPECT_THAT(memory.allocs, ::testing::ElementsAre(1024));
+
+  auto stats = cache.stats();
+  EXPECT_EQ(1, stats.hits);
+  EXPECT_EQ(1, stats.misses);
+  EXPECT_EQ(1024, stats.bytes_in_use);
+  EXPECT_EQ(1001, stats.bytes_requested);
+  EXPECT_EQ(0, stats.bytes_held);
+}
+
+TEST(MemCacheTest, TrimsLeastRecentlyFreedPastHighWater) {
+  FakeMemory memory;
+  MemCache cache{&memory, 2048};
+  auto a = cache.Alloc(1024);
+  auto b = cache.Alloc(1024);
+  auto c = cache.Alloc(1024);
+  std::weak_ptr<hal::Buffer> weak_a = a;
+  auto* raw_c = c.get();
+  cache.Free(1024, std::move(a));
+  cache.Free(1024, std::move(b));
+  cache.Free(1024, std::move(c));
+
+  EXPECT_TRUE(weak_a.expired());
+  auto stats = cache.stats();
+  EXPECT_EQ(2048, stats.bytes_held);
+  EXPECT_EQ(1024, stats.bytes_released);
+  EXPECT_EQ(0, stats.bytes_in_use);
+
+  EXPECT_EQ(raw_c, cache.Alloc(1024).get());
+  cache.Trim(0);
+  EXPECT_EQ(0, cache.stats().bytes_held);
+}
+
+TEST(MemCacheTest, ReleasesFreeBuffersToStayUnderCap) {
+  FakeMemory memory;
+  MemCache cache{&memory, 0, MemCache::kDefaultClassesPerDoubling, 3072};
+  auto a = cache.Alloc(1024);
+  auto b = cache.Alloc(2048);
+  std::weak_ptr<hal::Buffer> weak_b = b;
+  cache.Free(2048, std::move(b));
+  EXPECT_EQ(2048, cache.stats().bytes_held);
+
+  // A new buffer that doesn't fit beside the held one displaces it.
+  auto c = cache.Alloc(1024);
+  EXPECT_TRUE(weak_b.expired());
+  auto stats = cache.stats();
+  EXPECT_EQ(0, stats.bytes_held);
+  EXPECT_EQ(2048, stats.bytes_in_use);
+
+  // Buffers in use are never reclaimed, and nothing is held while over the cap.
+  auto d = cache.Alloc(2048);
+  EXPECT_EQ(4096, cache.stats().bytes_in_use);
+  cache.Free(1024, std::move(a));
+  EXPECT_EQ(0, cache.stats().bytes_held);
+  cache.Free(2048, std::move(d));
+  EXPECT_EQ(2048, cache.stats().bytes_held);
+}
+
+TEST(TmpMemStrategyTest, ProgramsShareAPool) {
+  FakeMemory memory;
+  auto pool = std::make_shared<MemCache>(&memory, 0);
+  TmpMemStrategy first{nullptr, pool};
+  TmpMemStrategy second{nullptr, pool};
+  context::Context ctx;
+
+  hal::Buffer* raw;
+  {
+    auto x = first.MakeChunk(ctx, 1000);
+    auto y = first.MakeChunk(ctx, 4096);
+    raw = y->hal_buffer().get();
+    EXPECT_EQ(1024 + 4096, first.usage().bytes_in_use);
+  }
+  EXPECT_EQ(0, first.usage().bytes_in_use);
+  EXPECT_EQ(1024 + 4096, first.usage().peak_bytes_in_use);
+
+  // Once the first program is done with its memory, the second reuses it.
+  {
+    auto z = second.MakeChunk(ctx, 4000);
+    EXPECT_EQ(raw, z->hal_buffer().get());
+    EXPECT_EQ(4096, second.usage().bytes_in_use);
+    EXPECT_EQ(0, first.usage().bytes_in_use);
+  }
+  EXPECT_THAT(memory.allocs, ::testing::ElementsAre(1024, 4096));
+  EXPECT_EQ(4096, second.usage().peak_bytes_in_use);
+}
+
+}  // namespace
+}  // namespace local_machine
+}  // namespace tile
+}  // namespace vertexai
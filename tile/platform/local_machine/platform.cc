@@ -17,13 +17,10 @@
 #include "base/util/type_url.h"
 #include "tile/hal/util/selector.h"
 #include "tile/hal/util/settings.h"
-#include "tile/platform/local_machine/block_placer.h"
 #include "tile/platform/local_machine/buffer.h"
 #include "tile/platform/local_machine/direct_mem_strategy.h"
-#include "tile/platform/local_machine/fifo_scheduler.h"
-#include "tile/platform/local_machine/loose_scheduler.h"
 #include "tile/platform/local_machine/program.h"
-#include "tile/platform/local_machine/tdep_scheduler.h"
+#include "tile/platform/local_machine/scheduler_config.h"
 #include "tile/platform/local_machine/tmp_mem_strategy.h"
 
 namespace vertexai {
@@ -70,9 +67,18 @@ bool MatchConfig(const proto::Platform& config, const hal::proto::HardwareInfo&
   return false;
 }
 
+proto::SchedulerConfig MatchSchedulerConfig(const proto::Platform& config, const hal::proto::HardwareInfo& info) {
+  for (const auto& scheduler_config : config.scheduler_configs()) {
+    if (hal::selector::Match(scheduler_config.sel(), info)) {
+      return scheduler_config;
+    }
+  }
+  return proto::SchedulerConfig{};
+}
+
 }  // namespace
 
-Platform::Platform(const context::Context& ctx, const proto::Platform& config) {
+Platform::Platform(const context::Context& ctx, const proto::Platform& config) : tmp_mem_pool_{config.tmp_mem_pool()} {
   auto env = boost::this_process::environment();
   if (env.count("PLAIDML_DEBUG")) {
     LOG(INFO) << "Press any key after attaching a debugger to pid: " << boost::this_process::get_id();
@@ -118,6 +124,7 @@ Platform::Platform(const context::Context& ctx, const proto::Platform& config) {
           }
           VLOG(1) << settings.DebugString();
           GetMemStrategy(devinfo, &pd);
+          pd.tmp_mem_pool = TmpMemStrategy::MakePool(pd.tmp_mem_source, tmp_mem_pool_);
 
           auto memory = (dev->executor() && dev->executor()->device_memory() ? dev->executor()->device_memory()
                                                                              : devset->host_memory());
@@ -125,9 +132,8 @@ Platform::Platform(const context::Context& ctx, const proto::Platform& config) {
             IVLOG(1, "Device is synchronous");
           }
           auto size_goal = memory->size_goal() * kGoalMemPercentage;
-          IVLOG(1, "Using fifo scheduler; size_goal=" << size_goal);
-          pd.scheduler = std::make_shared<fifo_scheduler::FifoScheduler>(memory->ArenaBufferAlignment(),
-                                                                         std::lround(std::floor(size_goal)), settings);
+          pd.scheduler = MakeScheduler(MatchSchedulerConfig(config, info), memory->ArenaBufferAlignment(),
+                                       std::lround(std::floor(size_goal)), settings);
           devs_[id] = std::move(pd);
         }
       }
@@ -147,7 +153,7 @@ std::unique_ptr<tile::Program> Platform::MakeProgram(const context::Context& ctx
   auto& platform_dev = LookupDevice(program.dev_id());
   return std::make_unique<Program>(ctx, program, platform_dev.devinfo, platform_dev.scheduler,
                                    platform_dev.mem_strategy,
-                                   std::make_shared<TmpMemStrategy>(platform_dev.devinfo, platform_dev.tmp_mem_source),
+                                   std::make_shared<TmpMemStrategy>(platform_dev.devinfo, platform_dev.tmp_mem_pool),
                                    platform_dev.tmp_mem_source, tile_optimizer_);
 }
 
@@ -12,6 +12,7 @@
 #include "tile/base/platform.h"
 #include "tile/platform/local_machine/devinfo.h"
 #include "tile/platform/local_machine/local_machine.pb.h"
+#include "tile/platform/local_machine/mem_cache.h"
 #include "tile/platform/local_machine/mem_strategy.h"
 #include "tile/platform/local_machine/scheduler.h"
 
@@ -30,6 +31,7 @@ class Platform : public tile::Platform {
     std::shared_ptr<DevInfo> devinfo;
     std::shared_ptr<MemStrategy> mem_strategy;
     hal::Memory* tmp_mem_source;
+    std::shared_ptr<MemCache> tmp_mem_pool;  // Shared by all of the device's programs
     std::shared_ptr<Scheduler> scheduler;
   };
 
@@ -52,6 +54,7 @@ class Platform : public tile::Platform {
   std::unordered_map<std::string, PlatformDev> devs_;
   std::unordered_map<std::string, PlatformDev> unmatched_devs_;
   std::shared_ptr<Scheduler> scheduler_;
+  proto::TmpMemPool tmp_mem_pool_;
   lang::TileOptimizer tile_optimizer_;
 };
 
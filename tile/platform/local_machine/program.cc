@@ -3,14 +3,25 @@
 #include "tile/platform/local_machine/program.h"
 
 #include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <deque>
 #include <forward_list>
+#include <future>
+#include <limits>
+#include <memory>
 #include <numeric>
 #include <set>
 #include <unordered_set>
 #include <utility>
 
+#include <boost/asio.hpp>
+#include <boost/asio/thread_pool.hpp>
+
 #include "base/util/error.h"
+#include "base/util/fingerprint.h"
 #include "base/util/perf_counter.h"
+#include "tile/base/parallel_for.h"
 #include "tile/hal/util/settings.h"
 #include "tile/lang/parser.h"
 #include "tile/lang/tile_cache.h"
@@ -34,60 +45,263 @@ void AllocateBuffers(const std::vector<std::string>& names, const ShapeMap& type
   }
 }
 
-int64_t TryKernel(const context::Context& ctx, const lang::KernelInfo& ki,
-                  const std::vector<std::shared_ptr<hal::Buffer>>& buffers, const DevInfo& devinfo, size_t trial_runs) {
-  // Check in cache, and early return if found
-  int64_t cached_time = lang::TileCache::Instance()->GetDuration(ki.key, ki.settings, ki.tile.shape);
-  if (cached_time >= 0) {
-    LOG(DEBUG) << "Cached kernel: " << ki.kname << ", key: " << ki.key << ", tile: " << ki.tile.shape;
-    return cached_time;
+// Identifies the device (and its driver) for tile cache lookups, since kernel
+// timings only make sense on the hardware they were measured on.
+std::string DeviceFingerprint(const DevInfo& devinfo) {
+  const auto& info = devinfo.dev->executor()->info();
+  Fingerprinter fp;
+  fp.Update(static_cast<std::uint64_t>(info.type()));
+  fp.Update(info.name());
+  fp.Update(info.vendor());
+  fp.Update(static_cast<std::uint64_t>(info.vendor_id()));
+  fp.Update(info.platform());
+  fp.Update(info.info().value());
+  std::string digest = fp.Digest();
+  std::string result;
+  for (unsigned char c : digest) {
+    result += "0123456789abcdef"[c >> 4];
+    result += "0123456789abcdef"[c & 0xf];
   }
+  return result;
+}
+
+// A compiled tile candidate, ready to be timed.
+struct CompiledTrial {
+  std::unique_ptr<hal::Library> library;
+  std::unique_ptr<hal::Executable> executable;
+};
+
+// A single autotuning trial: one tile candidate for one kernel.
+struct Trial {
+  std::size_t kidx;
+  std::size_t num;
+  const lang::KernelInfo* ki;
+  hal::proto::TuningInfo::Trial* info;
+  std::future<CompiledTrial> compiled;
+};
+
+// Tunes the kernels of a program by timing their tile candidates.  Candidates
+// are compiled concurrently on a compile thread pool, a bounded number ahead
+// of a single measurement lane (the calling thread), which times them one at
+// a time so that measurements don't interfere with each other.
+class Tuner {
+ public:
+  Tuner(const context::Context& ctx, const DevInfo& devinfo, const tile::proto::TileScanningParameters& params,
+        hal::Memory* memory)
+      : ctx_{ctx},
+        devinfo_{devinfo},
+        device_{DeviceFingerprint(devinfo)},
+        memory_{memory},
+        trial_runs_{std::max<std::size_t>(1, params.max_trial_runs())},
+        min_score_ratio_{params.min_score_ratio()},
+        budget_{std::chrono::milliseconds(params.max_tuning_ms())},
+        compile_threads_{ResolveThreadCount(params.compile_threads())} {
+    info_.set_compile_threads(compile_threads_);
+  }
+
+  void Tune(lang::KernelList* kernel_list) {
+    auto start = std::chrono::steady_clock::now();
 
-  LOG(DEBUG) << "Trying kernel: " << ki.kname << ", key: " << ki.key << ", tile: " << ki.tile.shape;
-  try {
-    // Prep to do a real run
-    auto& device = *devinfo.dev;
-    auto library = device.compiler()->Build(ctx, {ki}, devinfo.settings).get();
-    auto executable = device.executor()->Prepare(library.get()).get();
-    int64_t best_time = std::numeric_limits<int64_t>::max();
-
-    // Run trial_runs number of times, picking minimum time
-    for (size_t i = 0; i < trial_runs; i++) {
-      auto evt = executable->Run(ctx, 0, buffers, {}, true);
-      device.executor()->Flush();
-      auto result = evt->GetFuture().get();
-      int64_t time = result->GetDuration().count();
-      best_time = std::min(time, best_time);
+    // Gather the candidates for each kernel, with the primary first.
+    std::vector<std::vector<lang::KernelInfo>> options;
+    std::vector<std::size_t> tuned;
+    for (std::size_t kidx = 0; kidx < kernel_list->kernels.size(); ++kidx) {
+      auto& ki = kernel_list->kernels[kidx];
+      if (ki.candidates.empty()) {
+        continue;
+      }
+      std::vector<lang::KernelInfo> kernel_options;
+      std::swap(kernel_options, ki.candidates);
+      kernel_options.insert(kernel_options.begin(), ki);
+      options.emplace_back(std::move(kernel_options));
+      tuned.push_back(kidx);
+    }
+
+    std::deque<Trial> trials;
+    for (std::size_t idx = 0; idx < options.size(); ++idx) {
+      auto kinfo = info_.add_kernels();
+      kinfo->set_kname(options[idx][0].kname);
+      for (std::size_t num = 0; num < options[idx].size(); ++num) {
+        const auto& candidate = options[idx][num];
+        auto tinfo = kinfo->add_trials();
+        for (auto dim : candidate.tile.shape) {
+          tinfo->add_tile(dim);
+        }
+        tinfo->set_score(candidate.tile.kernel_cost);
+        tinfo->set_duration_ns(std::numeric_limits<int64_t>::max());
+        if (num && IsPruned(options[idx][0], candidate)) {
+          tinfo->set_pruned(true);
+          continue;
+        }
+        int64_t cached_time =
+            lang::TileCache::Instance()->GetDuration(device_, candidate.key, candidate.settings, candidate.tile.shape);
+        if (cached_time >= 0) {
+          LOG(DEBUG) << "Cached kernel: " << candidate.kname << ", key: " << candidate.key
+                     << ", tile: " << candidate.tile.shape;
+          tinfo->set_cached(true);
+          tinfo->set_duration_ns(cached_time);
+          continue;
+        }
+        trials.emplace_back(Trial{idx, num, &candidate, tinfo, std::future<CompiledTrial>{}});
+      }
     }
 
-    // Save in cache and return
-    lang::TileCache::Instance()->AddEntry(ki.key, ki.settings, ki.tile.shape, best_time);
-    return best_time;
-  } catch (const std::exception& ex) {
-    LOG(ERROR) << "Skipping kernel failure: " << ex.what();
-  } catch (...) {
-    LOG(ERROR) << "Skipping unknown kernel failure";
+    // Run the measurement lane, keeping the compile pool a bounded distance
+    // ahead of it so that compiled-but-untimed executables don't pile up.
+    // With fewer than two trials there's nothing to overlap, so the lane
+    // compiles for itself and no pool is started.
+    std::unique_ptr<boost::asio::thread_pool> pool;
+    if (trials.size() > 1) {
+      pool = std::make_unique<boost::asio::thread_pool>(std::min(compile_threads_, trials.size()));
+    }
+    std::size_t window = 2 * compile_threads_;
+    std::size_t submitted = 0;
+    std::size_t buffers_kidx = std::numeric_limits<std::size_t>::max();
+    std::vector<std::shared_ptr<hal::Buffer>> buffers;
+    for (std::size_t idx = 0; idx < trials.size(); ++idx) {
+      for (; submitted < trials.size() && submitted < idx + window; ++submitted) {
+        trials[submitted].compiled = Compile(pool.get(), *trials[submitted].ki);
+      }
+      auto& trial = trials[idx];
+      if (budget_.count() && budget_ < std::chrono::steady_clock::now() - start) {
+        info_.set_budget_exhausted(true);
+        cancelled_ = true;
+        for (; idx < trials.size(); ++idx) {
+          trials[idx].info->set_skipped(true);
+        }
+        break;
+      }
+      if (buffers_kidx != trial.kidx) {
+        const auto& ki = *trial.ki;
+        buffers.clear();
+        AllocateBuffers(ki.outputs, kernel_list->types, memory_, &buffers);
+        AllocateBuffers(ki.inputs, kernel_list->types, memory_, &buffers);
+        buffers_kidx = trial.kidx;
+      }
+      Measure(&trial, buffers);
+    }
+    if (pool) {
+      pool->join();
+    }
+
+    // Install the fastest candidate of each kernel.
+    for (std::size_t idx = 0; idx < options.size(); ++idx) {
+      auto kinfo = info_.mutable_kernels(idx);
+      std::size_t best_num = 0;
+      int64_t best_time = kinfo->trials(0).duration_ns();
+      for (std::size_t num = 1; num < options[idx].size(); ++num) {
+        if (kinfo->trials(num).duration_ns() < best_time) {
+          best_time = kinfo->trials(num).duration_ns();
+          best_num = num;
+        }
+      }
+      kinfo->set_best(best_num);
+      pre_scan_time.add(kinfo->trials(0).duration_ns());
+      post_scan_time.add(best_time);
+      IVLOG(1, "  best: " << double(best_time) / 1e9 << ", index: " << best_num);
+      kernel_list->kernels[tuned[idx]] = std::move(options[idx][best_num]);
+    }
+    IVLOG(1, "  pre_scan_time: " << double(pre_scan_time.get()) / 1e9
+                                 << ", post_scan_time: " << double(post_scan_time.get()) / 1e9);
   }
-  return std::numeric_limits<int64_t>::max();
+
+  const hal::proto::TuningInfo& info() const { return info_; }
+
+ private:
+  bool IsPruned(const lang::KernelInfo& primary, const lang::KernelInfo& candidate) const {
+    // Only TileOptimize scores (where higher is better) are comparable this way;
+    // options supplied by registered cost models carry their own costs.
+    if (min_score_ratio_ <= 0 || !primary.tile.model.empty() || !candidate.tile.model.empty()) {
+      return false;
+    }
+    return candidate.tile.kernel_cost < primary.tile.kernel_cost * min_score_ratio_;
+  }
+
+  std::future<CompiledTrial> Compile(boost::asio::thread_pool* pool, const lang::KernelInfo& ki) {
+    auto task = std::make_shared<std::packaged_task<CompiledTrial()>>([this, &ki]() {
+      CompiledTrial compiled;
+      if (cancelled_) {
+        return compiled;
+      }
+      auto& device = *devinfo_.dev;
+      compiled.library = device.compiler()->Build(ctx_, {ki}, devinfo_.settings).get();
+      compiled.executable = device.executor()->Prepare(compiled.library.get()).get();
+      return compiled;
+    });
+    auto result = task->get_future();
+    if (pool) {
+      boost::asio::post(*pool, [task]() { (*task)(); });
+    } else {
+      (*task)();
+    }
+    return result;
+  }
+
+  void Measure(Trial* trial, const std::vector<std::shared_ptr<hal::Buffer>>& buffers) {
+    const auto& ki = *trial->ki;
+    LOG(DEBUG) << "Trying kernel: " << ki.kname << ", key: " << ki.key << ", tile: " << ki.tile.shape;
+    try {
+      auto compiled = trial->compiled.get();
+      auto& device = *devinfo_.dev;
+      int64_t best_time = std::numeric_limits<int64_t>::max();
+
+      // Run trial_runs number of times, picking minimum time
+      for (size_t i = 0; i < trial_runs_; i++) {
+        auto evt = compiled.executable->Run(ctx_, 0, buffers, {}, true);
+        device.executor()->Flush();
+        auto result = evt->GetFuture().get();
+        int64_t time = result->GetDuration().count();
+        best_time = std::min(time, best_time);
+      }
+
+      // Save in cache
+      lang::TileCache::Instance()->AddEntry(device_, ki.key, ki.settings, ki.tile.shape, best_time);
+      trial->info->set_duration_ns(best_time);
+      return;
+    } catch (const std::exception& ex) {
+      LOG(ERROR) << "Skipping kernel failure: " << ex.what();
+    } catch (...) {
+      LOG(ERROR) << "Skipping unknown kernel failure";
+    }
+    trial->info->set_failed(true);
+  }
+
+  const context::Context& ctx_;
+  const DevInfo& devinfo_;
+  std::string device_;
+  hal::Memory* memory_;
+  std::size_t trial_runs_;
+  double min_score_ratio_;
+  std::chrono::milliseconds budget_;
+  std::size_t compile_threads_;
+  std::atomic<bool> cancelled_{false};
+  hal::proto::TuningInfo info_;
+};
+
+int64_t ElapsedNs(std::chrono::steady_clock::time_point start) {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
 }
 
-lang::KernelList CompileProgram(const tile::proto::Program& program, const DevInfo& devinfo,
-                                const lang::TileOptimizer& optimizer) {
+lang::KernelList CompileProgram(const context::Context& ctx, const tile::proto::Program& program,
+                                const DevInfo& devinfo, const lang::TileOptimizer& optimizer,
+                                hal::proto::CompilationInfo* cinfo) {
   IVLOG(2, "Compiling: " << program.code());
   size_t tile_trials = 1;
-  size_t trial_runs = 1;
   if (program.has_tile_scanning_params()) {
     tile_trials = program.tile_scanning_params().max_trials();
-    trial_runs = program.tile_scanning_params().max_trial_runs();
   }
+  std::size_t compile_threads = ResolveThreadCount(program.tile_scanning_params().compile_threads());
+  cinfo->set_compile_threads(compile_threads);
 
-  context::Context ctx;
+  auto start = std::chrono::steady_clock::now();
   lang::Parser parser;
   auto parsed = parser.Parse(program.code());
   auto inputs = FromProto(program.inputs());
   auto outputs = FromProto(program.outputs());
   auto settings = hal::settings::ToHardwareSettings(devinfo.settings);
-  auto kernel_list = lang::GenerateProgram(parsed, inputs, outputs, settings, optimizer, program.id(), tile_trials);
+  auto kernel_list =
+      lang::GenerateProgram(parsed, inputs, outputs, settings, optimizer, program.id(), tile_trials, compile_threads);
+  cinfo->set_generate_ns(ElapsedNs(start));
 
   if (tile_trials == 1) {
     return kernel_list;
@@ -105,35 +319,13 @@ lang::KernelList CompileProgram(const tile::proto::Program& program, const DevIn
     }
   }
 
-  for (auto& ki : kernel_list.kernels) {
-    if (ki.candidates.empty()) {
-      continue;
-    }
-
-    std::vector<std::shared_ptr<hal::Buffer>> buffers;
-    AllocateBuffers(ki.outputs, kernel_list.types, memory, &buffers);
-    AllocateBuffers(ki.inputs, kernel_list.types, memory, &buffers);
-
-    std::vector<lang::KernelInfo> candidates;
-    std::swap(candidates, ki.candidates);
-
-    size_t cur_num = 0;
-    size_t best_num = 0;
-    uint64_t best_time = TryKernel(ctx, ki, buffers, devinfo, trial_runs);
-    pre_scan_time.add(best_time);
-    for (const auto& candidate : candidates) {
-      cur_num++;
-      uint64_t time = TryKernel(ctx, candidate, buffers, devinfo, trial_runs);
-      if (time < best_time) {
-        best_time = time;
-        ki = candidate;
-        best_num = cur_num;
-      }
-    }
-    post_scan_time.add(best_time);
-    IVLOG(1, "  best: " << double(best_time) / 1e9 << ", index: " << best_num);
-    IVLOG(1, "  pre_scan_time: " << double(pre_scan_time.get()) / 1e9
-                                 << ", post_scan_time: " << double(post_scan_time.get()) / 1e9);
+  context::Activity activity{ctx, "tile::local_machine::Tune"};
+  start = std::chrono::steady_clock::now();
+  Tuner tuner{activity.ctx(), devinfo, program.tile_scanning_params(), memory};
+  tuner.Tune(&kernel_list);
+  cinfo->set_tune_ns(ElapsedNs(start));
+  if (activity.ctx().is_logging_events()) {
+    activity.AddMetadata(tuner.info());
   }
 
   return kernel_list;
@@ -144,9 +336,12 @@ lang::KernelList CompileProgram(const tile::proto::Program& program, const DevIn
 Program::Program(const context::Context& ctx, const tile::proto::Program& program,
                  const std::shared_ptr<DevInfo>& devinfo, const std::shared_ptr<Scheduler>& scheduler,
                  const std::shared_ptr<MemStrategy>& output_mem_strategy,
-                 const std::shared_ptr<MemStrategy>& tmp_mem_strategy, hal::Memory* tmp_memory,
+                 const std::shared_ptr<TmpMemStrategy>& tmp_mem_strategy, hal::Memory* tmp_memory,
                  const lang::TileOptimizer& optimizer)
-    : devinfo_{devinfo}, output_mem_strategy_{output_mem_strategy}, tmp_mem_strategy_{tmp_mem_strategy} {
+    : id_{program.id()},
+      devinfo_{devinfo},
+      output_mem_strategy_{output_mem_strategy},
+      tmp_mem_strategy_{tmp_mem_strategy} {
   // TODO: Make this path asynchronous.
   // Asynchronous programming is a little tricky in this case, since if we compile asynchronously, the
   // compilation may not be complete when we're first asked to run a program, which means we'd need to save the run
@@ -162,14 +357,26 @@ Program::Program(const context::Context& ctx, const tile::proto::Program& progra
 
   context::Activity activity{ctx, "tile::local_machine::Compile"};
 
-  kernel_list_ = CompileProgram(program, *devinfo_.get(), optimizer);
+  hal::proto::CompilationInfo cinfo;
+  kernel_list_ = CompileProgram(activity.ctx(), program, *devinfo_.get(), optimizer, &cinfo);
 
+  auto start = std::chrono::steady_clock::now();
   auto lib = devinfo_->dev->compiler()->Build(activity.ctx(), kernel_list_.kernels, devinfo_->settings).get();
   executable_ = devinfo_->dev->executor()->Prepare(lib.get()).get();
+  cinfo.set_build_ns(ElapsedNs(start));
   schedule_ = scheduler->BuildSchedule(program, kernel_list_);
 
+  std::set<const sem::Function*> kfuncs;
+  for (const auto& kernel : kernel_list_.kernels) {
+    kfuncs.insert(kernel.kfunc.get());
+  }
+  cinfo.set_kernel_count(kernel_list_.kernels.size());
+  cinfo.set_generated_kernels(kfuncs.size());
+  IVLOG(1, "Compiled " << cinfo.kernel_count() << " kernels (" << cinfo.generated_kernels() << " distinct) on "
+                       << cinfo.compile_threads() << " threads: generate " << cinfo.generate_ns() / 1e9 << "s, tune "
+                       << cinfo.tune_ns() / 1e9 << "s, build " << cinfo.build_ns() / 1e9 << "s");
+
   if (activity.ctx().is_logging_events()) {
-    hal::proto::CompilationInfo cinfo;
     for (auto kernel : kernel_list_.kernels) {
       (*cinfo.mutable_kernels())[kernel.kname] = kernel.info;
     }
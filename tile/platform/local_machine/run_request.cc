@@ -105,6 +105,29 @@ boost::future<std::vector<std::shared_ptr<hal::Result>>> RunSchedule(const conte
   return results;
 }
 
+// Reports the program's share of the device's temporary memory pool, in the
+// log and in the activity's metadata.
+void ReportTmpMemUsage(const Program* program, context::Activity* activity) {
+  bool logging_events = activity->ctx().is_logging_events();
+  if (!logging_events && !VLOG_IS_ON(1)) {
+    return;
+  }
+  auto usage = program->tmp_mem_strategy()->usage();
+  auto pool = program->tmp_mem_strategy()->pool()->stats();
+  VLOG(1) << "Program " << program->id() << " temporary memory: " << usage.bytes_in_use << " bytes (peak "
+          << usage.peak_bytes_in_use << ") of the device pool's " << pool.bytes_in_use << " bytes in use, "
+          << pool.bytes_held << " bytes held";
+  if (logging_events) {
+    proto::TmpMemUsage info;
+    info.set_program_id(program->id());
+    info.set_bytes_in_use(usage.bytes_in_use);
+    info.set_peak_bytes_in_use(usage.peak_bytes_in_use);
+    info.set_pool_bytes_in_use(pool.bytes_in_use);
+    info.set_pool_bytes_held(pool.bytes_held);
+    activity->AddMetadata(info);
+  }
+}
+
 }  // namespace
 
 boost::future<void> RunRequest::Run(const context::Context& ctx, const Program* program,
@@ -117,7 +140,6 @@ boost::future<void> RunRequest::Run(const context::Context& ctx, const Program*
   context::Activity running{ctx, "tile::local_machine::Program::Run"};
   boost::future<void> complete;
   auto shim = std::make_unique<Shim>(running.ctx(), program, std::move(inputs), std::move(outputs));
-
   {
     context::Activity queueing{running.ctx(), "tile::local_machine::Program::Enqueue"};
     boost::future<std::vector<std::shared_ptr<hal::Result>>> results;
@@ -138,7 +160,13 @@ boost::future<void> RunRequest::Run(const context::Context& ctx, const Program*
   // Keep the shim and activity referenced until the program is complete.
   // N.B. It's important to keep the shim referenced because it's the thing that's actually holding
   // onto all of our chunk references; if those go away, unfortunate things happen.
-  return complete.then([shim = std::move(shim), running = std::move(running)](decltype(complete) fut) { fut.get(); });
+  return complete.then(
+      [shim = std::move(shim), running = std::move(running), program](decltype(complete) fut) mutable {
+        // The shim still holds this run's temporary chunks, so the usage
+        // reported includes them.
+        ReportTmpMemUsage(program, &running);
+        fut.get();
+      });
 }
 
 void RunRequest::LogRequest(const Program* program, const std::map<std::string, std::shared_ptr<tile::Buffer>>& inputs,
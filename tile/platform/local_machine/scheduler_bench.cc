@@ -0,0 +1,235 @@
+// Copyright 2018 Intel Corporation.
+
+// Compares the local_machine schedulers on saved programs.
+//
+// Each program is compiled to a kernel list for a fixed set of hardware
+// settings and then scheduled by each scheduler in turn.  For every schedule,
+// the bench reports the memory its allocations occupy, the time taken to
+// build it, and two estimates of its runtime: the length of its critical path,
+// and a simulation of the device running it.  Both estimates model each
+// kernel as taking as long as the greater of its flops and its bytes at the
+// configured device throughput.
+//
+// Programs may be supplied as .tile files (as written by plaidml_save_invoker)
+// or as text-format tile::proto::Program files (as in this directory's
+// testdata).
+//
+// Usage: scheduler_bench [flags] program...
+
+#include <gflags/gflags.h>
+#include <google/protobuf/io/zero_copy_stream_impl.h>
+#include <google/protobuf/text_format.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <functional>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include <boost/filesystem.hpp>
+
+#include "tile/hal/util/settings.h"
+#include "tile/lang/parser.h"
+#include "tile/platform/local_machine/scheduler_config.h"
+#include "tile/proto/support.h"
+#include "tile/util/tile_file.h"
+
+DEFINE_uint64(size_goal, 4ull << 30, "Memory goal, in bytes, for schedulers that have one");
+DEFINE_uint64(alignment, 1024, "Alignment, in bytes, of allocations");
+DEFINE_uint64(max_in_flight, 0, "Kernels in flight for the transitive dependency scheduler; zero is unlimited");
+DEFINE_double(gflops, 4000, "Simulated device compute throughput, in GFLOP/s");
+DEFINE_double(gbps, 200, "Simulated device memory bandwidth, in GB/s");
+DEFINE_double(launch_us, 5, "Simulated per-step launch overhead, in microseconds");
+DEFINE_uint64(lanes, 4, "Simulated number of steps the device runs concurrently");
+
+namespace gp = ::google::protobuf;
+
+namespace vertexai {
+namespace tile {
+namespace local_machine {
+namespace {
+
+tile::proto::Program LoadTileFile(const std::string& filename) {
+  util::TileFile file{filename};
+  auto runinfo = file.Load();
+  tile::proto::Program program;
+  program.set_id(boost::filesystem::path{filename}.stem().string());
+  program.set_code(runinfo.code);
+  for (const auto& kvp : runinfo.input_shapes) {
+    *(*program.mutable_inputs())[kvp.first].mutable_shape() = IntoProto(kvp.second);
+  }
+  for (const auto& kvp : runinfo.output_shapes) {
+    *(*program.mutable_outputs())[kvp.first].mutable_shape() = IntoProto(kvp.second);
+  }
+  return program;
+}
+
+tile::proto::Program LoadProgramProto(const std::string& filename) {
+  tile::proto::Program program;
+  std::ifstream in{filename};
+  if (!in) {
+    throw std::runtime_error{"Unable to read program proto from " + filename};
+  }
+  gp::io::IstreamInputStream zcis{&in};
+  if (!gp::TextFormat::Parse(&zcis, &program)) {
+    throw std::runtime_error{"Failed to parse program proto from " + filename};
+  }
+  if (program.id().empty()) {
+    program.set_id(boost::filesystem::path{filename}.stem().string());
+  }
+  return program;
+}
+
+tile::proto::Program LoadProgram(const std::string& filename) {
+  if (boost::filesystem::path{filename}.extension() == ".tile") {
+    return LoadTileFile(filename);
+  }
+  return LoadProgramProto(filename);
+}
+
+// The settings used by the scheduler conformance tests: a generic GPU.
+hal::proto::HardwareSettings BenchSettings() {
+  hal::proto::HardwareSettings settings;
+  settings.set_threads(256);
+  settings.set_vec_size(4);
+  settings.set_mem_width(128);
+  settings.set_max_mem(32768);
+  settings.set_max_regs(16384);
+  settings.set_goal_groups(16);
+  settings.set_goal_flops_per_byte(50);
+  settings.add_dim_sizes(1024);
+  settings.add_dim_sizes(1024);
+  settings.add_dim_sizes(1024);
+  return settings;
+}
+
+struct Candidate {
+  const char* name;
+  std::function<void(proto::SchedulerConfig*)> configure;
+};
+
+struct Result {
+  double build_ms = 0;
+  std::uint64_t alloc_count = 0;
+  std::uint64_t total_bytes = 0;
+  std::uint64_t tmp_bytes = 0;
+  double critical_path_us = 0;
+  double simulated_us = 0;
+};
+
+double StepMicros(const lang::KernelList& kl, const schedule::Step& step) {
+  double flops = 0;
+  double bytes = 0;
+  if (step.tag == schedule::Step::Tag::kRun) {
+    const auto& ki = kl.kernels[step.kidx];
+    flops = ki.tot_flops;
+    bytes = ki.tot_bytes;
+  } else {
+    bytes = 2.0 * step.byte_count;  // Read and write.
+  }
+  // GFLOP/s and GB/s are flops and bytes per nanosecond.
+  return FLAGS_launch_us + std::max(flops / FLAGS_gflops, bytes / FLAGS_gbps) / 1000;
+}
+
+Result Evaluate(const tile::proto::Program& program, const lang::KernelList& kl, Scheduler* scheduler) {
+  Result result;
+  auto start = std::chrono::steady_clock::now();
+  auto schedule = scheduler->BuildSchedule(program, kl);
+  result.build_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+  ValidateSchedule(program, kl, schedule);
+
+  // Every allocation is held for the whole run, so the program's peak memory
+  // use is the size of all of its allocations.
+  for (const auto& alloc : schedule.allocs) {
+    result.alloc_count++;
+    result.total_bytes += alloc.byte_size;
+    if (alloc.is_tmp()) {
+      result.tmp_bytes += alloc.byte_size;
+    }
+  }
+
+  // The critical path ignores the device's concurrency limit; the simulation
+  // issues steps in schedule order, each starting once its dependencies have
+  // finished and a lane is free.
+  std::unordered_map<const schedule::Step*, double> path_end;
+  std::unordered_map<const schedule::Step*, double> sim_end;
+  std::vector<double> lanes(std::max<std::uint64_t>(1, FLAGS_lanes), 0);
+  double issue = 0;
+  for (const auto& step : schedule.steps) {
+    double micros = StepMicros(kl, step);
+    double path_start = 0;
+    double sim_start = issue;
+    for (const auto* dep : step.deps) {
+      path_start = std::max(path_start, path_end[dep]);
+      sim_start = std::max(sim_start, sim_end[dep]);
+    }
+    auto lane = std::min_element(lanes.begin(), lanes.end());
+    sim_start = std::max(sim_start, *lane);
+    issue = sim_start;
+    *lane = sim_end[&step] = sim_start + micros;
+    path_end[&step] = path_start + micros;
+    result.critical_path_us = std::max(result.critical_path_us, path_end[&step]);
+    result.simulated_us = std::max(result.simulated_us, sim_end[&step]);
+  }
+  return result;
+}
+
+void Run(const std::string& filename, const std::vector<Candidate>& candidates) {
+  auto program = LoadProgram(filename);
+  auto settings = BenchSettings();
+
+  lang::Parser parser;
+  lang::TileOptimizer optimizer;
+  auto kl = lang::GenerateProgram(parser.Parse(program.code()), FromProto(program.inputs()),
+                                  FromProto(program.outputs()), hal::settings::ToHardwareSettings(settings),
+                                  optimizer, program.id(), 1);
+
+  std::printf("%s: %zu kernels\n", program.id().c_str(), kl.kernels.size());
+  std::printf("  %-10s %10s %8s %14s %14s %14s %14s\n", "scheduler", "build ms", "allocs", "total bytes", "tmp bytes",
+              "critical us", "simulated us");
+  for (const auto& candidate : candidates) {
+    proto::SchedulerConfig config;
+    candidate.configure(&config);
+    auto scheduler = MakeScheduler(config, FLAGS_alignment, FLAGS_size_goal, settings);
+    auto result = Evaluate(program, kl, scheduler.get());
+    std::printf("  %-10s %10.2f %8llu %14llu %14llu %14.1f %14.1f\n", candidate.name, result.build_ms,
+                static_cast<unsigned long long>(result.alloc_count),  // NOLINT(runtime/int)
+                static_cast<unsigned long long>(result.total_bytes),  // NOLINT(runtime/int)
+                static_cast<unsigned long long>(result.tmp_bytes),    // NOLINT(runtime/int)
+                result.critical_path_us, result.simulated_us);
+  }
+}
+
+}  // namespace
+}  // namespace local_machine
+}  // namespace tile
+}  // namespace vertexai
+
+int main(int argc, char** argv) {
+  using vertexai::tile::local_machine::Candidate;
+  namespace proto = vertexai::tile::local_machine::proto;
+  gflags::SetUsageMessage("scheduler_bench [flags] program...");
+  gflags::ParseCommandLineFlags(&argc, &argv, true);
+  std::vector<Candidate> candidates = {
+      {"fifo", [](proto::SchedulerConfig* config) { config->mutable_fifo(); }},
+      {"loose", [](proto::SchedulerConfig* config) { config->mutable_loose(); }},
+      {"linear", [](proto::SchedulerConfig* config) { config->mutable_linear(); }},
+      {"tdep",
+       [](proto::SchedulerConfig* config) { config->mutable_tdep()->set_max_in_flight(FLAGS_max_in_flight); }},
+  };
+  int status = 0;
+  for (int i = 1; i < argc; ++i) {
+    try {
+      vertexai::tile::local_machine::Run(argv[i], candidates);
+    } catch (const std::exception& ex) {
+      std::fprintf(stderr, "%s: %s\n", argv[i], ex.what());
+      status = 1;
+    }
+  }
+  return status;
+}
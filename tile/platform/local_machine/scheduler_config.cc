@@ -0,0 +1,66 @@
+// Copyright 2018 Intel Corporation.
+
+#include "tile/platform/local_machine/scheduler_config.h"
+
+#include <string>
+
+#include "base/util/error.h"
+#include "base/util/logging.h"
+#include "tile/platform/local_machine/block_placer.h"
+#include "tile/platform/local_machine/fifo_scheduler.h"
+#include "tile/platform/local_machine/linear_scheduler.h"
+#include "tile/platform/local_machine/loose_scheduler.h"
+#include "tile/platform/local_machine/naive_placer.h"
+#include "tile/platform/local_machine/tdep_scheduler.h"
+
+namespace vertexai {
+namespace tile {
+namespace local_machine {
+namespace {
+
+std::shared_ptr<Placer> MakePlacer(proto::PlacerType type, std::size_t alignment) {
+  switch (type) {
+    case proto::PlacerType::Block:
+      return std::make_shared<BlockPlacer>(alignment);
+    case proto::PlacerType::Naive:
+      return std::make_shared<NaivePlacer>(alignment);
+    default:
+      throw error::InvalidArgument{"Unknown placer type: " + std::to_string(type)};
+  }
+}
+
+std::uint64_t SizeGoal(std::uint64_t configured, std::uint64_t default_size_goal) {
+  return configured ? configured : default_size_goal;
+}
+
+}  // namespace
+
+std::shared_ptr<Scheduler> MakeScheduler(const proto::SchedulerConfig& config, std::size_t alignment,
+                                         std::uint64_t default_size_goal,
+                                         const hal::proto::HardwareSettings& settings) {
+  switch (config.scheduler_case()) {
+    case proto::SchedulerConfig::kLoose: {
+      auto size_goal = SizeGoal(config.loose().size_goal(), default_size_goal);
+      IVLOG(1, "Using loose scheduler; size_goal=" << size_goal);
+      return std::make_shared<LooseScheduler>(MakePlacer(config.loose().placer(), alignment), size_goal);
+    }
+    case proto::SchedulerConfig::kLinear:
+      IVLOG(1, "Using linear scheduler");
+      return std::make_shared<LinearScheduler>(MakePlacer(config.linear().placer(), alignment));
+    case proto::SchedulerConfig::kTdep:
+      IVLOG(1, "Using transitive dependency scheduler; max_in_flight=" << config.tdep().max_in_flight());
+      return std::make_shared<TransitiveDepScheduler>(MakePlacer(config.tdep().placer(), alignment),
+                                                      config.tdep().max_in_flight());
+    case proto::SchedulerConfig::kFifo:
+    case proto::SchedulerConfig::SCHEDULER_NOT_SET:
+    default: {
+      auto size_goal = SizeGoal(config.fifo().size_goal(), default_size_goal);
+      IVLOG(1, "Using fifo scheduler; size_goal=" << size_goal);
+      return std::make_shared<fifo_scheduler::FifoScheduler>(alignment, size_goal, settings);
+    }
+  }
+}
+
+}  // namespace local_machine
+}  // namespace tile
+}  // namespace vertexai
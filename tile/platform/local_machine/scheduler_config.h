@@ -0,0 +1,26 @@
+// Copyright 2018 Intel Corporation.
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+#include "tile/platform/local_machine/local_machine.pb.h"
+#include "tile/platform/local_machine/scheduler.h"
+#include "tile/proto/hal.pb.h"
+
+namespace vertexai {
+namespace tile {
+namespace local_machine {
+
+// Builds the scheduler described by a scheduler config; a config that doesn't choose a scheduler describes a FIFO
+// scheduler.  The alignment is that of the device's arena buffers, and the default size goal is used by schedulers
+// whose memory goal isn't set by the config.
+std::shared_ptr<Scheduler> MakeScheduler(const proto::SchedulerConfig& config, std::size_t alignment,
+                                         std::uint64_t default_size_goal,
+                                         const hal::proto::HardwareSettings& settings);
+
+}  // namespace local_machine
+}  // namespace tile
+}  // namespace vertexai
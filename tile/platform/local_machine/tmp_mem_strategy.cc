@@ -2,18 +2,47 @@
 
 #include "tile/platform/local_machine/tmp_mem_strategy.h"
 
+#include <algorithm>
 #include <exception>
+#include <mutex>
 #include <utility>
 
 namespace vertexai {
 namespace tile {
 namespace local_machine {
+
+// Accumulates a strategy's usage of its pool.  Chunks hold a reference to the tracker, since they may outlive the
+// strategy that made them.
+class TmpMemStrategy::Tracker {
+ public:
+  void Add(std::uint64_t bytes) {
+    std::lock_guard<std::mutex> lock{mu_};
+    usage_.bytes_in_use += bytes;
+    usage_.peak_bytes_in_use = std::max(usage_.peak_bytes_in_use, usage_.bytes_in_use);
+  }
+
+  void Remove(std::uint64_t bytes) {
+    std::lock_guard<std::mutex> lock{mu_};
+    usage_.bytes_in_use -= bytes;
+  }
+
+  Usage usage() {
+    std::lock_guard<std::mutex> lock{mu_};
+    return usage_;
+  }
+
+ private:
+  std::mutex mu_;
+  Usage usage_;
+};
+
 namespace {
 
 // A MemChunk implementation that frees its underlying memory to a MemCache when the chunk is deleted.
 class TmpMemChunk final : public MemChunk {
  public:
-  TmpMemChunk(std::uint64_t size, const std::shared_ptr<MemCache>& mem_cache, std::shared_ptr<hal::Buffer> hal_buffer);
+  TmpMemChunk(std::uint64_t size, const std::shared_ptr<MemCache>& mem_cache,
+              const std::shared_ptr<TmpMemStrategy::Tracker>& tracker, std::shared_ptr<hal::Buffer> hal_buffer);
   virtual ~TmpMemChunk();
 
   std::uint64_t size() const final;
@@ -25,15 +54,26 @@ class TmpMemChunk final : public MemChunk {
  private:
   std::uint64_t size_;
   std::shared_ptr<MemCache> mem_cache_;
+  std::shared_ptr<TmpMemStrategy::Tracker> tracker_;
   std::shared_ptr<hal::Buffer> hal_buffer_;
   std::shared_ptr<MemDeps> deps_;
 };
 
 TmpMemChunk::TmpMemChunk(std::uint64_t size, const std::shared_ptr<MemCache>& mem_cache,
+                         const std::shared_ptr<TmpMemStrategy::Tracker>& tracker,
                          std::shared_ptr<hal::Buffer> hal_buffer)
-    : size_{size}, mem_cache_{mem_cache}, hal_buffer_{hal_buffer}, deps_{std::make_shared<MemDeps>()} {}
+    : size_{size},
+      mem_cache_{mem_cache},
+      tracker_{tracker},
+      hal_buffer_{hal_buffer},
+      deps_{std::make_shared<MemDeps>()} {
+  tracker_->Add(mem_cache_->SizeClass(size_));
+}
 
-TmpMemChunk::~TmpMemChunk() { mem_cache_->Free(size_, std::move(hal_buffer_)); }
+TmpMemChunk::~TmpMemChunk() {
+  tracker_->Remove(mem_cache_->SizeClass(size_));
+  mem_cache_->Free(size_, std::move(hal_buffer_));
+}
 
 std::uint64_t TmpMemChunk::size() const { return size_; }
 
@@ -51,22 +91,38 @@ std::shared_ptr<hal::Buffer> TmpMemChunk::hal_buffer() { return hal_buffer_; }
 
 }  // namespace
 
-TmpMemStrategy::TmpMemStrategy(const std::shared_ptr<DevInfo>& devinfo, hal::Memory* source)
-    : devinfo_{devinfo}, source_{source}, cache_{std::make_shared<MemCache>()} {
-  if (!source_) {
+std::shared_ptr<MemCache> TmpMemStrategy::MakePool(hal::Memory* source, const proto::TmpMemPool& pool_config) {
+  if (!source) {
     throw std::logic_error{"The temporary memory management strategy requires memory"};
   }
+  std::uint64_t high_water_bytes = pool_config.high_water_bytes();
+  if (!high_water_bytes) {
+    high_water_bytes = source->size_goal();
+  }
+  std::uint32_t classes_per_doubling = pool_config.classes_per_doubling();
+  if (!classes_per_doubling) {
+    classes_per_doubling = MemCache::kDefaultClassesPerDoubling;
+  }
+  std::uint64_t max_bytes = pool_config.max_bytes();
+  if (!max_bytes) {
+    max_bytes = source->size_goal();
+  }
+  return std::make_shared<MemCache>(source, high_water_bytes, classes_per_doubling, max_bytes);
 }
 
-std::shared_ptr<MemChunk> TmpMemStrategy::MakeChunk(const context::Context& ctx, std::uint64_t size) const {
-  auto hal_buffer = cache_->TryAlloc(size);
-  if (!hal_buffer) {
-    auto buffer = source_->MakeBuffer(size, hal::BufferAccessMask::DEVICE_RW);
-    hal_buffer = buffer;
+TmpMemStrategy::TmpMemStrategy(const std::shared_ptr<DevInfo>& devinfo, const std::shared_ptr<MemCache>& pool)
+    : devinfo_{devinfo}, pool_{pool}, tracker_{std::make_shared<Tracker>()} {
+  if (!pool_) {
+    throw std::logic_error{"The temporary memory management strategy requires a memory pool"};
   }
-  return std::make_shared<TmpMemChunk>(size, cache_, std::move(hal_buffer));
 }
 
+std::shared_ptr<MemChunk> TmpMemStrategy::MakeChunk(const context::Context& ctx, std::uint64_t size) const {
+  return std::make_shared<TmpMemChunk>(size, pool_, tracker_, pool_->Alloc(size));
+}
+
+TmpMemStrategy::Usage TmpMemStrategy::usage() const { return tracker_->usage(); }
+
 }  // namespace local_machine
 }  // namespace tile
 }  // namespace vertexai
@@ -2,10 +2,12 @@
 
 #pragma once
 
+#include <cstdint>
 #include <memory>
 
 #include "tile/base/hal.h"
 #include "tile/platform/local_machine/devinfo.h"
+#include "tile/platform/local_machine/local_machine.pb.h"
 #include "tile/platform/local_machine/mem_cache.h"
 #include "tile/platform/local_machine/mem_strategy.h"
 
@@ -18,17 +20,37 @@ namespace local_machine {
 // Chunks allocated by TmpMemStrategy may not be directly accessible to the host; map and unmap calls may fail.
 //
 // Memory described by chunks may be reused when the chunk is deleted; callers must make sure to maintain chunk
-// references as long as the underlying memory is in use.
+// references as long as the underlying memory is in use.  Chunks are pooled by size class (see MemCache), so the
+// underlying buffer of a chunk may be somewhat larger than the chunk itself.
+//
+// The pool is typically shared by every program on a device, so that programs which don't run concurrently reuse
+// the same memory; each strategy tracks how much of the pool its own chunks occupy.
 class TmpMemStrategy final : public MemStrategy {
  public:
-  TmpMemStrategy(const std::shared_ptr<DevInfo>& devinfo, hal::Memory* source);
+  // Describes the portion of the pool occupied by a strategy's chunks.
+  struct Usage {
+    std::uint64_t bytes_in_use = 0;       // Pool bytes currently backing this strategy's chunks
+    std::uint64_t peak_bytes_in_use = 0;  // The most pool bytes ever backing this strategy's chunks at once
+  };
+
+  // Builds a pool of temporary memory drawn from the supplied memory, configured by pool_config.
+  static std::shared_ptr<MemCache> MakePool(hal::Memory* source, const proto::TmpMemPool& pool_config);
+
+  TmpMemStrategy(const std::shared_ptr<DevInfo>& devinfo, const std::shared_ptr<MemCache>& pool);
 
   std::shared_ptr<MemChunk> MakeChunk(const context::Context& ctx, std::uint64_t size) const final;
 
+  const std::shared_ptr<MemCache>& pool() const { return pool_; }
+
+  Usage usage() const;
+
+  // Accumulates usage; shared with the strategy's chunks.
+  class Tracker;
+
  private:
   std::shared_ptr<DevInfo> devinfo_;
-  hal::Memory* source_ = nullptr;
-  std::shared_ptr<MemCache> cache_;
+  std::shared_ptr<MemCache> pool_;
+  std::shared_ptr<Tracker> tracker_;
 };
 
 }  // namespace local_machine